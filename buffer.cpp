@@ -21,6 +21,25 @@ auto Buffer::write(const std::uint8_t *data, std::size_t size, std::size_t offse
     ::glNamedBufferSubData(buffer_, offset, size, data);
 }
 
+auto Buffer::reallocate(std::uint32_t size) -> void
+{
+    // storage is immutable, so the only way to resize is a new buffer, created before deleting the old one so the
+    // handle is guaranteed to change and anything caching bindings by handle notices
+    auto buffer = ::GLuint{};
+    ::glCreateBuffers(1, &buffer);
+    ::glNamedBufferStorage(buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+
+    ::glDeleteBuffers(1, &buffer_);
+
+    buffer_ = buffer;
+    size_ = size;
+}
+
+auto Buffer::size() const -> std::uint32_t
+{
+    return size_;
+}
+
 auto Buffer::native_handle() const -> ::GLuint
 {
     return buffer_;
@@ -35,6 +35,22 @@ class Buffer
      */
     auto write(const std::uint8_t *data, std::size_t size, std::size_t offset) const -> void;
 
+    /**
+     * Replace the OpenGL buffer with a new one of a different size. The contents are lost and the handle changes.
+     *
+     * @param size
+     *   Size in bytes of the new buffer.
+     */
+    auto reallocate(std::uint32_t size) -> void;
+
+    /**
+     * Get the size of the buffer.
+     *
+     * @returns
+     *   Size in bytes of the buffer.
+     */
+    auto size() const -> std::uint32_t;
+
     /**
      * Get the OpenGL buffer handle.
      *
@@ -93,6 +93,23 @@ inline constexpr auto hypot(float x, float y, float z) -> float
     return sqrt((x * x) + (y * y) + (z * z));
 }
 
+inline auto to_int(float x) -> int
+{
+    // a plain cast wants a CRT helper on x86, so truncate with SSE instead
+    return ::_mm_cvtt_ss2si(::_mm_set_ss(x));
+}
+
+inline auto floor(float x) -> float
+{
+    const auto truncated = static_cast<float>(to_int(x));
+    return truncated > x ? truncated - 1.0f : truncated;
+}
+
+inline auto fract(float x) -> float
+{
+    return x - floor(x);
+}
+
 inline auto malloc(std::size_t size) -> void *
 {
     auto *ptr = ::HeapAlloc(::GetProcessHeap(), 0, size);
@@ -106,6 +123,37 @@ inline auto free(void *ptr) -> void
     ::HeapFree(::GetProcessHeap(), 0, ptr);
 }
 
+/**
+ * Allocate memory with a 16 byte alignment, which the heap only guarantees on 64 bit. Anything with alignas(16)
+ * members needs this. Note that the result can only be freed with free_aligned16.
+ *
+ * @param size
+ *   Number of bytes to allocate.
+ *
+ * @return
+ *   The aligned memory.
+ */
+inline auto malloc_aligned16(std::size_t size) -> void *
+{
+    // the heap is at least 8 byte aligned, so this always skips far enough to keep the real address just before
+    const auto address = reinterpret_cast<std::uintptr_t>(malloc(size + 16u));
+    auto **aligned = reinterpret_cast<void **>((address + 16u) & ~std::uintptr_t{15u});
+    aligned[-1] = reinterpret_cast<void *>(address);
+
+    return aligned;
+}
+
+/**
+ * Free memory allocated with malloc_aligned16.
+ *
+ * @param ptr
+ *   The aligned memory.
+ */
+inline auto free_aligned16(void *ptr) -> void
+{
+    free(static_cast<void **>(ptr)[-1]);
+}
+
 inline auto memcpy(void *dest, const void *src, std::size_t size) -> void *
 {
     ::__movsb(static_cast<std::uint8_t *>(dest), static_cast<const std::uint8_t *>(src), size);
@@ -137,8 +185,32 @@ inline auto memcmp(const void *lhs, const void *rhs, std::size_t size) -> int
     return 0;
 }
 
+/** State of the seeded generator, zero until seed_rand is called. */
+inline std::uint32_t g_rand_state = 0u;
+
+/**
+ * Switch rand() from the system generator to a xorshift generator with a known seed, so runs can be repeated.
+ *
+ * @param seed
+ *   The seed.
+ */
+inline auto seed_rand(std::uint32_t seed) -> void
+{
+    // xorshift gets stuck at zero
+    g_rand_state = (seed != 0u) ? seed : 1u;
+}
+
 inline auto rand() -> int
 {
+    if (g_rand_state != 0u)
+    {
+        g_rand_state ^= g_rand_state << 13u;
+        g_rand_state ^= g_rand_state >> 17u;
+        g_rand_state ^= g_rand_state << 5u;
+
+        return static_cast<int>(g_rand_state);
+    }
+
     char buffer[4]{};
     ::RtlGenRandom(buffer, sizeof(buffer));
 
@@ -0,0 +1,278 @@
+#include "cpu_profiler.h"
+
+#include <cstdarg>
+#include <cstdint>
+
+#include <Windows.h>
+#include <intrin.h>
+
+#include "clib.h"
+#include "error.h"
+#include "log.h"
+
+namespace
+{
+
+/** Number of events kept per thread, must be a power of two. */
+static constexpr auto g_ring_size = 16384u;
+
+/** Maximum number of threads that can register, enough for every job system worker as well. */
+static constexpr auto g_max_threads = 20u;
+
+/** Maximum nesting depth of scopes on a thread. */
+static constexpr auto g_max_depth = 16u;
+
+/**
+ * A finished scope.
+ */
+struct CpuProfileEvent
+{
+    const char *name;
+    std::uint64_t start;
+    std::uint64_t end;
+};
+
+/**
+ * A scope that has been started but not ended.
+ */
+struct CpuOpenScope
+{
+    const char *name;
+    std::uint64_t start;
+};
+
+/**
+ * Per thread state, only the owning thread writes to it.
+ */
+struct CpuProfileRing
+{
+    const char *thread_name;
+    ::DWORD thread_id;
+
+    /** Total number of events ever written, the exporter reads this to know what's safe to read. */
+    volatile std::uint32_t head;
+
+    std::uint32_t depth;
+    CpuOpenScope stack[g_max_depth];
+    CpuProfileEvent events[g_ring_size];
+};
+
+/** Thread local slot holding each thread's ring. */
+::DWORD g_tls_index = TLS_OUT_OF_INDEXES;
+
+/** Rings of every registered thread. */
+CpuProfileRing *g_rings[g_max_threads];
+
+/** Number of registered threads. */
+volatile ::LONG g_ring_count;
+
+/** Counter values when the profiler was initialised, events are exported relative to these. */
+std::uint64_t g_start_ticks;
+::LARGE_INTEGER g_start_counter;
+
+/**
+ * Helper class to write formatted text to a file through a buffer, as wsprintf has no float support any times must be
+ * split into integer parts by the caller.
+ */
+class TraceWriter
+{
+  public:
+    /** The buffer is deliberately left uninitialised, zeroing it would need memset. */
+    TraceWriter(::HANDLE file)
+        : file_{file}
+        , size_{}
+        , ok_{true}
+    {
+    }
+
+    /** Append formatted text, flushing first if the buffer might not have room. */
+    auto write(const char *format, ...) -> void
+    {
+        // wsprintf never writes more than 1024 characters
+        if (size_ > sizeof(buffer_) - 1025u)
+        {
+            flush();
+        }
+
+        va_list args;
+        va_start(args, format);
+        size_ += ::wvsprintfA(buffer_ + size_, format, args);
+        va_end(args);
+    }
+
+    /** Write out the buffer, returns false if this or any earlier write failed. */
+    auto flush() -> bool
+    {
+        auto written = ::DWORD{};
+        ok_ = ok_ && ::WriteFile(file_, buffer_, size_, &written, nullptr) && (written == size_);
+        size_ = 0u;
+
+        return ok_;
+    }
+
+  private:
+    ::HANDLE file_;
+    char buffer_[8192];
+    std::uint32_t size_;
+    bool ok_;
+};
+
+/**
+ * Helper function to write a time in microseconds to a trace, as a decimal with three places.
+ *
+ * @param writer
+ *   Writer to write to.
+ * @param ticks
+ *   Time in rdtsc ticks since the profiler was initialised.
+ * @param ticks_per_ms
+ *   Conversion from ticks to milliseconds.
+ */
+auto write_microseconds(TraceWriter *writer, std::int64_t ticks, double ticks_per_ms) -> void
+{
+    // split in to whole milliseconds and nanoseconds so neither overflows an int for any sensible run
+    const auto ms = static_cast<double>(ticks) / ticks_per_ms;
+    const auto whole_ms = ::_mm_cvttsd_si32(::_mm_set_sd(ms));
+    const auto ns = ::_mm_cvttsd_si32(::_mm_set_sd((ms - static_cast<double>(whole_ms)) * 1000000.0));
+
+    if (whole_ms == 0)
+    {
+        writer->write("%d.%03d", ns / 1000, ns % 1000);
+    }
+    else
+    {
+        writer->write("%d%03d.%03d", whole_ms, ns / 1000, ns % 1000);
+    }
+}
+
+}
+
+auto cpu_profiler_init() -> void
+{
+    g_tls_index = ::TlsAlloc();
+    g_start_ticks = ::__rdtsc();
+    ::QueryPerformanceCounter(&g_start_counter);
+}
+
+auto cpu_profiler_register_thread(const char *name) -> void
+{
+    const auto index = static_cast<std::uint32_t>(::InterlockedIncrement(&g_ring_count) - 1);
+    ensure(index < g_max_threads, ErrorCode::CPU_PROFILER_OVERFLOW);
+
+    auto *ring = static_cast<CpuProfileRing *>(malloc(sizeof(CpuProfileRing)));
+    ring->thread_name = name;
+    ring->thread_id = ::GetCurrentThreadId();
+    ring->head = 0u;
+    ring->depth = 0u;
+
+    g_rings[index] = ring;
+    ::TlsSetValue(g_tls_index, ring);
+}
+
+auto cpu_profiler_begin_scope(const char *name) -> void
+{
+    auto *ring = static_cast<CpuProfileRing *>(::TlsGetValue(g_tls_index));
+    if (ring == nullptr)
+    {
+        return;
+    }
+
+    ensure(ring->depth < g_max_depth, ErrorCode::CPU_PROFILER_OVERFLOW);
+
+    ring->stack[ring->depth++] = {.name = name, .start = ::__rdtsc()};
+}
+
+auto cpu_profiler_end_scope() -> void
+{
+    const auto end = ::__rdtsc();
+
+    auto *ring = static_cast<CpuProfileRing *>(::TlsGetValue(g_tls_index));
+    if (ring == nullptr)
+    {
+        return;
+    }
+
+    ensure(ring->depth != 0u, ErrorCode::CPU_PROFILER_SCOPE_MISMATCH);
+
+    const auto &scope = ring->stack[--ring->depth];
+    const auto head = ring->head;
+
+    ring->events[head & (g_ring_size - 1u)] = {.name = scope.name, .start = scope.start, .end = end};
+
+    // x86 doesn't reorder stores with other stores, so only the compiler needs stopping from publishing the head early
+    ::_WriteBarrier();
+    ring->head = head + 1u;
+}
+
+auto cpu_profiler_export(const char *path) -> bool
+{
+    // calibrate rdtsc against the performance counter over the whole run, which is far more accurate than a short
+    // calibration at startup
+    auto counter = ::LARGE_INTEGER{};
+    auto frequency = ::LARGE_INTEGER{};
+    const auto ticks = ::__rdtsc();
+    ::QueryPerformanceCounter(&counter);
+    ::QueryPerformanceFrequency(&frequency);
+
+    const auto elapsed_ms = static_cast<double>(counter.QuadPart - g_start_counter.QuadPart) * 1000.0 /
+                            static_cast<double>(frequency.QuadPart);
+    const auto ticks_per_ms = static_cast<double>(static_cast<std::int64_t>(ticks - g_start_ticks)) / elapsed_ms;
+
+    const auto file = ::CreateFileA(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    auto writer = TraceWriter{file};
+    auto event_count = 0u;
+    auto *separator = "";
+
+    writer.write("{\"traceEvents\":[");
+
+    const auto ring_count = static_cast<std::uint32_t>(g_ring_count);
+    for (auto i = 0u; (i < ring_count) && (i < g_max_threads); ++i)
+    {
+        const auto *ring = g_rings[i];
+        if (ring == nullptr)
+        {
+            continue;
+        }
+
+        writer.write(
+            "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+            separator,
+            ring->thread_id,
+            ring->thread_name);
+        separator = ",";
+
+        // only read up to the head as it was now, anything after that may still be being written
+        const auto head = ring->head;
+        const auto first = (head > g_ring_size) ? head - g_ring_size : 0u;
+
+        for (auto j = first; j < head; ++j)
+        {
+            const auto &event = ring->events[j & (g_ring_size - 1u)];
+
+            writer.write(
+                "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":",
+                separator,
+                event.name,
+                ring->thread_id);
+            write_microseconds(&writer, static_cast<std::int64_t>(event.start - g_start_ticks), ticks_per_ms);
+            writer.write(",\"dur\":");
+            write_microseconds(&writer, static_cast<std::int64_t>(event.end - event.start), ticks_per_ms);
+            writer.write("}");
+
+            ++event_count;
+        }
+    }
+
+    writer.write("\n]}\n");
+
+    const auto written = writer.flush();
+    ::CloseHandle(file);
+
+    log_format("wrote %u cpu profile events to %s", event_count, path);
+
+    return written;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "func.h"
+
+/**
+ * Lightweight CPU profiler, scopes are timed with rdtsc and recorded into a ring buffer per thread.
+ *
+ * Each ring has a single writer (the thread that owns it), so recording a scope is a couple of rdtscs and a store with
+ * no locks or atomics. Only the most recent events are kept, older ones are overwritten. The rings can be exported as
+ * Chrome trace JSON, which can be loaded in chrome://tracing or Perfetto to see the phases of each frame on every
+ * thread.
+ *
+ * Threads that haven't registered are silently ignored, so library code can be profiled without caring which thread it
+ * runs on.
+ */
+
+/**
+ * Initialise the profiler, must be called once before any other thread is started.
+ */
+auto cpu_profiler_init() -> void;
+
+/**
+ * Register the calling thread with the profiler, allocating its ring buffer.
+ *
+ * @param name
+ *   Name shown for the thread in the trace, must outlive the profiler (e.g. a string literal).
+ */
+auto cpu_profiler_register_thread(const char *name) -> void;
+
+/**
+ * Start a scope on the calling thread, nested inside whatever scope is currently open.
+ *
+ * @param name
+ *   Name of the scope, must outlive the profiler (e.g. a string literal).
+ */
+auto cpu_profiler_begin_scope(const char *name) -> void;
+
+/**
+ * End the most recently started scope on the calling thread.
+ */
+auto cpu_profiler_end_scope() -> void;
+
+/**
+ * Write everything currently in the rings to a Chrome trace file.
+ *
+ * Other threads can keep recording while this runs, an event that gets overwritten mid export may come out garbled so
+ * it's best to export once the interesting part is over.
+ *
+ * @param path
+ *   Path of the file to write.
+ *
+ * @return
+ *   True if the file was written, false otherwise.
+ */
+auto cpu_profiler_export(const char *path) -> bool;
+
+/**
+ * Class for timing a block, the scope ends when it goes out of scope. Use via CPU_PROFILE_SCOPE.
+ */
+class CpuProfileScope
+{
+  public:
+    /**
+     * Construct a new scope, starting it immediately.
+     *
+     * @param name
+     *   Name of the scope, must outlive the profiler (e.g. a string literal).
+     */
+    CpuProfileScope(const char *name)
+    {
+        cpu_profiler_begin_scope(name);
+    }
+
+    /**
+     * End the scope.
+     */
+    ~CpuProfileScope()
+    {
+        cpu_profiler_end_scope();
+    }
+
+    CpuProfileScope(const CpuProfileScope &) = delete;
+    auto operator=(const CpuProfileScope &) -> CpuProfileScope & = delete;
+};
+
+/** Time the rest of the enclosing block under the given name. */
+#define CPU_PROFILE_SCOPE(NAME) const CpuProfileScope CAT(cpu_profile_scope_, __COUNTER__){NAME}
@@ -0,0 +1,163 @@
+#include "dynamic_resolution.h"
+
+#include <cstdint>
+
+#include "clib.h"
+#include "error.h"
+#include "opengl.h"
+
+namespace
+{
+
+/** Smallest scale applied to each axis, a quarter of the pixels. */
+static constexpr auto g_min_scale = 0.5f;
+
+/** Amount the scale changes by in one step. */
+static constexpr auto g_scale_step = 0.05f;
+
+/** Frame time above target * this counts as too slow. */
+static constexpr auto g_upper_band = 1.05f;
+
+/** Frame time below target * this counts as fast enough to scale up. */
+static constexpr auto g_lower_band = 0.80f;
+
+/** Number of consecutive frames outside the band before the scale moves. */
+static constexpr auto g_frames_to_react = 8;
+
+/** Weight of the newest sample in the smoothed frame time. */
+static constexpr auto g_smoothing = 0.1f;
+
+}
+
+DynamicResolution::DynamicResolution(
+    std::uint32_t width,
+    std::uint32_t height,
+    ::GLuint target,
+    float target_frame_time)
+    : width_{width}
+    , height_{height}
+    , target_{target}
+    , target_frame_time_{target_frame_time}
+    , framebuffer_{}
+    , colour_texture_{}
+    , depth_texture_{}
+    , queries_{}
+    , frame_{}
+    , scale_{1.0f}
+    , gpu_frame_time_{target_frame_time}
+    , pressure_{}
+    , frame_width_{width}
+    , frame_height_{height}
+{
+    // allocate at full size once, lower scales just render to a smaller corner of it
+    ::glCreateTextures(GL_TEXTURE_2D, 1, &colour_texture_);
+    ::glTextureStorage2D(colour_texture_, 1, GL_RGBA8, width_, height_);
+
+    ::glCreateTextures(GL_TEXTURE_2D, 1, &depth_texture_);
+    ::glTextureStorage2D(depth_texture_, 1, GL_DEPTH_COMPONENT24, width_, height_);
+
+    ::glCreateFramebuffers(1, &framebuffer_);
+    ::glNamedFramebufferTexture(framebuffer_, GL_COLOR_ATTACHMENT0, colour_texture_, 0);
+    ::glNamedFramebufferTexture(framebuffer_, GL_DEPTH_ATTACHMENT, depth_texture_, 0);
+
+    ensure(
+        ::glCheckNamedFramebufferStatus(framebuffer_, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE,
+        ErrorCode::FRAMEBUFFER_INCOMPLETE);
+
+    ::glCreateQueries(GL_TIME_ELAPSED, query_count, queries_);
+}
+
+auto DynamicResolution::begin_frame() -> void
+{
+    // go via a signed int, unsigned to float conversion pulls in a CRT helper on x86
+    frame_width_ = static_cast<std::uint32_t>(to_int(static_cast<float>(static_cast<std::int32_t>(width_)) * scale_));
+    frame_height_ = static_cast<std::uint32_t>(to_int(static_cast<float>(static_cast<std::int32_t>(height_)) * scale_));
+
+    ::glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    ::glViewport(0, 0, frame_width_, frame_height_);
+
+    ::glBeginQuery(GL_TIME_ELAPSED, queries_[frame_ % query_count]);
+}
+
+auto DynamicResolution::end_frame() -> void
+{
+    ::glEndQuery(GL_TIME_ELAPSED);
+
+    ::glBindFramebuffer(GL_FRAMEBUFFER, target_);
+    ::glViewport(0, 0, width_, height_);
+    ::glBlitNamedFramebuffer(
+        framebuffer_,
+        target_,
+        0,
+        0,
+        frame_width_,
+        frame_height_,
+        0,
+        0,
+        width_,
+        height_,
+        GL_COLOR_BUFFER_BIT,
+        GL_LINEAR);
+
+    ++frame_;
+
+    // the oldest query is the next one to be reused, so it's the one to read (if it's had time to finish)
+    if (frame_ < query_count)
+    {
+        return;
+    }
+
+    const auto query = queries_[frame_ % query_count];
+    auto available = ::GLuint{};
+    ::glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE)
+    {
+        return;
+    }
+
+    // a frame is never anywhere near the four seconds it would take to overflow, so skip the 64 bit result
+    auto elapsed_ns = ::GLuint{};
+    ::glGetQueryObjectuiv(query, GL_QUERY_RESULT, &elapsed_ns);
+
+    const auto elapsed = static_cast<float>(static_cast<std::int32_t>(elapsed_ns)) / 1000000000.0f;
+    gpu_frame_time_ += (elapsed - gpu_frame_time_) * g_smoothing;
+
+    if (target_frame_time_ <= 0.0f)
+    {
+        return;
+    }
+
+    if (gpu_frame_time_ > target_frame_time_ * g_upper_band)
+    {
+        pressure_ = (pressure_ > 0) ? pressure_ + 1 : 1;
+    }
+    else if (gpu_frame_time_ < target_frame_time_ * g_lower_band)
+    {
+        pressure_ = (pressure_ < 0) ? pressure_ - 1 : -1;
+    }
+    else
+    {
+        pressure_ = 0;
+    }
+
+    if (pressure_ >= g_frames_to_react)
+    {
+        scale_ = (scale_ - g_scale_step < g_min_scale) ? g_min_scale : scale_ - g_scale_step;
+        pressure_ = 0;
+    }
+    else if (pressure_ <= -g_frames_to_react)
+    {
+        scale_ = (scale_ + g_scale_step > 1.0f) ? 1.0f : scale_ + g_scale_step;
+        pressure_ = 0;
+    }
+}
+
+auto DynamicResolution::scale() const -> float
+{
+    return scale_;
+}
+
+auto DynamicResolution::gpu_frame_time() const -> float
+{
+    return gpu_frame_time_;
+}
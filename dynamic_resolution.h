@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+
+#include "opengl.h"
+
+/**
+ * Class for rendering the scene at a resolution that adapts to hold a target GPU frame time.
+ *
+ * The scene is drawn into the corner of an offscreen framebuffer allocated at full size, so changing the scale is just
+ * a change of viewport, and then blitted (and stretched) to the back buffer. GPU time is measured with a ring of
+ * GL_TIME_ELAPSED queries read a few frames late, so measuring never stalls the pipeline.
+ *
+ * To stop the scale flip flopping there is a dead band around the target and the scale only moves after the smoothed
+ * frame time has been outside it for several frames in a row.
+ *
+ * Note that for simplicity no cleanup is performed.
+ */
+class DynamicResolution
+{
+  public:
+    /**
+     * Construct a new dynamic resolution renderer.
+     *
+     * @param width
+     *   Width of the back buffer.
+     * @param height
+     *   Height of the back buffer.
+     * @param target
+     *   Framebuffer to upscale to, 0 for the back buffer.
+     * @param target_frame_time
+     *   GPU frame time to aim for in seconds, or zero to always render at full resolution.
+     */
+    DynamicResolution(std::uint32_t width, std::uint32_t height, ::GLuint target, float target_frame_time);
+
+    /**
+     * Start rendering a frame, binds the offscreen framebuffer and sets the viewport to the current scale.
+     */
+    auto begin_frame() -> void;
+
+    /**
+     * Finish rendering a frame, blits to the back buffer and updates the scale from any finished timings.
+     */
+    auto end_frame() -> void;
+
+    /**
+     * Get the current scale applied to each axis.
+     *
+     * @return
+     *   Scale in [min_scale, 1].
+     */
+    auto scale() const -> float;
+
+    /**
+     * Get the smoothed GPU frame time the scale is being driven by.
+     *
+     * @return
+     *   Frame time in seconds.
+     */
+    auto gpu_frame_time() const -> float;
+
+  private:
+    /** Number of timer queries in flight, results are read this many frames late. */
+    static constexpr auto query_count = 4u;
+
+    /** Width of the back buffer. */
+    std::uint32_t width_;
+
+    /** Height of the back buffer. */
+    std::uint32_t height_;
+
+    /** Framebuffer to upscale to. */
+    ::GLuint target_;
+
+    /** GPU frame time to aim for in seconds, zero if the scale is fixed. */
+    float target_frame_time_;
+
+    /** The offscreen framebuffer. */
+    ::GLuint framebuffer_;
+
+    /** Colour attachment of the framebuffer. */
+    ::GLuint colour_texture_;
+
+    /** Depth attachment of the framebuffer. */
+    ::GLuint depth_texture_;
+
+    /** Ring of GL_TIME_ELAPSED queries. */
+    ::GLuint queries_[query_count];
+
+    /** Number of frames started, indexes the query ring. */
+    std::uint32_t frame_;
+
+    /** Current scale applied to each axis. */
+    float scale_;
+
+    /** Exponentially smoothed GPU frame time in seconds. */
+    float gpu_frame_time_;
+
+    /** Number of consecutive frames above (positive) or below (negative) the dead band. */
+    std::int32_t pressure_;
+
+    /** Scaled width of the frame being rendered, the blit has to use the size the frame was started with. */
+    std::uint32_t frame_width_;
+
+    /** Scaled height of the frame being rendered. */
+    std::uint32_t frame_height_;
+};
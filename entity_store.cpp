@@ -0,0 +1,372 @@
+#include "entity_store.h"
+
+#include <cstdint>
+
+#include "clib.h"
+#include "error.h"
+#include "instance_allocator.h"
+#include "matrix4.h"
+#include "model_data.h"
+#include "point_light.h"
+#include "vector3.h"
+
+namespace
+{
+
+/** Smallest number of entities an archetype or the location table grows to. */
+static constexpr auto g_min_capacity = 16u;
+
+/** Archetype of a destroyed entity. */
+static constexpr auto g_destroyed = ~0u;
+
+/**
+ * Helper function to move a component array to a bigger one.
+ *
+ * @param array
+ *   The array to grow, may be null if it's never been allocated.
+ * @param element_size
+ *   Size of each element in bytes.
+ * @param present
+ *   Whether the archetype has the component at all, if not the array is left null.
+ * @param count
+ *   Number of elements to keep.
+ * @param capacity
+ *   New number of elements.
+ */
+auto grow_array(void **array, std::uint32_t element_size, bool present, std::uint32_t count, std::uint32_t capacity)
+    -> void
+{
+    if (!present)
+    {
+        return;
+    }
+
+    // component arrays hold matrices and alignas(16) vectors, so everything is aligned alike
+    auto *grown = malloc_aligned16(element_size * capacity);
+
+    if (*array != nullptr)
+    {
+        memcpy(grown, *array, element_size * count);
+        free_aligned16(*array);
+    }
+
+    *array = grown;
+}
+
+}
+
+EntityStore::EntityStore()
+    : archetype_count_{}
+    , locations_{}
+    , entity_count_{}
+    , entity_capacity_{}
+{
+}
+
+auto EntityStore::create(std::uint32_t components) -> std::uint32_t
+{
+    const auto index = find_archetype(components);
+    auto &archetype = archetypes_[index];
+
+    if (archetype.count == archetype.capacity)
+    {
+        grow(&archetype, (archetype.capacity < g_min_capacity) ? g_min_capacity : archetype.capacity * 2u);
+    }
+
+    if (entity_count_ == entity_capacity_)
+    {
+        entity_capacity_ = (entity_capacity_ < g_min_capacity) ? g_min_capacity : entity_capacity_ * 2u;
+        auto *locations = static_cast<Location *>(malloc(sizeof(Location) * entity_capacity_));
+
+        if (locations_ != nullptr)
+        {
+            memcpy(locations, locations_, sizeof(Location) * entity_count_);
+            free(locations_);
+        }
+
+        locations_ = locations;
+    }
+
+    const auto entity = entity_count_++;
+    const auto row = archetype.count++;
+
+    archetype.entities[row] = entity;
+    locations_[entity] = {.archetype = index, .row = row};
+
+    return entity;
+}
+
+auto EntityStore::destroy(std::uint32_t entity) -> void
+{
+    const auto location = locations_[entity];
+    auto &archetype = archetypes_[location.archetype];
+    const auto last = --archetype.count;
+
+    // fill the hole with the last row, so the arrays stay contiguous
+    if (location.row != last)
+    {
+        const auto row = location.row;
+        archetype.entities[row] = archetype.entities[last];
+        locations_[archetype.entities[row]].row = row;
+
+        if (archetype.transforms != nullptr)
+        {
+            archetype.transforms[row] = archetype.transforms[last];
+        }
+        if (archetype.meshes != nullptr)
+        {
+            archetype.meshes[row] = archetype.meshes[last];
+        }
+        if (archetype.materials != nullptr)
+        {
+            archetype.materials[row] = archetype.materials[last];
+        }
+        if (archetype.lights != nullptr)
+        {
+            archetype.lights[row] = archetype.lights[last];
+        }
+        if (archetype.attachments != nullptr)
+        {
+            archetype.attachments[row] = archetype.attachments[last];
+        }
+        if (archetype.target_radii != nullptr)
+        {
+            archetype.target_radii[row] = archetype.target_radii[last];
+        }
+    }
+
+    locations_[entity].archetype = g_destroyed;
+}
+
+auto EntityStore::transform(std::uint32_t entity) -> Matrix4 &
+{
+    const auto location = locations_[entity];
+    return archetypes_[location.archetype].transforms[location.row];
+}
+
+auto EntityStore::mesh(std::uint32_t entity) -> std::uint32_t &
+{
+    const auto location = locations_[entity];
+    return archetypes_[location.archetype].meshes[location.row];
+}
+
+auto EntityStore::material(std::uint32_t entity) -> MaterialParams &
+{
+    const auto location = locations_[entity];
+    return archetypes_[location.archetype].materials[location.row];
+}
+
+auto EntityStore::light(std::uint32_t entity) -> LightEmitter &
+{
+    const auto location = locations_[entity];
+    return archetypes_[location.archetype].lights[location.row];
+}
+
+auto EntityStore::attachment(std::uint32_t entity) -> Matrix4 &
+{
+    const auto location = locations_[entity];
+    return archetypes_[location.archetype].attachments[location.row];
+}
+
+auto EntityStore::target_radius(std::uint32_t entity) -> float &
+{
+    const auto location = locations_[entity];
+    return archetypes_[location.archetype].target_radii[location.row];
+}
+
+auto EntityStore::archetype_count() const -> std::uint32_t
+{
+    return archetype_count_;
+}
+
+auto EntityStore::archetype(std::uint32_t index) -> Archetype &
+{
+    return archetypes_[index];
+}
+
+auto EntityStore::archetype(std::uint32_t index) const -> const Archetype &
+{
+    return archetypes_[index];
+}
+
+auto EntityStore::matches(std::uint32_t index, std::uint32_t components) const -> bool
+{
+    const auto &archetype = archetypes_[index];
+    return ((archetype.components & components) == components) && (archetype.count != 0u);
+}
+
+auto EntityStore::follow(const Matrix4 &parent) -> void
+{
+    for (auto a = 0u; a < archetype_count_; ++a)
+    {
+        if (!matches(a, COMPONENT_TRANSFORM | COMPONENT_ATTACHMENT))
+        {
+            continue;
+        }
+
+        auto &archetype = archetypes_[a];
+        for (auto i = 0u; i < archetype.count; ++i)
+        {
+            archetype.transforms[i] = parent * archetype.attachments[i];
+        }
+    }
+}
+
+auto EntityStore::instance_count(std::uint32_t mesh) const -> std::uint32_t
+{
+    auto count = 0u;
+
+    for (auto a = 0u; a < archetype_count_; ++a)
+    {
+        if (!matches(a, COMPONENT_TRANSFORM | COMPONENT_MESH | COMPONENT_MATERIAL))
+        {
+            continue;
+        }
+
+        const auto &archetype = archetypes_[a];
+        for (auto i = 0u; i < archetype.count; ++i)
+        {
+            count += (archetype.meshes[i] == mesh) ? 1u : 0u;
+        }
+    }
+
+    return count;
+}
+
+auto EntityStore::write_instances(const InstanceLayout &layout, ModelData *models) const -> void
+{
+    std::uint32_t cursors[max_instance_ranges];
+    for (auto i = 0u; i < layout.range_count; ++i)
+    {
+        cursors[i] = layout.bases[i];
+    }
+
+    // every archetype is read front to back and each range is written front to back, so this is a handful of linear
+    // streams however many entities there are
+    for (auto a = 0u; a < archetype_count_; ++a)
+    {
+        if (!matches(a, COMPONENT_TRANSFORM | COMPONENT_MESH | COMPONENT_MATERIAL))
+        {
+            continue;
+        }
+
+        const auto &archetype = archetypes_[a];
+        for (auto i = 0u; i < archetype.count; ++i)
+        {
+            const auto &material = archetype.materials[i];
+            auto &model = models[cursors[archetype.meshes[i]]++];
+
+            model.model = archetype.transforms[i];
+            model.checker_colour1 = material.checker_colour1;
+            model.checker_colour2 = material.checker_colour2;
+            model.wood_colour1 = material.wood_colour1;
+            model.wood_colour2 = material.wood_colour2;
+            model.wood_colour3 = material.wood_colour3;
+            model.wood_scale = material.wood_scale;
+            model.metal_colour = material.metal_colour;
+            model.water_colour1 = material.water_colour1;
+            model.water_colour2 = material.water_colour2;
+            model.normal_scale = material.normal_scale;
+        }
+    }
+}
+
+auto EntityStore::write_lights(PointLightBuffer *lights, std::uint32_t max_lights) const -> std::uint32_t
+{
+    auto count = 0u;
+
+    for (auto a = 0u; a < archetype_count_; ++a)
+    {
+        if (!matches(a, COMPONENT_TRANSFORM | COMPONENT_LIGHT))
+        {
+            continue;
+        }
+
+        const auto &archetype = archetypes_[a];
+        for (auto i = 0u; (i < archetype.count) && (count < max_lights); ++i)
+        {
+            const auto &transform = archetype.transforms[i];
+            lights[count++] = {
+                {transform[12], transform[13], transform[14]},
+                archetype.lights[i].colour,
+                archetype.lights[i].attenuation};
+        }
+    }
+
+    return count;
+}
+
+auto EntityStore::find_archetype(std::uint32_t components) -> std::uint32_t
+{
+    for (auto i = 0u; i < archetype_count_; ++i)
+    {
+        if (archetypes_[i].components == components)
+        {
+            return i;
+        }
+    }
+
+    ensure(archetype_count_ < max_archetypes, ErrorCode::TOO_MANY_ARCHETYPES);
+
+    // arrays are only allocated when the first entity is added
+    const auto index = archetype_count_++;
+    archetypes_[index] = {
+        .components = components,
+        .count = 0u,
+        .capacity = 0u,
+        .entities = nullptr,
+        .transforms = nullptr,
+        .meshes = nullptr,
+        .materials = nullptr,
+        .lights = nullptr,
+        .attachments = nullptr,
+        .target_radii = nullptr};
+
+    return index;
+}
+
+auto EntityStore::grow(Archetype *archetype, std::uint32_t capacity) -> void
+{
+    const auto components = archetype->components;
+    const auto count = archetype->count;
+
+    grow_array(reinterpret_cast<void **>(&archetype->entities), sizeof(std::uint32_t), true, count, capacity);
+    grow_array(
+        reinterpret_cast<void **>(&archetype->transforms),
+        sizeof(Matrix4),
+        (components & COMPONENT_TRANSFORM) != 0u,
+        count,
+        capacity);
+    grow_array(
+        reinterpret_cast<void **>(&archetype->meshes),
+        sizeof(std::uint32_t),
+        (components & COMPONENT_MESH) != 0u,
+        count,
+        capacity);
+    grow_array(
+        reinterpret_cast<void **>(&archetype->materials),
+        sizeof(MaterialParams),
+        (components & COMPONENT_MATERIAL) != 0u,
+        count,
+        capacity);
+    grow_array(
+        reinterpret_cast<void **>(&archetype->lights),
+        sizeof(LightEmitter),
+        (components & COMPONENT_LIGHT) != 0u,
+        count,
+        capacity);
+    grow_array(
+        reinterpret_cast<void **>(&archetype->attachments),
+        sizeof(Matrix4),
+        (components & COMPONENT_ATTACHMENT) != 0u,
+        count,
+        capacity);
+    grow_array(
+        reinterpret_cast<void **>(&archetype->target_radii),
+        sizeof(float),
+        (components & COMPONENT_TARGET) != 0u,
+        count,
+        capacity);
+
+    archetype->capacity = capacity;
+}
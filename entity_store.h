@@ -0,0 +1,308 @@
+#pragma once
+
+#include <cstdint>
+
+#include "instance_allocator.h"
+#include "matrix4.h"
+#include "model_data.h"
+#include "point_light.h"
+#include "vector3.h"
+
+/** Most distinct sets of components a store can hold. */
+static constexpr auto max_archetypes = 16u;
+
+/**
+ * Bit flags for the components an entity can have.
+ */
+enum Component : std::uint32_t
+{
+    /** World transform, a Matrix4. */
+    COMPONENT_TRANSFORM = 1u << 0u,
+
+    /** Instance allocator range of the mesh the entity is drawn with, a std::uint32_t. */
+    COMPONENT_MESH = 1u << 1u,
+
+    /** Material parameters, a MaterialParams. */
+    COMPONENT_MATERIAL = 1u << 2u,
+
+    /** Point light at the origin of the transform, a LightEmitter. */
+    COMPONENT_LIGHT = 1u << 3u,
+
+    /** Transform relative to the player, a Matrix4 the world transform is rebuilt from. */
+    COMPONENT_ATTACHMENT = 1u << 4u,
+
+    /** Something bullets can hit, a float hit radius around the origin of the transform. */
+    COMPONENT_TARGET = 1u << 5u,
+};
+
+/**
+ * Colour and falloff of a point light, positioned by the entity's transform.
+ */
+struct LightEmitter
+{
+    Vector3 colour;
+    Vector3 attenuation;
+};
+
+/**
+ * Every entity with exactly the same set of components, stored as one contiguous array per component so a walk only
+ * touches the components it needs. Arrays for components not in the set are null.
+ */
+struct Archetype
+{
+    /** Bitwise or of the Component values every entity here has. */
+    std::uint32_t components;
+
+    /** Number of entities. */
+    std::uint32_t count;
+
+    /** Number of entities the arrays have room for. */
+    std::uint32_t capacity;
+
+    /** Entity in each row. */
+    std::uint32_t *entities;
+
+    Matrix4 *transforms;
+    std::uint32_t *meshes;
+    MaterialParams *materials;
+    LightEmitter *lights;
+    Matrix4 *attachments;
+    float *target_radii;
+};
+
+/**
+ * Class storing entities by archetype.
+ *
+ * An entity is just an index into a table of where its components live, the archetype and the row within it. Creating
+ * an entity appends a row to the archetype for its components, destroying one moves the last row into the hole so the
+ * arrays never have gaps. Entities are never reused and can't change their components, which is all the scene needs.
+ *
+ * Iteration is always in archetype then row order, so as long as nothing is created or destroyed every walk sees the
+ * entities in the same order from one frame to the next.
+ *
+ * Note that for simplicity no cleanup is performed.
+ */
+class EntityStore
+{
+  public:
+    /**
+     * Construct a new, empty, store.
+     */
+    EntityStore();
+
+    /**
+     * Create an entity.
+     *
+     * @param components
+     *   Bitwise or of the Component values the entity has, they start uninitialised.
+     *
+     * @return
+     *   The new entity.
+     */
+    auto create(std::uint32_t components) -> std::uint32_t;
+
+    /**
+     * Destroy an entity. Any pointers to components of the last entity in the same archetype are invalidated.
+     *
+     * @param entity
+     *   The entity to destroy.
+     */
+    auto destroy(std::uint32_t entity) -> void;
+
+    /**
+     * Get the transform of an entity.
+     *
+     * @param entity
+     *   Entity with COMPONENT_TRANSFORM.
+     *
+     * @return
+     *   The transform, valid until an entity in the same archetype is created or destroyed.
+     */
+    auto transform(std::uint32_t entity) -> Matrix4 &;
+
+    /**
+     * Get the mesh of an entity.
+     *
+     * @param entity
+     *   Entity with COMPONENT_MESH.
+     *
+     * @return
+     *   The mesh, valid until an entity in the same archetype is created or destroyed.
+     */
+    auto mesh(std::uint32_t entity) -> std::uint32_t &;
+
+    /**
+     * Get the material of an entity.
+     *
+     * @param entity
+     *   Entity with COMPONENT_MATERIAL.
+     *
+     * @return
+     *   The material, valid until an entity in the same archetype is created or destroyed.
+     */
+    auto material(std::uint32_t entity) -> MaterialParams &;
+
+    /**
+     * Get the light of an entity.
+     *
+     * @param entity
+     *   Entity with COMPONENT_LIGHT.
+     *
+     * @return
+     *   The light, valid until an entity in the same archetype is created or destroyed.
+     */
+    auto light(std::uint32_t entity) -> LightEmitter &;
+
+    /**
+     * Get the attachment of an entity.
+     *
+     * @param entity
+     *   Entity with COMPONENT_ATTACHMENT.
+     *
+     * @return
+     *   The transform relative to the player, valid until an entity in the same archetype is created or destroyed.
+     */
+    auto attachment(std::uint32_t entity) -> Matrix4 &;
+
+    /**
+     * Get the hit radius of an entity.
+     *
+     * @param entity
+     *   Entity with COMPONENT_TARGET.
+     *
+     * @return
+     *   The radius, valid until an entity in the same archetype is created or destroyed.
+     */
+    auto target_radius(std::uint32_t entity) -> float &;
+
+    /**
+     * Get the number of archetypes, they're indexed from zero in the order entities are walked.
+     *
+     * @return
+     *   Number of archetypes.
+     */
+    auto archetype_count() const -> std::uint32_t;
+
+    /**
+     * Get an archetype.
+     *
+     * @param index
+     *   Index of the archetype, less than archetype_count.
+     *
+     * @return
+     *   The archetype, valid until an entity is created.
+     */
+    auto archetype(std::uint32_t index) -> Archetype &;
+
+    /**
+     * Get an archetype.
+     *
+     * @param index
+     *   Index of the archetype, less than archetype_count.
+     *
+     * @return
+     *   The archetype, valid until an entity is created.
+     */
+    auto archetype(std::uint32_t index) const -> const Archetype &;
+
+    /**
+     * Check if an archetype should be walked for some components.
+     *
+     * @param index
+     *   Index of the archetype, less than archetype_count.
+     * @param components
+     *   Bitwise or of the Component values to look for.
+     *
+     * @return
+     *   True if the archetype has at least those components and any entities, false otherwise.
+     */
+    auto matches(std::uint32_t index, std::uint32_t components) const -> bool;
+
+    /**
+     * Rebuild the transform of every attached entity.
+     *
+     * @param parent
+     *   Transform of the player, applied after each attachment.
+     */
+    auto follow(const Matrix4 &parent) -> void;
+
+    /**
+     * Count the drawn entities that use a mesh.
+     *
+     * @param mesh
+     *   Instance allocator range to count.
+     *
+     * @return
+     *   Number of entities with a transform, material and that mesh.
+     */
+    auto instance_count(std::uint32_t mesh) const -> std::uint32_t;
+
+    /**
+     * Write the instance data of every drawn entity to the range of its mesh, in the same order every time.
+     *
+     * @param layout
+     *   Where each range starts, each must have room for instance_count of its mesh.
+     * @param models
+     *   Model buffer to write to.
+     */
+    auto write_instances(const InstanceLayout &layout, ModelData *models) const -> void;
+
+    /**
+     * Write the light of every entity that has one.
+     *
+     * @param lights
+     *   Array to write to.
+     * @param max_lights
+     *   Size of the lights array, any more lights are dropped.
+     *
+     * @return
+     *   Number of lights written.
+     */
+    auto write_lights(PointLightBuffer *lights, std::uint32_t max_lights) const -> std::uint32_t;
+
+  private:
+    /**
+     * Where an entity's components live.
+     */
+    struct Location
+    {
+        std::uint32_t archetype;
+        std::uint32_t row;
+    };
+
+    /**
+     * Find the archetype with exactly some components, adding it if there isn't one.
+     *
+     * @param components
+     *   Bitwise or of the Component values.
+     *
+     * @return
+     *   Index of the archetype.
+     */
+    auto find_archetype(std::uint32_t components) -> std::uint32_t;
+
+    /**
+     * Move every array of an archetype to bigger ones.
+     *
+     * @param archetype
+     *   The archetype to grow.
+     * @param capacity
+     *   New number of entities to have room for.
+     */
+    auto grow(Archetype *archetype, std::uint32_t capacity) -> void;
+
+    /** Every archetype, in the order they were first needed. */
+    Archetype archetypes_[max_archetypes];
+
+    /** Number of archetypes. */
+    std::uint32_t archetype_count_;
+
+    /** Where each entity lives, indexed by entity. */
+    Location *locations_;
+
+    /** Number of entities ever created. */
+    std::uint32_t entity_count_;
+
+    /** Number of entities the locations array has room for. */
+    std::uint32_t entity_capacity_;
+};
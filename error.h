@@ -27,6 +27,27 @@ enum class ErrorCode
     FAILED_TO_PREPARE_WAVE_HEADER = 18,
     FAILED_TO_WRITE_WAVE_OUTPUT = 19,
     FAILED_TO_UNPREPARE_WAVE_HEADER = 20,
+    MISSING_SHADER_VERSION = 21,
+    UNKNOWN_MATERIAL_PERMUTATION = 22,
+    SHADER_LAYOUT_MISMATCH = 23,
+    TOO_MANY_UNIFORMS = 24,
+    TOO_MANY_MESH_LODS = 25,
+    RENDER_QUEUE_FULL = 26,
+    FRAMEBUFFER_INCOMPLETE = 27,
+    GPU_PROFILER_OVERFLOW = 28,
+    GPU_PROFILER_SCOPE_MISMATCH = 29,
+    CPU_PROFILER_OVERFLOW = 30,
+    CPU_PROFILER_SCOPE_MISMATCH = 31,
+    FAILED_TO_READ_INPUT_LOG = 32,
+    FAILED_TO_WRITE_INPUT_LOG = 33,
+    JOB_SYSTEM_UNREGISTERED_THREAD = 34,
+    JOB_SYSTEM_OVERFLOW = 35,
+    SPATIAL_HASH_OVERFLOW = 36,
+    GPU_PROJECTILES_TOO_MANY_TARGETS = 37,
+    TOO_MANY_INSTANCE_RANGES = 38,
+    TOO_MANY_ARCHETYPES = 39,
+    TOO_MANY_TARGETS = 40,
+    GPU_PROJECTILES_WAIT_FAILED = 41,
 };
 
 /**
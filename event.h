@@ -25,4 +25,7 @@ struct Event
         std::uint8_t key;
         MouseMoveEvent mouse_move;
     } data;
+
+    /** QueryPerformanceCounter value when the event was received. */
+    std::int64_t time;
 };
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+
+#include <intrin.h>
+
+#include "event.h"
+
+/**
+ * Fixed capacity ring buffer of events, safe for one thread to push while another pops.
+ *
+ * Each index is only written by one side, and x86 doesn't reorder stores with other stores or loads with other loads,
+ * so the only thing needed to publish an event is to stop the compiler moving the index update before the copy.
+ *
+ * There's deliberately no constructor, without the CRT nothing would run it for a global. A ring is empty when zeroed,
+ * so it should be a global (which the loader zeroes) or zero initialised with EventRing{}.
+ */
+class EventRing
+{
+  public:
+    /**
+     * Add an event to the ring, called by the producer.
+     *
+     * @param evt
+     *   The event to add.
+     *
+     * @return
+     *   True if the event was added, false if the ring was full and it's up to the producer what to do with it.
+     */
+    auto push(const Event &evt) -> bool
+    {
+        const auto tail = tail_;
+        if (tail - head_ == capacity)
+        {
+            return false;
+        }
+
+        events_[tail % capacity] = evt;
+
+        ::_WriteBarrier();
+        tail_ = tail + 1u;
+
+        return true;
+    }
+
+    /**
+     * Look at the oldest event without removing it, called by the consumer.
+     *
+     * @return
+     *   The oldest event, or null if the ring was empty.
+     */
+    auto peek() const -> const Event *
+    {
+        const auto head = head_;
+        if (head == tail_)
+        {
+            return nullptr;
+        }
+
+        ::_ReadBarrier();
+        return &events_[head % capacity];
+    }
+
+    /**
+     * Remove the oldest event from the ring, called by the consumer.
+     *
+     * @param evt
+     *   The event to populate.
+     *
+     * @return
+     *   True if an event was removed, false if the ring was empty.
+     */
+    auto pop(Event *evt) -> bool
+    {
+        const auto head = head_;
+        if (head == tail_)
+        {
+            return false;
+        }
+
+        ::_ReadBarrier();
+        *evt = events_[head % capacity];
+
+        ::_ReadWriteBarrier();
+        head_ = head + 1u;
+
+        return true;
+    }
+
+  private:
+    /** Number of events the ring can hold, a power of two so the indices can wrap. */
+    static constexpr auto capacity = 1024u;
+
+    /** The events, deliberately left uninitialised as zeroing them would need memset. */
+    Event events_[capacity];
+
+    /** Total number of events popped, only written by the consumer. */
+    volatile std::uint32_t head_;
+
+    /** Total number of events pushed, only written by the producer. */
+    volatile std::uint32_t tail_;
+};
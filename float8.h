@@ -0,0 +1,239 @@
+#pragma once
+
+#include <intrin.h>
+
+/**
+ * Eight floats that are operated on together, stored as a pair of SSE registers.
+ *
+ * Note that we build with /arch:IA32 so the compiler will never emit SSE by itself, the intrinsics are however always
+ * available so we use them explicitly for the hot loops.
+ */
+struct Float8
+{
+    /** Lanes 0-3. */
+    __m128 lo;
+
+    /** Lanes 4-7. */
+    __m128 hi;
+};
+
+/**
+ * Broadcast a single value to all lanes.
+ *
+ * @param value
+ *   The value to broadcast.
+ *
+ * @return
+ *   Eight copies of value.
+ */
+inline auto float8(float value) -> Float8
+{
+    return {::_mm_set1_ps(value), ::_mm_set1_ps(value)};
+}
+
+/**
+ * Load eight consecutive floats, no alignment required.
+ *
+ * @param src
+ *   Pointer to the first float.
+ *
+ * @return
+ *   The loaded lanes.
+ */
+inline auto load8(const float *src) -> Float8
+{
+    return {::_mm_loadu_ps(src), ::_mm_loadu_ps(src + 4)};
+}
+
+/**
+ * Store eight consecutive floats, no alignment required.
+ *
+ * @param dst
+ *   Pointer to write to.
+ * @param value
+ *   The lanes to write.
+ */
+inline auto store8(float *dst, const Float8 &value) -> void
+{
+    ::_mm_storeu_ps(dst, value.lo);
+    ::_mm_storeu_ps(dst + 4, value.hi);
+}
+
+inline auto operator+(const Float8 &a, const Float8 &b) -> Float8
+{
+    return {::_mm_add_ps(a.lo, b.lo), ::_mm_add_ps(a.hi, b.hi)};
+}
+
+inline auto operator-(const Float8 &a, const Float8 &b) -> Float8
+{
+    return {::_mm_sub_ps(a.lo, b.lo), ::_mm_sub_ps(a.hi, b.hi)};
+}
+
+inline auto operator*(const Float8 &a, const Float8 &b) -> Float8
+{
+    return {::_mm_mul_ps(a.lo, b.lo), ::_mm_mul_ps(a.hi, b.hi)};
+}
+
+inline auto operator/(const Float8 &a, const Float8 &b) -> Float8
+{
+    return {::_mm_div_ps(a.lo, b.lo), ::_mm_div_ps(a.hi, b.hi)};
+}
+
+inline auto min8(const Float8 &a, const Float8 &b) -> Float8
+{
+    return {::_mm_min_ps(a.lo, b.lo), ::_mm_min_ps(a.hi, b.hi)};
+}
+
+inline auto max8(const Float8 &a, const Float8 &b) -> Float8
+{
+    return {::_mm_max_ps(a.lo, b.lo), ::_mm_max_ps(a.hi, b.hi)};
+}
+
+inline auto sqrt8(const Float8 &a) -> Float8
+{
+    return {::_mm_sqrt_ps(a.lo), ::_mm_sqrt_ps(a.hi)};
+}
+
+inline auto abs8(const Float8 &a) -> Float8
+{
+    const auto mask = ::_mm_castsi128_ps(::_mm_set1_epi32(0x7fffffff));
+    return {::_mm_and_ps(a.lo, mask), ::_mm_and_ps(a.hi, mask)};
+}
+
+/**
+ * Per lane a > b.
+ *
+ * @return
+ *   All bits set in the lanes where the comparison is true, zero otherwise.
+ */
+inline auto greater8(const Float8 &a, const Float8 &b) -> Float8
+{
+    return {::_mm_cmpgt_ps(a.lo, b.lo), ::_mm_cmpgt_ps(a.hi, b.hi)};
+}
+
+/**
+ * Per lane a < b.
+ *
+ * @return
+ *   All bits set in the lanes where the comparison is true, zero otherwise.
+ */
+inline auto less8(const Float8 &a, const Float8 &b) -> Float8
+{
+    return {::_mm_cmplt_ps(a.lo, b.lo), ::_mm_cmplt_ps(a.hi, b.hi)};
+}
+
+/**
+ * Pick lanes from one of two values based on a comparison mask.
+ *
+ * @param mask
+ *   Result of one of the comparison functions.
+ * @param if_true
+ *   Lanes to use where mask is set.
+ * @param if_false
+ *   Lanes to use where mask is clear.
+ *
+ * @return
+ *   The blended value.
+ */
+inline auto select8(const Float8 &mask, const Float8 &if_true, const Float8 &if_false) -> Float8
+{
+    return {
+        ::_mm_or_ps(::_mm_and_ps(mask.lo, if_true.lo), ::_mm_andnot_ps(mask.lo, if_false.lo)),
+        ::_mm_or_ps(::_mm_and_ps(mask.hi, if_true.hi), ::_mm_andnot_ps(mask.hi, if_false.hi))};
+}
+
+/**
+ * Get a bitmask of the sign bits of a comparison result, lane 0 is the lowest bit.
+ *
+ * @param mask
+ *   Result of one of the comparison functions.
+ *
+ * @return
+ *   Eight bit mask of the set lanes.
+ */
+inline auto movemask8(const Float8 &mask) -> int
+{
+    return ::_mm_movemask_ps(mask.lo) | (::_mm_movemask_ps(mask.hi) << 4);
+}
+
+/**
+ * Per lane floor, only valid for values that fit in an int (which is all we ever need).
+ */
+inline auto floor8(const Float8 &a) -> Float8
+{
+    const auto truncated =
+        Float8{::_mm_cvtepi32_ps(::_mm_cvttps_epi32(a.lo)), ::_mm_cvtepi32_ps(::_mm_cvttps_epi32(a.hi))};
+
+    // truncation rounds negative values up, so knock those back down by one
+    return truncated - select8(greater8(truncated, a), float8(1.0f), float8(0.0f));
+}
+
+/**
+ * Per lane GLSL fract.
+ */
+inline auto fract8(const Float8 &a) -> Float8
+{
+    return a - floor8(a);
+}
+
+/**
+ * Per lane GLSL mix.
+ */
+inline auto mix8(const Float8 &a, const Float8 &b, const Float8 &t) -> Float8
+{
+    return a + (b - a) * t;
+}
+
+/**
+ * Per lane GLSL smoothstep, works with edge0 > edge1 just like the GLSL version.
+ */
+inline auto smoothstep8(const Float8 &edge0, const Float8 &edge1, const Float8 &x) -> Float8
+{
+    const auto t = min8(max8((x - edge0) / (edge1 - edge0), float8(0.0f)), float8(1.0f));
+    return t * t * (float8(3.0f) - float8(2.0f) * t);
+}
+
+/**
+ * Per lane sine.
+ *
+ * This does a three constant Cody-Waite range reduction to [-pi, pi], folds into [-pi/2, pi/2] and then evaluates an
+ * odd polynomial. The first two constants have only 8 significant bits, so multiplying them by the multiple of 2pi is
+ * exact for |k| < 65536, i.e. |x| up to about 400000. Over that range the absolute error against an exact sin of the
+ * same float argument is under 2.5e-7 (about four ulp at 1), the hash functions need up to around 45000. Note random
+ * multiplies by 43758.5453 so its fract can still be off by about 0.01, or wrap when the exact value is that close to a
+ * whole number. The clib version is fine for small angles but is far too slow and inaccurate for the shader hash
+ * functions.
+ */
+inline auto sin8(const Float8 &x) -> Float8
+{
+    static constexpr auto two_pi_hi = 6.28125f;
+    static constexpr auto two_pi_mid = 0.00193023681640625f;
+    static constexpr auto two_pi_lo = 5.0703631802e-6f;
+    static constexpr auto inv_two_pi = 0.159154943091895336f;
+    static constexpr auto pi_hi = 3.14159274101257324f;
+    static constexpr auto pi_lo = -8.7422776573e-8f;
+    static constexpr auto half_pi = 1.57079632679489662f;
+
+    // round to nearest multiple of 2pi (cvtps uses the default round to nearest mode)
+    const auto scaled = x * float8(inv_two_pi);
+    const auto k = Float8{
+        ::_mm_cvtepi32_ps(::_mm_cvtps_epi32(scaled.lo)), ::_mm_cvtepi32_ps(::_mm_cvtps_epi32(scaled.hi))};
+
+    // the first two products are exact and the first subtraction cancels exactly, so only the small terms round
+    auto r = ((x - k * float8(two_pi_hi)) - k * float8(two_pi_mid)) - k * float8(two_pi_lo);
+
+    // sin(pi - r) == sin(r), fold the outer quarters back in, pi_hi - r is exact so pi_lo makes up the difference
+    r = select8(greater8(r, float8(half_pi)), (float8(pi_hi) - r) + float8(pi_lo), r);
+    r = select8(less8(r, float8(-half_pi)), (float8(-pi_hi) - r) - float8(pi_lo), r);
+
+    const auto r2 = r * r;
+
+    auto poly = float8(-2.5052108385441718775e-8f);
+    poly = poly * r2 + float8(2.7557319223985890653e-6f);
+    poly = poly * r2 + float8(-1.9841269841269841270e-4f);
+    poly = poly * r2 + float8(8.3333333333333333333e-3f);
+    poly = poly * r2 + float8(-1.6666666666666666667e-1f);
+    poly = poly * r2 + float8(1.0f);
+
+    return r * poly;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Windows.h>
+#include <timeapi.h>
+
+#include "timer.h"
+
+/**
+ * Class for measuring the time between frames, and optionally holding frames to a minimum length.
+ */
+class FrameClock
+{
+  public:
+    /**
+     * Construct a new frame clock, the first frame starts immediately.
+     *
+     * @param min_frame_time
+     *   Shortest time in seconds a frame is allowed to take, zero for no limit.
+     */
+    FrameClock(float min_frame_time)
+        : timer_{}
+        , min_frame_time_{min_frame_time}
+    {
+        if (min_frame_time_ > 0.0f)
+        {
+            // make Sleep(1) sleep for about a millisecond rather than a whole scheduler tick
+            ::timeBeginPeriod(1u);
+        }
+    }
+
+    /**
+     * Start a new frame.
+     *
+     * @return
+     *   Time in seconds since the last frame started, clamped so a long stall (e.g. dragging the window) doesn't make
+     *   the simulation try to catch up on seconds of steps.
+     */
+    auto tick() -> float
+    {
+        const auto elapsed = timer_.elapsed_seconds();
+        timer_.reset();
+
+        return (elapsed < max_frame_time) ? elapsed : max_frame_time;
+    }
+
+    /**
+     * Wait until the minimum frame time has passed since the frame started, does nothing if there's no limit.
+     */
+    auto limit() const -> void
+    {
+        for (;;)
+        {
+            const auto remaining = min_frame_time_ - timer_.elapsed_seconds();
+            if (remaining <= 0.0f)
+            {
+                break;
+            }
+
+            // sleep while it's safe to overshoot a bit, then spin for the rest
+            if (remaining > 0.002f)
+            {
+                ::Sleep(1u);
+            }
+            else
+            {
+                ::YieldProcessor();
+            }
+        }
+    }
+
+  private:
+    /** Longest frame time reported by tick. */
+    static constexpr auto max_frame_time = 0.25f;
+
+    /** Time since the current frame started. */
+    Timer timer_;
+
+    /** Shortest time a frame is allowed to take. */
+    float min_frame_time_;
+};
@@ -0,0 +1,122 @@
+#include "frame_latency.h"
+
+#include <cstdint>
+
+#include <Windows.h>
+
+#include "clib.h"
+#include "log.h"
+#include "opengl.h"
+
+namespace
+{
+
+/** Longest to wait for a frame to finish, in nanoseconds. */
+static constexpr auto g_wait_timeout = ::GLuint64{1000000000u};
+
+/**
+ * Helper function to convert a time to whole microseconds, for logging as fixed point.
+ *
+ * @param seconds
+ *   Time in seconds.
+ *
+ * @return
+ *   Time in microseconds.
+ */
+auto to_microseconds(float seconds) -> int
+{
+    return to_int(seconds * 1000000.0f + 0.5f);
+}
+
+}
+
+FrameLatency::FrameLatency(std::uint32_t max_frames_in_flight)
+    : max_frames_in_flight_{(max_frames_in_flight < max_fences) ? max_frames_in_flight : max_fences - 1u}
+    , fences_{}
+    , first_fence_{}
+    , fence_count_{}
+    , frequency_{}
+    , samples_{}
+    , latency_sum_{}
+    , latency_max_{}
+    , waits_{}
+{
+    ::QueryPerformanceFrequency(&frequency_);
+
+    if (max_frames_in_flight_ != 0u)
+    {
+        log_format("low latency mode, at most %u frames in flight", max_frames_in_flight_);
+    }
+}
+
+auto FrameLatency::enabled() const -> bool
+{
+    return max_frames_in_flight_ != 0u;
+}
+
+auto FrameLatency::end_frame(std::int64_t input_time) -> void
+{
+    if (input_time != 0)
+    {
+        auto now = ::LARGE_INTEGER{};
+        ::QueryPerformanceCounter(&now);
+
+        // go via double to avoid needing the CRT 64-bit division helpers
+        const auto latency = static_cast<float>(
+            static_cast<double>(now.QuadPart - input_time) / static_cast<double>(frequency_.QuadPart));
+
+        latency_sum_ += latency;
+        latency_max_ = (latency > latency_max_) ? latency : latency_max_;
+        ++samples_;
+    }
+
+    if (!enabled())
+    {
+        return;
+    }
+
+    fences_[(first_fence_ + fence_count_) % max_fences] = ::glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++fence_count_;
+
+    // retire whatever has already finished without waiting, then wait for the oldest until few enough are left
+    while (fence_count_ != 0u)
+    {
+        const auto must_wait = fence_count_ > max_frames_in_flight_;
+        const auto result =
+            ::glClientWaitSync(fences_[first_fence_], GL_SYNC_FLUSH_COMMANDS_BIT, must_wait ? g_wait_timeout : 0u);
+
+        if ((result == GL_TIMEOUT_EXPIRED) && !must_wait)
+        {
+            break;
+        }
+
+        waits_ += (must_wait && (result == GL_CONDITION_SATISFIED)) ? 1u : 0u;
+
+        ::glDeleteSync(fences_[first_fence_]);
+        first_fence_ = (first_fence_ + 1u) % max_fences;
+        --fence_count_;
+    }
+}
+
+auto FrameLatency::report() -> void
+{
+    if (samples_ != 0u)
+    {
+        const auto average = to_microseconds(latency_sum_ / static_cast<float>(static_cast<std::int32_t>(samples_)));
+        const auto max = to_microseconds(latency_max_);
+
+        log_format(
+            "input latency: avg %d.%03dms max %d.%03dms over %u frames, %u waits for the gpu",
+            average / 1000,
+            average % 1000,
+            max / 1000,
+            max % 1000,
+            samples_,
+            waits_);
+    }
+
+    samples_ = 0u;
+    latency_sum_ = 0.0f;
+    latency_max_ = 0.0f;
+    waits_ = 0u;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+
+#include <Windows.h>
+
+#include "opengl.h"
+
+/**
+ * Class for bounding how far the CPU can run ahead of the GPU and measuring input latency.
+ *
+ * A fence is inserted after every swap and, once more than the allowed number of frames are in flight, the CPU waits
+ * for the oldest one. Without a cap a driver will happily queue several frames, each adding a frame of latency between
+ * the mouse moving and the picture changing.
+ *
+ * Latency is measured from the first input of a frame to its swap returning, which is as close to the photons as the
+ * CPU can see.
+ *
+ * Note that for simplicity no cleanup is performed.
+ */
+class FrameLatency
+{
+  public:
+    /**
+     * Construct a new frame latency tracker.
+     *
+     * @param max_frames_in_flight
+     *   Number of frames the GPU may be behind by, zero to let the driver decide.
+     */
+    FrameLatency(std::uint32_t max_frames_in_flight);
+
+    /**
+     * Check if frames in flight are being capped, which is when the simulation should run just before rendering rather
+     * than a frame ahead.
+     *
+     * @return
+     *   True if capping, false otherwise.
+     */
+    auto enabled() const -> bool;
+
+    /**
+     * End the current frame, must be called straight after the swap. Waits if too many frames are in flight.
+     *
+     * @param input_time
+     *   QueryPerformanceCounter value when the first input of the frame was received, zero if there was none.
+     */
+    auto end_frame(std::int64_t input_time) -> void;
+
+    /**
+     * Log the latency since the last report and start measuring again.
+     */
+    auto report() -> void;
+
+  private:
+    /** Most frames that can be tracked in flight. */
+    static constexpr auto max_fences = 8u;
+
+    /** Number of frames the GPU may be behind by. */
+    std::uint32_t max_frames_in_flight_;
+
+    /** Ring of fences for the frames in flight, oldest first. */
+    ::GLsync fences_[max_fences];
+
+    /** Index of the oldest fence. */
+    std::uint32_t first_fence_;
+
+    /** Number of fences in the ring. */
+    std::uint32_t fence_count_;
+
+    /** Counter ticks per second. */
+    ::LARGE_INTEGER frequency_;
+
+    /** Number of frames with input since the last report. */
+    std::uint32_t samples_;
+
+    /** Sum of the latencies since the last report, in seconds. */
+    float latency_sum_;
+
+    /** Largest latency since the last report, in seconds. */
+    float latency_max_;
+
+    /** Number of times the CPU had to wait for the GPU since the last report. */
+    std::uint32_t waits_;
+};
@@ -0,0 +1,173 @@
+#include "frame_pipeline.h"
+
+#include <cstdint>
+
+#include <Windows.h>
+#include <intrin.h>
+
+#include "clib.h"
+#include "log.h"
+
+namespace
+{
+
+/**
+ * Helper function to convert an average time in seconds to whole microseconds.
+ *
+ * @param sum
+ *   Total time in seconds.
+ * @param count
+ *   Number of samples in the total, must not be zero.
+ *
+ * @return
+ *   Average in microseconds.
+ */
+auto average_microseconds(float sum, std::uint32_t count) -> int
+{
+    return to_int((sum / static_cast<float>(static_cast<std::int32_t>(count))) * 1000000.0f);
+}
+
+}
+
+FramePipeline::FramePipeline(std::uint32_t snapshot_size)
+    : slots_{}
+    , stage_times_{}
+    , produced_{}
+    , consumed_{}
+    , finished_{}
+    , produced_event_{::CreateEventA(nullptr, FALSE, FALSE, nullptr)}
+    , consumed_event_{::CreateEventA(nullptr, FALSE, FALSE, nullptr)}
+    , gpu_time_{}
+    , simulation_waits_{}
+    , render_waits_{}
+    , simulation_sum_{}
+    , render_sum_{}
+    , frames_{}
+{
+    for (auto &slot : slots_)
+    {
+        slot = malloc_aligned16(snapshot_size);
+
+        auto *bytes = static_cast<std::uint8_t *>(slot);
+        for (auto i = 0u; i < snapshot_size; ++i)
+        {
+            bytes[i] = 0u;
+        }
+    }
+}
+
+auto FramePipeline::begin_produce() -> void *
+{
+    const auto produced = produced_;
+
+    if (produced - consumed_ == slot_count)
+    {
+        simulation_waits_ = simulation_waits_ + 1u;
+
+        // the events are auto reset and the counter is checked again after every wake, so a stale signal is harmless
+        while (produced - consumed_ == slot_count)
+        {
+            ::WaitForSingleObject(consumed_event_, INFINITE);
+        }
+    }
+
+    // don't let the compiler start writing before the render stage is seen to be done with the snapshot
+    ::_ReadWriteBarrier();
+
+    return slots_[produced % slot_count];
+}
+
+auto FramePipeline::end_produce(float stage_time) -> void
+{
+    const auto produced = produced_;
+    stage_times_[produced % slot_count] = stage_time;
+
+    // x86 doesn't reorder stores, so once the count is visible so is everything written to the snapshot
+    ::_WriteBarrier();
+    produced_ = produced + 1u;
+
+    ::SetEvent(produced_event_);
+}
+
+auto FramePipeline::finish() -> void
+{
+    ::_WriteBarrier();
+    finished_ = true;
+
+    ::SetEvent(produced_event_);
+}
+
+auto FramePipeline::begin_consume() -> const void *
+{
+    const auto consumed = consumed_;
+
+    if (consumed == produced_)
+    {
+        ++render_waits_;
+
+        while (consumed == produced_)
+        {
+            // finished is only set after the last frame is produced, so check the count once more before giving up
+            if (finished_)
+            {
+                ::_ReadBarrier();
+                if (consumed == produced_)
+                {
+                    return nullptr;
+                }
+
+                break;
+            }
+
+            ::WaitForSingleObject(produced_event_, INFINITE);
+        }
+    }
+
+    ::_ReadBarrier();
+
+    return slots_[consumed % slot_count];
+}
+
+auto FramePipeline::end_consume(float stage_time, float gpu_time) -> void
+{
+    const auto consumed = consumed_;
+
+    simulation_sum_ += stage_times_[consumed % slot_count];
+    render_sum_ += stage_time;
+    ++frames_;
+    gpu_time_ = gpu_time;
+
+    // all reads of the snapshot have to happen before the simulation stage can see it is free
+    ::_ReadWriteBarrier();
+    consumed_ = consumed + 1u;
+
+    ::SetEvent(consumed_event_);
+}
+
+auto FramePipeline::gpu_time() const -> float
+{
+    return gpu_time_;
+}
+
+auto FramePipeline::report() -> void
+{
+    if (frames_ != 0u)
+    {
+        const auto simulation = average_microseconds(simulation_sum_, frames_);
+        const auto render = average_microseconds(render_sum_, frames_);
+
+        log_format(
+            "pipeline: simulation %d.%03dms render %d.%03dms over %u frames, %u simulation and %u render waits so far",
+            simulation / 1000,
+            simulation % 1000,
+            render / 1000,
+            render % 1000,
+            frames_,
+            simulation_waits_,
+            render_waits_);
+    }
+
+    simulation_sum_ = 0.0f;
+    render_sum_ = 0.0f;
+    frames_ = 0u;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+
+#include <Windows.h>
+
+/**
+ * Class for handing frames from a simulation stage to a render stage, so the two can run on different threads.
+ *
+ * The simulation writes frame N+1 into one snapshot while the render stage draws frame N from the other. Each counter
+ * is only written by one stage, so handing over a snapshot needs no locks, the events are only there so a stage that
+ * gets ahead can sleep rather than spin. Both stages can also be run one after the other on a single thread, in which
+ * case neither ever waits.
+ *
+ * Snapshots are untyped blocks of memory, it's up to the caller what goes in them. Note that for simplicity no cleanup
+ * is performed.
+ */
+class FramePipeline
+{
+  public:
+    /**
+     * Construct a new pipeline.
+     *
+     * @param snapshot_size
+     *   Size in bytes of a snapshot.
+     */
+    FramePipeline(std::uint32_t snapshot_size);
+
+    /**
+     * Get the snapshot to produce the next frame into, called by the simulation stage. Waits if the render stage still
+     * has both snapshots.
+     *
+     * @return
+     *   The snapshot to write, 16 byte aligned, its contents are whatever was written two frames ago (zero the first
+     *   time), so a snapshot can keep hold of memory it owns.
+     */
+    auto begin_produce() -> void *;
+
+    /**
+     * Hand the snapshot from begin_produce over to the render stage.
+     *
+     * @param stage_time
+     *   Time in seconds the simulation stage spent on the frame, not counting any wait.
+     */
+    auto end_produce(float stage_time) -> void;
+
+    /**
+     * Mark that no more frames will be produced, the render stage finishes any it already has.
+     */
+    auto finish() -> void;
+
+    /**
+     * Get the next snapshot to render, called by the render stage. Waits if the simulation stage hasn't produced it
+     * yet.
+     *
+     * @return
+     *   The snapshot to render, or null if there are no more frames.
+     */
+    auto begin_consume() -> const void *;
+
+    /**
+     * Hand the snapshot from begin_consume back to the simulation stage.
+     *
+     * @param stage_time
+     *   Time in seconds the render stage spent on the frame, not counting any wait.
+     * @param gpu_time
+     *   Time in seconds the GPU spent on a recent frame.
+     */
+    auto end_consume(float stage_time, float gpu_time) -> void;
+
+    /**
+     * Get the time the render stage last reported the GPU took, safe to call from either stage.
+     *
+     * @return
+     *   GPU frame time in seconds.
+     */
+    auto gpu_time() const -> float;
+
+    /**
+     * Log the average stage times since the last report and start measuring again, called by the render stage. Wait
+     * counts are totals for the whole run.
+     */
+    auto report() -> void;
+
+  private:
+    /** Number of snapshots, one being written and one being drawn. */
+    static constexpr auto slot_count = 2u;
+
+    /** The snapshots. */
+    void *slots_[slot_count];
+
+    /** Simulation stage time of the frame in each snapshot. */
+    float stage_times_[slot_count];
+
+    /** Number of frames produced, only written by the simulation stage. */
+    volatile std::uint32_t produced_;
+
+    /** Number of frames consumed, only written by the render stage. */
+    volatile std::uint32_t consumed_;
+
+    /** Flag indicating no more frames will be produced. */
+    volatile bool finished_;
+
+    /** Event signalled whenever a frame is produced or the pipeline is finished. */
+    ::HANDLE produced_event_;
+
+    /** Event signalled whenever a frame is consumed. */
+    ::HANDLE consumed_event_;
+
+    /** GPU time last reported by the render stage. */
+    volatile float gpu_time_;
+
+    /** Number of times the simulation stage waited for a snapshot, only written by the simulation stage. */
+    volatile std::uint32_t simulation_waits_;
+
+    /** Number of times the render stage waited for a frame. */
+    std::uint32_t render_waits_;
+
+    /** Sum of simulation stage times since the last report. */
+    float simulation_sum_;
+
+    /** Sum of render stage times since the last report. */
+    float render_sum_;
+
+    /** Number of frames since the last report. */
+    std::uint32_t frames_;
+};
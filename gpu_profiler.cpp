@@ -0,0 +1,258 @@
+#include "gpu_profiler.h"
+
+#include <cstdint>
+
+#include "clib.h"
+#include "error.h"
+#include "log.h"
+#include "opengl.h"
+
+namespace
+{
+
+/** Stack entry for a scope that wasn't recorded. */
+static constexpr auto g_dropped_record = ~0u;
+
+/**
+ * Helper function to compare scope names, usually they're the same literal so the pointer check is all that's needed.
+ *
+ * @param lhs
+ *   First name.
+ * @param rhs
+ *   Second name.
+ *
+ * @return
+ *   True if the names are the same.
+ */
+auto same_name(const char *lhs, const char *rhs) -> bool
+{
+    if (lhs == rhs)
+    {
+        return true;
+    }
+
+    while ((*lhs != '\0') && (*lhs == *rhs))
+    {
+        ++lhs;
+        ++rhs;
+    }
+
+    return *lhs == *rhs;
+}
+
+/**
+ * Helper function to convert a time to whole microseconds, for logging as fixed point.
+ *
+ * @param ms
+ *   Time in milliseconds.
+ *
+ * @return
+ *   Time in microseconds.
+ */
+auto to_microseconds(float ms) -> int
+{
+    return to_int(ms * 1000.0f + 0.5f);
+}
+
+}
+
+GpuProfiler::GpuProfiler()
+    : queries_{static_cast<::GLuint *>(malloc(sizeof(::GLuint) * frame_slots * max_records * 2u))}
+    , record_scopes_{static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * frame_slots * max_records))}
+    , record_counts_{}
+    , last_queries_{}
+    , stack_{}
+    , depth_{}
+    , scopes_{}
+    , scope_count_{}
+    , history_{static_cast<float *>(malloc(sizeof(float) * max_scopes * history_size))}
+    , frame_{}
+    , dropped_frames_{}
+    , dropped_scopes_{}
+{
+    ::glCreateQueries(GL_TIMESTAMP, frame_slots * max_records * 2u, queries_);
+}
+
+auto GpuProfiler::begin_frame() -> void
+{
+    const auto slot = frame_ % frame_slots;
+
+    if (record_counts_[slot] != 0u)
+    {
+        collect(slot);
+    }
+
+    record_counts_[slot] = 0u;
+}
+
+auto GpuProfiler::end_frame() -> void
+{
+    ensure(depth_ == 0u, ErrorCode::GPU_PROFILER_SCOPE_MISMATCH);
+
+    ++frame_;
+}
+
+auto GpuProfiler::begin_scope(const char *name) -> void
+{
+    const auto slot = frame_ % frame_slots;
+
+    ensure(depth_ < max_depth, ErrorCode::GPU_PROFILER_OVERFLOW);
+
+    auto index = 0u;
+    while ((index < scope_count_) && !same_name(scopes_[index].name, name))
+    {
+        ++index;
+    }
+
+    // running out of room only loses some timings, so the scope is still pushed to keep end_scope balanced but nothing
+    // is recorded for it
+    if ((record_counts_[slot] == max_records) || (index == max_scopes))
+    {
+        stack_[depth_++] = g_dropped_record;
+        ++dropped_scopes_;
+        return;
+    }
+
+    if (index == scope_count_)
+    {
+        scopes_[index] = {.name = name, .depth = depth_};
+        ++scope_count_;
+    }
+
+    const auto record = (slot * max_records) + record_counts_[slot]++;
+    record_scopes_[record] = index;
+    stack_[depth_++] = record;
+
+    ::glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, index, -1, name);
+    ::glQueryCounter(queries_[record * 2u], GL_TIMESTAMP);
+}
+
+auto GpuProfiler::end_scope() -> void
+{
+    ensure(depth_ != 0u, ErrorCode::GPU_PROFILER_SCOPE_MISMATCH);
+
+    const auto record = stack_[--depth_];
+    if (record == g_dropped_record)
+    {
+        return;
+    }
+
+    const auto query = queries_[(record * 2u) + 1u];
+
+    ::glQueryCounter(query, GL_TIMESTAMP);
+    ::glPopDebugGroup();
+
+    last_queries_[frame_ % frame_slots] = query;
+}
+
+auto GpuProfiler::scope_count() const -> std::uint32_t
+{
+    return scope_count_;
+}
+
+auto GpuProfiler::scope(std::uint32_t index) const -> const GpuScopeStats &
+{
+    return scopes_[index];
+}
+
+auto GpuProfiler::find(const char *name) const -> const GpuScopeStats *
+{
+    for (auto i = 0u; i < scope_count_; ++i)
+    {
+        if (same_name(scopes_[i].name, name))
+        {
+            return &scopes_[i];
+        }
+    }
+
+    return nullptr;
+}
+
+auto GpuProfiler::dump() const -> void
+{
+    static const char indent[] = "                ";
+
+    log_format("gpu profile (%u frames dropped, %u scopes dropped)", dropped_frames_, dropped_scopes_);
+
+    for (auto i = 0u; i < scope_count_; ++i)
+    {
+        const auto &scope = scopes_[i];
+        const auto min = to_microseconds(scope.min);
+        const auto average = to_microseconds(scope.average);
+        const auto max = to_microseconds(scope.max);
+
+        log_format(
+            "%s%s: min %d.%03dms avg %d.%03dms max %d.%03dms",
+            indent + (sizeof(indent) - 1u) - (scope.depth * 2u),
+            scope.name,
+            min / 1000,
+            min % 1000,
+            average / 1000,
+            average % 1000,
+            max / 1000,
+            max % 1000);
+    }
+}
+
+auto GpuProfiler::collect(std::uint32_t slot) -> void
+{
+    // the last query was written last so is the last to finish, if it isn't ready then don't wait for the rest
+    auto available = ::GLuint{};
+    ::glGetQueryObjectuiv(last_queries_[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE)
+    {
+        ++dropped_frames_;
+        return;
+    }
+
+    float totals[max_scopes]{};
+    bool seen[max_scopes]{};
+
+    for (auto i = 0u; i < record_counts_[slot]; ++i)
+    {
+        const auto record = (slot * max_records) + i;
+
+        auto start = ::GLuint64{};
+        auto end = ::GLuint64{};
+        ::glGetQueryObjectui64v(queries_[record * 2u], GL_QUERY_RESULT, &start);
+        ::glGetQueryObjectui64v(queries_[(record * 2u) + 1u], GL_QUERY_RESULT, &end);
+
+        // subtracting is fine but anything else 64 bit needs the CRT, so go via a signed value and double
+        const auto elapsed = static_cast<std::int64_t>(end - start);
+        const auto scope = record_scopes_[record];
+
+        totals[scope] += static_cast<float>(static_cast<double>(elapsed) / 1000000.0);
+        seen[scope] = true;
+    }
+
+    for (auto i = 0u; i < scope_count_; ++i)
+    {
+        if (!seen[i])
+        {
+            continue;
+        }
+
+        auto &scope = scopes_[i];
+        auto *history = history_ + (i * history_size);
+
+        history[scope.samples % history_size] = totals[i];
+        ++scope.samples;
+
+        const auto count = (scope.samples < history_size) ? scope.samples : history_size;
+        auto min = history[0];
+        auto max = history[0];
+        auto sum = 0.0f;
+
+        for (auto j = 0u; j < count; ++j)
+        {
+            min = (history[j] < min) ? history[j] : min;
+            max = (history[j] > max) ? history[j] : max;
+            sum += history[j];
+        }
+
+        scope.last = totals[i];
+        scope.min = min;
+        scope.average = sum / static_cast<float>(static_cast<std::int32_t>(count));
+        scope.max = max;
+    }
+}
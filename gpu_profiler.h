@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+
+#include "opengl.h"
+
+/**
+ * Rolling timings for a named scope, all in milliseconds over the last few frames it appeared in. The last time is from
+ * the most recently collected frame, which is a couple of frames behind the one being submitted.
+ */
+struct GpuScopeStats
+{
+    const char *name;
+    std::uint32_t depth;
+    std::uint32_t samples;
+    float last;
+    float min;
+    float average;
+    float max;
+};
+
+/**
+ * Class for measuring how GPU time is split across named scopes in a frame.
+ *
+ * Each scope writes a GL_TIMESTAMP query when it begins and ends, and is wrapped in a debug group so it also shows up
+ * in tools like RenderDoc and Nsight. Queries are double buffered by frame and a frame's results are only read back
+ * once the frame after it has been submitted, a frame that still isn't finished by then is dropped rather than
+ * stalling.
+ *
+ * A scope that appears more than once in a frame is reported as the sum of its appearances. Scopes started once a
+ * frame's records or the table of names are full aren't timed, they are counted and reported by dump() instead.
+ *
+ * Note that for simplicity no cleanup is performed.
+ */
+class GpuProfiler
+{
+  public:
+    /**
+     * Construct a new profiler, a GL context must be current.
+     */
+    GpuProfiler();
+
+    /**
+     * Start a frame, collecting the results of the last frame to use the same queries.
+     */
+    auto begin_frame() -> void;
+
+    /**
+     * End a frame, all scopes must have been ended.
+     */
+    auto end_frame() -> void;
+
+    /**
+     * Start a scope, nested inside whatever scope is currently open.
+     *
+     * @param name
+     *   Name of the scope, scopes are matched by name so this must outlive the profiler (e.g. a string literal).
+     */
+    auto begin_scope(const char *name) -> void;
+
+    /**
+     * End the most recently started scope.
+     */
+    auto end_scope() -> void;
+
+    /**
+     * Get the number of distinct scopes seen so far.
+     *
+     * @return
+     *   Number of scopes.
+     */
+    auto scope_count() const -> std::uint32_t;
+
+    /**
+     * Get the timings for a scope, in the order scopes were first seen.
+     *
+     * @param index
+     *   Index of the scope, must be less than scope_count().
+     *
+     * @return
+     *   Timings for the scope.
+     */
+    auto scope(std::uint32_t index) const -> const GpuScopeStats &;
+
+    /**
+     * Find the timings for a scope by name.
+     *
+     * @param name
+     *   Name of the scope.
+     *
+     * @return
+     *   Timings for the scope, or null if it hasn't been seen.
+     */
+    auto find(const char *name) const -> const GpuScopeStats *;
+
+    /**
+     * Write the timings for every scope to the log, indented by nesting depth.
+     */
+    auto dump() const -> void;
+
+  private:
+    /**
+     * Read back the queries of a finished frame and fold them in to the timings.
+     *
+     * @param slot
+     *   Which set of queries to read.
+     */
+    auto collect(std::uint32_t slot) -> void;
+
+    /** Number of frames of queries, results are read back this many frames late. */
+    static constexpr auto frame_slots = 2u;
+
+    /** Maximum number of scopes started in a single frame. */
+    static constexpr auto max_records = 128u;
+
+    /** Maximum number of distinct scope names. */
+    static constexpr auto max_scopes = 16u;
+
+    /** Maximum nesting depth. */
+    static constexpr auto max_depth = 8u;
+
+    /** Number of frames the timings are taken over. */
+    static constexpr auto history_size = 64u;
+
+    /** Timestamp queries, a begin and end pair for every record in every slot. */
+    ::GLuint *queries_;
+
+    /** Scope index of every record in every slot. */
+    std::uint32_t *record_scopes_;
+
+    /** Number of records written to each slot. */
+    std::uint32_t record_counts_[frame_slots];
+
+    /** Last query written in each slot, once it's available they all are. */
+    ::GLuint last_queries_[frame_slots];
+
+    /** Records of the currently open scopes. */
+    std::uint32_t stack_[max_depth];
+
+    /** Number of currently open scopes. */
+    std::uint32_t depth_;
+
+    /** Timings of every scope. */
+    GpuScopeStats scopes_[max_scopes];
+
+    /** Number of distinct scopes. */
+    std::uint32_t scope_count_;
+
+    /** Ring of the last history_size samples for every scope. */
+    float *history_;
+
+    /** Number of frames started. */
+    std::uint32_t frame_;
+
+    /** Number of frames whose results weren't ready in time and were thrown away. */
+    std::uint32_t dropped_frames_;
+
+    /** Number of scopes that weren't timed as there was no room to record them. */
+    std::uint32_t dropped_scopes_;
+};
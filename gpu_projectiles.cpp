@@ -0,0 +1,427 @@
+#include "gpu_projectiles.h"
+
+#include <cstdint>
+
+#include "buffer.h"
+#include "clib.h"
+#include "error.h"
+#include "material.h"
+#include "mesh.h"
+#include "opengl.h"
+#include "render_queue.h"
+#include "shader.h"
+#include "vector3.h"
+
+namespace
+{
+
+/** Threads in a work group, must match local_size_x in the shader. */
+static constexpr auto g_group_size = 64u;
+
+/** How long to wait for the gpu to finish with some hits before giving up, in nanoseconds. */
+static constexpr auto g_wait_timeout = ::GLuint64{1000000000u};
+
+/** Size of the indirect draw command at the start of each state buffer, padded so the projectiles are aligned. */
+static constexpr auto g_command_size = sizeof(std::uint32_t) * 8u;
+
+/** Size of one projectile in a state buffer, a position, previous position and velocity as vec4s. */
+static constexpr auto g_projectile_size = sizeof(float) * 12u;
+
+/**
+ * Parameters of an update, mirrors the params block in the shader.
+ */
+struct GpuProjectileParams
+{
+    float eye_range[4];
+    float alpha;
+    std::uint32_t steps;
+    std::uint32_t spawn_count;
+    std::uint32_t target_count;
+    std::uint32_t light_capacity;
+    std::uint32_t model_base;
+    std::uint32_t capacity;
+    std::uint32_t instance_base;
+    std::uint32_t light_base;
+
+    // std430 starts the vec4 array on the next 16 bytes
+    std::uint32_t padding[3];
+    float targets[gpu_projectile_max_targets][4];
+    float spawns[gpu_projectile_max_spawns][8];
+};
+
+// each thread either carries on an existing projectile or adds a new one, survivors are appended to the output so it's
+// compacted for free, the order changes from update to update but nothing depends on it
+const auto *g_compute_shader_src = R"(
+    #version 460 core
+
+    layout(local_size_x = 64) in;
+
+    struct DrawCommand
+    {
+        uint count;
+        uint instance_count;
+        uint first_index;
+        int base_vertex;
+        uint base_instance;
+        uint padding[3];
+    };
+
+    struct Projectile
+    {
+        vec4 position;
+        vec4 previous_position;
+        vec4 velocity;
+    };
+
+    struct Spawn
+    {
+        vec4 position;
+        vec4 velocity;
+    };
+
+    struct PointLight
+    {
+        vec3 point;
+        vec3 point_colour;
+        vec3 attenuation;
+    };
+
+    struct ModelData
+    {
+        mat4 model;
+        vec3 checker_colour1;
+        vec3 checker_colour2;
+        vec3 wood_colour1;
+        vec3 wood_colour2;
+        vec3 wood_colour3;
+        float wood_scale;
+        vec3 metal_colour;
+        vec3 water_colour1;
+        vec3 water_colour2;
+        float normal_scale;
+    };
+
+    layout(std430, binding = 1) buffer lights
+    {
+        int num_points;
+        PointLight points[];
+    };
+
+    layout(std430, binding = 2) buffer model_data
+    {
+        ModelData data[];
+    };
+
+    layout(std430, binding = 3) buffer instance_indices
+    {
+        uint instance_index[];
+    };
+
+    layout(std430, binding = 4) readonly buffer state_in
+    {
+        DrawCommand in_command;
+        Projectile in_projectiles[];
+    };
+
+    layout(std430, binding = 5) buffer state_out
+    {
+        DrawCommand out_command;
+        Projectile out_projectiles[];
+    };
+
+    layout(std430, binding = 6) readonly buffer params
+    {
+        vec4 eye_range;
+        float alpha;
+        uint steps;
+        uint spawn_count;
+        uint target_count;
+        uint light_capacity;
+        uint model_base;
+        uint capacity;
+        uint instance_base;
+        uint light_base;
+        vec4 targets[16];
+        Spawn spawns[16];
+    };
+
+    layout(std430, binding = 7) buffer hits
+    {
+        uint hit_counts[16];
+    };
+
+    const float scale = 0.1;
+    const vec3 colour = vec3(1.0, 0.0, 0.0);
+
+    void main()
+    {
+        uint index = gl_GlobalInvocationID.x;
+        uint live = in_command.instance_count;
+
+        Projectile projectile;
+        if (index < live)
+        {
+            projectile = in_projectiles[index];
+        }
+        else if (index - live < spawn_count)
+        {
+            Spawn spawn = spawns[index - live];
+            projectile = Projectile(spawn.position, spawn.position, spawn.velocity);
+        }
+        else
+        {
+            return;
+        }
+
+        for (uint step = 0u; step < steps; ++step)
+        {
+            vec3 offset = projectile.position.xyz - eye_range.xyz;
+            if (dot(offset, offset) > eye_range.w)
+            {
+                return;
+            }
+
+            projectile.previous_position = projectile.position;
+            projectile.position.xyz += projectile.velocity.xyz;
+
+            // the targets only move once the hit has been read back, so a hit projectile is removed rather than left
+            // to hit again every step until then
+            for (uint target = 0u; target < target_count; ++target)
+            {
+                if (distance(projectile.position.xyz, targets[target].xyz) < targets[target].w)
+                {
+                    atomicAdd(hit_counts[target], 1u);
+                    return;
+                }
+            }
+        }
+
+        // give back the slot if it's full, once the count has reached capacity it can never drop below it so every
+        // slot that was handed out is still written
+        uint slot = atomicAdd(out_command.instance_count, 1u);
+        if (slot >= capacity)
+        {
+            atomicAdd(out_command.instance_count, 0xffffffffu);
+            return;
+        }
+
+        out_projectiles[slot] = projectile;
+        instance_index[instance_base + slot] = model_base + slot;
+
+        vec3 position = mix(projectile.previous_position.xyz, projectile.position.xyz, alpha);
+
+        mat4 model = mat4(scale);
+        model[3] = vec4(position, 1.0);
+
+        data[model_base + slot] = ModelData(
+            model,
+            colour,
+            colour,
+            vec3(0.0),
+            vec3(0.0),
+            vec3(0.0),
+            0.0,
+            vec3(0.0),
+            vec3(0.0),
+            vec3(0.0),
+            0.0);
+
+        // the first lights belong to the caller
+        if (slot < light_capacity)
+        {
+            points[light_base + slot] = PointLight(position, colour, vec3(1.0, 0.01, 0.032));
+            atomicMax(num_points, int(light_base + slot) + 1);
+        }
+    }
+)";
+
+}
+
+GpuProjectiles::GpuProjectiles(std::uint32_t capacity, const Mesh &mesh, std::uint32_t lod)
+    : program_{Shader{g_compute_shader_src, ShaderType::COMPUTE}}
+    , capacity_{capacity}
+    , states_{
+          Buffer{g_command_size + (g_projectile_size * capacity)},
+          Buffer{g_command_size + (g_projectile_size * capacity)}}
+    , current_{}
+    , command_{}
+    , params_{sizeof(GpuProjectileParams)}
+    , hit_buffers_{
+          Buffer{sizeof(std::uint32_t) * gpu_projectile_max_targets},
+          Buffer{sizeof(std::uint32_t) * gpu_projectile_max_targets},
+          Buffer{sizeof(std::uint32_t) * gpu_projectile_max_targets},
+          Buffer{sizeof(std::uint32_t) * gpu_projectile_max_targets}}
+    , fences_{}
+    , first_fence_{}
+    , fence_count_{}
+    , hits_{}
+    , spawn_count_{}
+    , mesh_{&mesh}
+    , lod_{lod}
+{
+    const auto index_size = (mesh.index_type() == GL_UNSIGNED_SHORT) ? 2u : 4u;
+
+    // the instance count and base instance are filled in by each update
+    command_[0] = mesh.index_count(lod);
+    command_[2] = static_cast<std::uint32_t>(mesh.index_offset(lod)) / index_size;
+    command_[3] = static_cast<std::uint32_t>(mesh.base_vertex(lod));
+
+    for (const auto &state : states_)
+    {
+        state.write(reinterpret_cast<const std::uint8_t *>(command_), sizeof(command_), 0u);
+    }
+}
+
+auto GpuProjectiles::spawn(const Vector3 &position, const Vector3 &velocity) -> bool
+{
+    if (spawn_count_ == gpu_projectile_max_spawns)
+    {
+        return false;
+    }
+
+    auto *spawn = spawns_[spawn_count_];
+    spawn[0] = position.x;
+    spawn[1] = position.y;
+    spawn[2] = position.z;
+    spawn[3] = 0.0f;
+    spawn[4] = velocity.x;
+    spawn[5] = velocity.y;
+    spawn[6] = velocity.z;
+    spawn[7] = 0.0f;
+    ++spawn_count_;
+
+    return true;
+}
+
+auto GpuProjectiles::update(
+    std::uint32_t steps,
+    float alpha,
+    const Vector3 &eye,
+    float range,
+    const Vector3 *targets,
+    const float *radii,
+    std::uint32_t target_count,
+    std::uint32_t light_base,
+    std::uint32_t light_capacity,
+    std::uint32_t model_base,
+    std::uint32_t instance_base,
+    RenderQueue *queue) -> void
+{
+    ensure(target_count <= gpu_projectile_max_targets, ErrorCode::GPU_PROJECTILES_TOO_MANY_TARGETS);
+
+    // only what the shader reads is written, zeroing the whole thing would pull in memset
+    GpuProjectileParams params;
+    params.eye_range[0] = eye.x;
+    params.eye_range[1] = eye.y;
+    params.eye_range[2] = eye.z;
+    params.eye_range[3] = range * range;
+    params.alpha = alpha;
+    params.steps = steps;
+    params.spawn_count = spawn_count_;
+    params.target_count = target_count;
+    params.light_capacity = light_capacity;
+    params.model_base = model_base;
+    params.capacity = capacity_;
+    params.instance_base = instance_base;
+    params.light_base = light_base;
+
+    for (auto i = 0u; i < target_count; ++i)
+    {
+        params.targets[i][0] = targets[i].x;
+        params.targets[i][1] = targets[i].y;
+        params.targets[i][2] = targets[i].z;
+        params.targets[i][3] = radii[i];
+    }
+
+    memcpy(params.spawns, spawns_, sizeof(spawns_[0]) * spawn_count_);
+    spawn_count_ = 0u;
+
+    params_.write(reinterpret_cast<const std::uint8_t *>(&params), sizeof(params), 0u);
+
+    // the ring is full when the gpu is more than a few updates behind, only then is it worth waiting
+    while (fence_count_ == hit_latency)
+    {
+        collect(true);
+    }
+
+    const auto hit_slot = (first_fence_ + fence_count_) % hit_latency;
+    const std::uint32_t no_hits[gpu_projectile_max_targets]{};
+    hit_buffers_[hit_slot].write(reinterpret_cast<const std::uint8_t *>(no_hits), sizeof(no_hits), 0u);
+
+    const auto &input = states_[current_];
+    current_ ^= 1u;
+    const auto &output = states_[current_];
+    command_[4] = instance_base;
+    output.write(reinterpret_cast<const std::uint8_t *>(command_), sizeof(command_), 0u);
+
+    queue->bind_buffer(GL_SHADER_STORAGE_BUFFER, 4u, input.native_handle());
+    queue->bind_buffer(GL_SHADER_STORAGE_BUFFER, 5u, output.native_handle());
+    queue->bind_buffer(GL_SHADER_STORAGE_BUFFER, 6u, params_.native_handle());
+    queue->bind_buffer(GL_SHADER_STORAGE_BUFFER, 7u, hit_buffers_[hit_slot].native_handle());
+
+    // enough threads for a full buffer plus every spawn, the ones past the live count return straight away
+    queue->dispatch(program_, (capacity_ + gpu_projectile_max_spawns + g_group_size - 1u) / g_group_size);
+
+    // the draw reads the command, the shaders read the instances and lights and the hits are read back by mapping
+    ::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    fences_[hit_slot] = ::glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++fence_count_;
+}
+
+auto GpuProjectiles::submit(const Material &material, const char *label, RenderQueue *queue) const -> void
+{
+    queue->submit(
+        make_sort_key(
+            RenderPass::SOLID, material.native_handle(), (mesh_->native_handle() * max_mesh_lods) + lod_, 0u),
+        {.material = &material,
+         .mesh = mesh_,
+         .label = label,
+         .indirect_buffer = states_[current_].native_handle()});
+}
+
+auto GpuProjectiles::read_hits(std::uint32_t *hits) -> std::uint32_t
+{
+    while ((fence_count_ != 0u) && collect(false))
+    {
+    }
+
+    auto total = 0u;
+
+    for (auto i = 0u; i < gpu_projectile_max_targets; ++i)
+    {
+        hits[i] += hits_[i];
+        total += hits_[i];
+        hits_[i] = 0u;
+    }
+
+    return total;
+}
+
+auto GpuProjectiles::collect(bool wait) -> bool
+{
+    const auto result =
+        ::glClientWaitSync(fences_[first_fence_], GL_SYNC_FLUSH_COMMANDS_BIT, wait ? g_wait_timeout : 0u);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        return false;
+    }
+
+    ensure(result != GL_WAIT_FAILED, ErrorCode::GPU_PROJECTILES_WAIT_FAILED);
+
+    const auto handle = hit_buffers_[first_fence_].native_handle();
+    const auto *counts = static_cast<const std::uint32_t *>(::glMapNamedBuffer(handle, GL_READ_ONLY));
+
+    for (auto i = 0u; i < gpu_projectile_max_targets; ++i)
+    {
+        hits_[i] += counts[i];
+    }
+
+    ::glUnmapNamedBuffer(handle);
+
+    ::glDeleteSync(fences_[first_fence_]);
+    first_fence_ = (first_fence_ + 1u) % hit_latency;
+    --fence_count_;
+
+    return true;
+}
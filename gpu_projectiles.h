@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+
+#include "buffer.h"
+#include "material.h"
+#include "mesh.h"
+#include "opengl.h"
+#include "render_queue.h"
+#include "vector3.h"
+
+/** Most projectiles that can be spawned between two updates. */
+static constexpr auto gpu_projectile_max_spawns = 16u;
+
+/** Most targets projectiles can be tested against. */
+static constexpr auto gpu_projectile_max_targets = 16u;
+
+/**
+ * Class simulating projectiles entirely in a compute shader.
+ *
+ * The state lives in a pair of storage buffers that are swapped every update. One dispatch adds any new projectiles,
+ * runs the simulation steps, culls anything out of range or that hit a target, compacts the survivors into the other
+ * buffer and writes their instance data and lights. The header of each state buffer doubles as the indirect draw
+ * command for it, so the cpu never learns how many projectiles there are.
+ *
+ * Hits are counted per target and read back a few frames later, once a fence says the gpu is done with them, so
+ * reading never stalls.
+ *
+ * Bindings 4 to 7 are used for the projectile buffers, the instance data, instance indices and lights are written to
+ * whatever is bound at 2, 3 and 1 as the uber shader expects. Note that for simplicity no cleanup is performed.
+ */
+class GpuProjectiles
+{
+  public:
+    /**
+     * Construct a new, empty, projectile system.
+     *
+     * @param capacity
+     *   Most projectiles that can be alive at once.
+     * @param mesh
+     *   The mesh to draw each projectile with.
+     * @param lod
+     *   The level of detail to draw, the gpu doesn't pick one per projectile.
+     */
+    GpuProjectiles(std::uint32_t capacity, const Mesh &mesh, std::uint32_t lod);
+
+    /**
+     * Queue a projectile to be added on the next update.
+     *
+     * @param position
+     *   Starting position.
+     * @param velocity
+     *   Distance moved each step.
+     *
+     * @return
+     *   True if queued, false if too many have been queued since the last update.
+     */
+    auto spawn(const Vector3 &position, const Vector3 &velocity) -> bool;
+
+    /**
+     * Add the queued projectiles and run the simulation. Lights are appended after the caller's own, which it must have
+     * written along with their count.
+     *
+     * @param steps
+     *   Number of simulation steps to run, may be zero to just interpolate.
+     * @param alpha
+     *   How far between the previous and current step to place the instances and lights.
+     * @param eye
+     *   Point range is measured from.
+     * @param range
+     *   Furthest a projectile can be from the eye.
+     * @param targets
+     *   Centres of the targets.
+     * @param radii
+     *   Hit radius of each target.
+     * @param target_count
+     *   Number of targets, at most gpu_projectile_max_targets.
+     * @param light_base
+     *   Number of lights the caller wrote, the first light is written after them.
+     * @param light_capacity
+     *   Most lights to write after the caller's.
+     * @param model_base
+     *   Index of the first instance to write in the model buffer, capacity instances must be free from there.
+     * @param instance_base
+     *   Index of the first entry to write in the instance index buffer, capacity entries must be free from there.
+     * @param queue
+     *   Queue to bind and dispatch with.
+     */
+    auto update(
+        std::uint32_t steps,
+        float alpha,
+        const Vector3 &eye,
+        float range,
+        const Vector3 *targets,
+        const float *radii,
+        std::uint32_t target_count,
+        std::uint32_t light_base,
+        std::uint32_t light_capacity,
+        std::uint32_t model_base,
+        std::uint32_t instance_base,
+        RenderQueue *queue) -> void;
+
+    /**
+     * Queue the draw of the projectiles from the last update.
+     *
+     * @param material
+     *   Material to draw with.
+     * @param label
+     *   Profiler scope to draw under, may be null.
+     * @param queue
+     *   Queue to submit to.
+     */
+    auto submit(const Material &material, const char *label, RenderQueue *queue) const -> void;
+
+    /**
+     * Collect the hits from any updates the gpu has finished, without waiting.
+     *
+     * @param hits
+     *   Array of gpu_projectile_max_targets counts, each target's hits are added to its count.
+     *
+     * @return
+     *   Total number of hits collected.
+     */
+    auto read_hits(std::uint32_t *hits) -> std::uint32_t;
+
+  private:
+    /**
+     * Read back the oldest pending hits.
+     *
+     * @param wait
+     *   Whether to wait for the gpu if it hasn't finished with them yet.
+     *
+     * @return
+     *   True if they were read, false if the gpu wasn't finished.
+     */
+    auto collect(bool wait) -> bool;
+
+    /** Number of updates that can be in flight before reading their hits has to wait. */
+    static constexpr auto hit_latency = 4u;
+
+    /** Compute program. */
+    Material program_;
+
+    /** Most projectiles that can be alive at once. */
+    std::uint32_t capacity_;
+
+    /** Projectile state, each written by one update and read by the next. */
+    Buffer states_[2];
+
+    /** Index of the state buffer written by the last update. */
+    std::uint32_t current_;
+
+    /** Indirect draw command every update starts its output from. */
+    std::uint32_t command_[8];
+
+    /** Parameters of the next update, mirrors the params block in the shader. */
+    Buffer params_;
+
+    /** Ring of per target hit counts, one per update in flight. */
+    Buffer hit_buffers_[hit_latency];
+
+    /** Fence after each update in flight, oldest first. */
+    ::GLsync fences_[hit_latency];
+
+    /** Index of the oldest update in flight. */
+    std::uint32_t first_fence_;
+
+    /** Number of updates in flight. */
+    std::uint32_t fence_count_;
+
+    /** Hits read back but not yet collected by the caller. */
+    std::uint32_t hits_[gpu_projectile_max_targets];
+
+    /** Positions and velocities queued for the next update, as vec4 pairs. */
+    float spawns_[gpu_projectile_max_spawns][8];
+
+    /** Number of projectiles queued for the next update. */
+    std::uint32_t spawn_count_;
+
+    /** Mesh to draw each projectile with. */
+    const Mesh *mesh_;
+
+    /** Level of detail of the mesh to draw. */
+    std::uint32_t lod_;
+};
@@ -0,0 +1,362 @@
+#include "input_log.h"
+
+#include <cstdint>
+
+#include <Windows.h>
+
+#include "clib.h"
+#include "error.h"
+#include "event.h"
+#include "log.h"
+#include "window.h"
+
+namespace
+{
+
+/** Magic number at the start of every input log, bump if the format changes. */
+static constexpr auto g_input_log_magic = std::uint32_t{0x324c4954u};
+
+/**
+ * Header at the start of an input log.
+ */
+struct InputLogHeader
+{
+    std::uint32_t magic;
+    std::uint32_t seed;
+};
+
+/**
+ * Header before the events of each frame. The events follow as a type byte then a key byte, two 16 bit mouse deltas or
+ * nothing, depending on the type.
+ */
+#pragma pack(push, 1)
+struct InputLogFrame
+{
+    std::uint16_t event_count;
+    float delta;
+    float cpu_time;
+    float gpu_time;
+};
+#pragma pack(pop)
+
+/**
+ * Helper function to convert a time to whole microseconds, for logging as fixed point.
+ *
+ * @param seconds
+ *   Time in seconds.
+ *
+ * @return
+ *   Time in microseconds.
+ */
+auto to_microseconds(float seconds) -> int
+{
+    return to_int(seconds * 1000000.0f + 0.5f);
+}
+
+/**
+ * Helper function to clamp a mouse delta to what the log can store, raw deltas are whole numbers of counts so this is
+ * exact for any sensible movement.
+ *
+ * @param delta
+ *   The delta.
+ *
+ * @return
+ *   The delta as a 16 bit integer.
+ */
+auto to_delta(float delta) -> std::int16_t
+{
+    const auto value = to_int(delta);
+    return static_cast<std::int16_t>((value < -32768) ? -32768 : (value > 32767) ? 32767 : value);
+}
+
+}
+
+InputLog::InputLog()
+    : mode_{InputLogMode::OFF}
+    , file_{INVALID_HANDLE_VALUE}
+    , data_{}
+    , size_{}
+    , cursor_{}
+    , remaining_events_{}
+    , frame_started_{}
+    , recorded_cpu_time_{}
+    , recorded_gpu_time_{}
+    , frame_delta_{}
+    , frame_size_{}
+    , frame_events_{}
+    , frames_{}
+    , cpu_time_sums_{}
+    , gpu_time_sums_{}
+    , max_cpu_time_{}
+    , max_gpu_time_{}
+{
+    char path[MAX_PATH];
+
+    if (::GetEnvironmentVariableA("TEKTITE_REPLAY_INPUT", path, sizeof(path)) != 0)
+    {
+        const auto file =
+            ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        ensure(file != INVALID_HANDLE_VALUE, ErrorCode::FAILED_TO_READ_INPUT_LOG);
+
+        size_ = ::GetFileSize(file, nullptr);
+        data_ = static_cast<std::uint8_t *>(malloc(size_));
+
+        auto read = ::DWORD{};
+        const auto read_res = ::ReadFile(file, data_, size_, &read, nullptr);
+        ::CloseHandle(file);
+
+        auto header = InputLogHeader{};
+        ensure(read_res && (read == size_) && (size_ >= sizeof(header)), ErrorCode::FAILED_TO_READ_INPUT_LOG);
+
+        memcpy(&header, data_, sizeof(header));
+        ensure(header.magic == g_input_log_magic, ErrorCode::FAILED_TO_READ_INPUT_LOG);
+
+        cursor_ = sizeof(header);
+        seed_rand(header.seed);
+        mode_ = InputLogMode::REPLAY;
+
+        // failing to write the report isn't fatal, the summary still gets logged
+        char report_path[MAX_PATH + 4];
+        ::wsprintfA(report_path, "%s.csv", path);
+        file_ = ::CreateFileA(report_path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (file_ != INVALID_HANDLE_VALUE)
+        {
+            static const char columns[] = "frame,recorded_cpu_ms,recorded_gpu_ms,cpu_ms,gpu_ms\n";
+            auto written = ::DWORD{};
+            ::WriteFile(file_, columns, sizeof(columns) - 1u, &written, nullptr);
+        }
+
+        log_format("replaying input from %s (seed %u)", path, header.seed);
+    }
+    else if (::GetEnvironmentVariableA("TEKTITE_RECORD_INPUT", path, sizeof(path)) != 0)
+    {
+        file_ = ::CreateFileA(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        ensure(file_ != INVALID_HANDLE_VALUE, ErrorCode::FAILED_TO_WRITE_INPUT_LOG);
+
+        const auto header = InputLogHeader{.magic = g_input_log_magic, .seed = static_cast<std::uint32_t>(rand())};
+        seed_rand(header.seed);
+        mode_ = InputLogMode::RECORD;
+
+        auto written = ::DWORD{};
+        ensure(
+            ::WriteFile(file_, &header, sizeof(header), &written, nullptr) && (written == sizeof(header)),
+            ErrorCode::FAILED_TO_WRITE_INPUT_LOG);
+
+        log_format("recording input to %s (seed %u)", path, header.seed);
+    }
+}
+
+auto InputLog::pump_message(Window *window, Event *evt, std::int64_t until) -> bool
+{
+    switch (mode_)
+    {
+        case InputLogMode::OFF: return window->pump_message(evt, until);
+        case InputLogMode::RECORD:
+        {
+            if (!window->pump_message(evt, until))
+            {
+                return false;
+            }
+
+            ensure(frame_size_ + 5u <= max_frame_size, ErrorCode::FAILED_TO_WRITE_INPUT_LOG);
+
+            frame_data_[frame_size_++] = static_cast<std::uint8_t>(evt->type);
+
+            if ((evt->type == EventType::KEY_DOWN) || (evt->type == EventType::KEY_UP))
+            {
+                frame_data_[frame_size_++] = evt->data.key;
+            }
+            else if (evt->type == EventType::MOUSE_MOVE)
+            {
+                const std::int16_t deltas[] = {
+                    to_delta(evt->data.mouse_move.delta_x), to_delta(evt->data.mouse_move.delta_y)};
+                memcpy(frame_data_ + frame_size_, deltas, sizeof(deltas));
+                frame_size_ += sizeof(deltas);
+            }
+
+            ++frame_events_;
+            return true;
+        }
+        case InputLogMode::REPLAY:
+        {
+            if (!frame_started_)
+            {
+                // keep the window responsive, but nothing real gets through
+                auto ignored = Event{};
+                while (window->pump_message(&ignored, until))
+                {
+                }
+
+                frame_started_ = true;
+
+                auto frame = InputLogFrame{};
+                ensure(cursor_ + sizeof(frame) <= size_, ErrorCode::FAILED_TO_READ_INPUT_LOG);
+                memcpy(&frame, data_ + cursor_, sizeof(frame));
+                cursor_ += sizeof(frame);
+
+                remaining_events_ = frame.event_count;
+                frame_delta_ = frame.delta;
+                recorded_cpu_time_ = frame.cpu_time;
+                recorded_gpu_time_ = frame.gpu_time;
+            }
+
+            if (remaining_events_ == 0u)
+            {
+                return false;
+            }
+
+            ensure(cursor_ < size_, ErrorCode::FAILED_TO_READ_INPUT_LOG);
+            // stamp replayed events as they are handed out, latency is measured from the replay not the recording
+            auto now = ::LARGE_INTEGER{};
+            ::QueryPerformanceCounter(&now);
+            *evt = {.type = static_cast<EventType>(data_[cursor_++]), .time = now.QuadPart};
+
+            if ((evt->type == EventType::KEY_DOWN) || (evt->type == EventType::KEY_UP))
+            {
+                ensure(cursor_ + 1u <= size_, ErrorCode::FAILED_TO_READ_INPUT_LOG);
+                evt->data.key = data_[cursor_++];
+            }
+            else if (evt->type == EventType::MOUSE_MOVE)
+            {
+                std::int16_t deltas[2];
+                ensure(cursor_ + sizeof(deltas) <= size_, ErrorCode::FAILED_TO_READ_INPUT_LOG);
+                memcpy(deltas, data_ + cursor_, sizeof(deltas));
+                cursor_ += sizeof(deltas);
+
+                evt->data.mouse_move = {static_cast<float>(deltas[0]), static_cast<float>(deltas[1])};
+            }
+
+            --remaining_events_;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+auto InputLog::frame_delta(float delta) -> float
+{
+    if (mode_ != InputLogMode::REPLAY)
+    {
+        frame_delta_ = delta;
+    }
+
+    return frame_delta_;
+}
+
+auto InputLog::end_frame(float cpu_time, float gpu_time) -> void
+{
+    switch (mode_)
+    {
+        case InputLogMode::OFF: break;
+        case InputLogMode::RECORD:
+        {
+            const auto frame = InputLogFrame{
+                .event_count = static_cast<std::uint16_t>(frame_events_),
+                .delta = frame_delta_,
+                .cpu_time = cpu_time,
+                .gpu_time = gpu_time};
+
+            auto written = ::DWORD{};
+            ensure(
+                ::WriteFile(file_, &frame, sizeof(frame), &written, nullptr) && (written == sizeof(frame)) &&
+                    ::WriteFile(file_, frame_data_, frame_size_, &written, nullptr) && (written == frame_size_),
+                ErrorCode::FAILED_TO_WRITE_INPUT_LOG);
+
+            frame_size_ = 0u;
+            frame_events_ = 0u;
+            ++frames_;
+            break;
+        }
+        case InputLogMode::REPLAY:
+        {
+            if (!frame_started_)
+            {
+                break;
+            }
+
+            if (file_ != INVALID_HANDLE_VALUE)
+            {
+                const int times[] = {
+                    to_microseconds(recorded_cpu_time_),
+                    to_microseconds(recorded_gpu_time_),
+                    to_microseconds(cpu_time),
+                    to_microseconds(gpu_time)};
+
+                char line[128];
+                const auto length = ::wsprintfA(
+                    line,
+                    "%u,%d.%03d,%d.%03d,%d.%03d,%d.%03d\n",
+                    frames_,
+                    times[0] / 1000,
+                    times[0] % 1000,
+                    times[1] / 1000,
+                    times[1] % 1000,
+                    times[2] / 1000,
+                    times[2] % 1000,
+                    times[3] / 1000,
+                    times[3] % 1000);
+
+                auto written = ::DWORD{};
+                ::WriteFile(file_, line, length, &written, nullptr);
+            }
+
+            cpu_time_sums_[0] += recorded_cpu_time_;
+            gpu_time_sums_[0] += recorded_gpu_time_;
+            cpu_time_sums_[1] += cpu_time;
+            gpu_time_sums_[1] += gpu_time;
+            max_cpu_time_ = (cpu_time > max_cpu_time_) ? cpu_time : max_cpu_time_;
+            max_gpu_time_ = (gpu_time > max_gpu_time_) ? gpu_time : max_gpu_time_;
+
+            frame_started_ = false;
+            ++frames_;
+
+            if (finished())
+            {
+                report();
+            }
+            break;
+        }
+    }
+}
+
+auto InputLog::mode() const -> InputLogMode
+{
+    return mode_;
+}
+
+auto InputLog::finished() const -> bool
+{
+    return (mode_ == InputLogMode::REPLAY) && !frame_started_ && (cursor_ >= size_);
+}
+
+auto InputLog::report() const -> void
+{
+    const auto frames = static_cast<float>(static_cast<std::int32_t>(frames_ != 0u ? frames_ : 1u));
+    const int times[] = {
+        to_microseconds(cpu_time_sums_[0] / frames),
+        to_microseconds(cpu_time_sums_[1] / frames),
+        to_microseconds(max_cpu_time_),
+        to_microseconds(gpu_time_sums_[0] / frames),
+        to_microseconds(gpu_time_sums_[1] / frames),
+        to_microseconds(max_gpu_time_)};
+
+    log_format("replayed %u frames", frames_);
+    log_format(
+        "cpu: recorded avg %d.%03dms, replayed avg %d.%03dms max %d.%03dms",
+        times[0] / 1000,
+        times[0] % 1000,
+        times[1] / 1000,
+        times[1] % 1000,
+        times[2] / 1000,
+        times[2] % 1000);
+    log_format(
+        "gpu: recorded avg %d.%03dms, replayed avg %d.%03dms max %d.%03dms",
+        times[3] / 1000,
+        times[3] % 1000,
+        times[4] / 1000,
+        times[4] % 1000,
+        times[5] / 1000,
+        times[5] % 1000);
+}
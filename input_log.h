@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+
+#include <Windows.h>
+
+#include "event.h"
+#include "window.h"
+
+/**
+ * What an input log is doing.
+ */
+enum class InputLogMode
+{
+    OFF,
+    RECORD,
+    REPLAY,
+};
+
+/**
+ * Class for recording the input of a run and replaying it, so a benchmark can be repeated exactly across builds.
+ *
+ * Setting TEKTITE_RECORD_INPUT to a path records every event from the window, frame by frame, along with the frame's
+ * timings and how far it advanced the simulation. Setting TEKTITE_REPLAY_INPUT to a recorded path ignores the real
+ * input and feeds back the recorded events instead, one recorded frame per frame, and stops once they run out. Both
+ * seed rand() (recording picks the seed and stores it) so enemy placement is the same each time.
+ *
+ * A replay writes the recorded and replayed timings of every frame to <path>.csv and logs a summary at the end.
+ *
+ * Note that for simplicity no cleanup is performed.
+ */
+class InputLog
+{
+  public:
+    /**
+     * Construct a new input log, the mode comes from the environment.
+     */
+    InputLog();
+
+    /**
+     * Get the next event for this frame, use in place of Window::pump_message.
+     *
+     * @param window
+     *   Window to pump, messages are still pumped when replaying but their events are dropped.
+     * @param evt
+     *   The event to populate.
+     * @param until
+     *   QueryPerformanceCounter value to stop at, ignored when replaying as the log already says which frame each event
+     *   belongs to.
+     *
+     * @return
+     *   True if an event was retrieved, false otherwise.
+     */
+    auto pump_message(Window *window, Event *evt, std::int64_t until) -> bool;
+
+    /**
+     * Get the time the simulation should advance by this frame, must be called after the frame's events are pumped.
+     *
+     * @param delta
+     *   Measured time since the last frame in seconds.
+     *
+     * @return
+     *   The recorded time if replaying, otherwise the measured time (which is recorded if recording).
+     */
+    auto frame_delta(float delta) -> float;
+
+    /**
+     * End a frame, must be called once per frame after all its events have been pumped.
+     *
+     * @param cpu_time
+     *   CPU time of the frame in seconds.
+     * @param gpu_time
+     *   GPU time of the frame in seconds (or whatever frame's result is most recent).
+     */
+    auto end_frame(float cpu_time, float gpu_time) -> void;
+
+    /**
+     * Get the mode.
+     *
+     * @return
+     *   What the log is doing.
+     */
+    auto mode() const -> InputLogMode;
+
+    /**
+     * Check if a replay has run out of recorded frames.
+     *
+     * @return
+     *   True if replaying and there are no frames left, false otherwise.
+     */
+    auto finished() const -> bool;
+
+  private:
+    /**
+     * Log a summary of the replay.
+     */
+    auto report() const -> void;
+
+    /** Largest number of bytes of events in a single frame. */
+    static constexpr auto max_frame_size = 4096u;
+
+    /** What the log is doing. */
+    InputLogMode mode_;
+
+    /** The log being recorded, or the timings report being written when replaying. */
+    ::HANDLE file_;
+
+    /** Recorded log being replayed. */
+    std::uint8_t *data_;
+
+    /** Size of the recorded log. */
+    std::uint32_t size_;
+
+    /** Offset of the next unread byte of the recorded log. */
+    std::uint32_t cursor_;
+
+    /** Number of events left in the frame being replayed. */
+    std::uint32_t remaining_events_;
+
+    /** Whether the header of the frame being replayed has been read. */
+    bool frame_started_;
+
+    /** CPU time of the frame being replayed when it was recorded. */
+    float recorded_cpu_time_;
+
+    /** GPU time of the frame being replayed when it was recorded. */
+    float recorded_gpu_time_;
+
+    /** Time the current frame advances the simulation by. */
+    float frame_delta_;
+
+    /** Events of the frame being recorded. */
+    std::uint8_t frame_data_[max_frame_size];
+
+    /** Number of bytes of events in the frame being recorded. */
+    std::uint32_t frame_size_;
+
+    /** Number of events in the frame being recorded. */
+    std::uint32_t frame_events_;
+
+    /** Number of frames recorded or replayed. */
+    std::uint32_t frames_;
+
+    /** Sum of the CPU times, recorded then replayed. */
+    float cpu_time_sums_[2];
+
+    /** Sum of the GPU times, recorded then replayed. */
+    float gpu_time_sums_[2];
+
+    /** Largest CPU time replayed. */
+    float max_cpu_time_;
+
+    /** Largest GPU time replayed. */
+    float max_gpu_time_;
+};
@@ -0,0 +1,113 @@
+#include "instance_allocator.h"
+
+#include <cstdint>
+
+#include "clib.h"
+#include "error.h"
+#include "model_data.h"
+
+namespace
+{
+
+/** Smallest capacity a range grows to, so a range that starts empty doesn't repack on every early add. */
+static constexpr auto g_min_capacity = 16u;
+
+}
+
+InstanceAllocator::InstanceAllocator()
+    : layout_{}
+    , capacities_{}
+    , instances_{}
+    , repacks_{}
+{
+}
+
+auto InstanceAllocator::add_range(std::uint32_t capacity) -> std::uint32_t
+{
+    ensure(layout_.range_count < max_instance_ranges, ErrorCode::TOO_MANY_INSTANCE_RANGES);
+
+    const auto range = layout_.range_count++;
+    capacities_[range] = capacity;
+    layout_.counts[range] = 0u;
+
+    repack();
+
+    return range;
+}
+
+auto InstanceAllocator::resize(std::uint32_t range, std::uint32_t count) -> void
+{
+    if (count > capacities_[range])
+    {
+        // doubling keeps the cost of repacking constant per instance added
+        auto capacity = (capacities_[range] < g_min_capacity) ? g_min_capacity : capacities_[range];
+        while (capacity < count)
+        {
+            capacity *= 2u;
+        }
+
+        capacities_[range] = capacity;
+        repack();
+    }
+
+    layout_.counts[range] = count;
+}
+
+auto InstanceAllocator::instances(std::uint32_t range) -> ModelData *
+{
+    return instances_ + layout_.bases[range];
+}
+
+auto InstanceAllocator::data() -> ModelData *
+{
+    return instances_;
+}
+
+auto InstanceAllocator::data() const -> const ModelData *
+{
+    return instances_;
+}
+
+auto InstanceAllocator::layout() const -> const InstanceLayout &
+{
+    return layout_;
+}
+
+auto InstanceAllocator::repacks() const -> std::uint32_t
+{
+    return repacks_;
+}
+
+auto InstanceAllocator::repack() -> void
+{
+    auto total = 0u;
+    std::uint32_t bases[max_instance_ranges];
+
+    for (auto i = 0u; i < layout_.range_count; ++i)
+    {
+        bases[i] = total;
+        total += capacities_[i];
+    }
+
+    // only the live instances are copied, the spare capacity has nothing worth keeping
+    auto *instances = static_cast<ModelData *>(malloc_aligned16(sizeof(ModelData) * ((total != 0u) ? total : 1u)));
+
+    if (instances_ != nullptr)
+    {
+        for (auto i = 0u; i < layout_.range_count; ++i)
+        {
+            memcpy(instances + bases[i], instances_ + layout_.bases[i], sizeof(ModelData) * layout_.counts[i]);
+        }
+
+        free_aligned16(instances_);
+    }
+
+    for (auto i = 0u; i < layout_.range_count; ++i)
+    {
+        layout_.bases[i] = bases[i];
+    }
+
+    instances_ = instances;
+    layout_.total = total;
+    ++repacks_;
+}
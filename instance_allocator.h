@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+
+#include "model_data.h"
+
+/** Most ranges an allocator can hold. */
+static constexpr auto max_instance_ranges = 8u;
+
+/**
+ * Where each range of an allocator starts and how many instances it has, everything needed to find an instance in the
+ * model buffer. Small enough to copy into every frame snapshot.
+ */
+struct InstanceLayout
+{
+    /** Index of the first instance of each range. */
+    std::uint32_t bases[max_instance_ranges];
+
+    /** Number of instances in each range. */
+    std::uint32_t counts[max_instance_ranges];
+
+    /** Number of ranges. */
+    std::uint32_t range_count;
+
+    /** Number of instances spanned by every range, including their spare capacity. */
+    std::uint32_t total;
+};
+
+/**
+ * Class for allocating instances in contiguous ranges, one per mesh type, so each type can still be drawn with base
+ * instances.
+ *
+ * Every range has some spare capacity after it. When a range outgrows that its capacity is doubled and all the ranges
+ * are repacked into a new block, so a range never overlaps the next and the block never has gaps bigger than the spare
+ * capacity. Any pointers to instances are invalidated by a repack.
+ *
+ * Note that for simplicity no cleanup is performed.
+ */
+class InstanceAllocator
+{
+  public:
+    /**
+     * Construct a new allocator with no ranges.
+     */
+    InstanceAllocator();
+
+    /**
+     * Add a range to the end of the block.
+     *
+     * @param capacity
+     *   Number of instances to reserve, the range starts empty.
+     *
+     * @return
+     *   Index of the new range.
+     */
+    auto add_range(std::uint32_t capacity) -> std::uint32_t;
+
+    /**
+     * Change the number of instances in a range, repacking if it doesn't fit. New instances are uninitialised.
+     *
+     * @param range
+     *   Index of the range.
+     * @param count
+     *   New number of instances.
+     */
+    auto resize(std::uint32_t range, std::uint32_t count) -> void;
+
+    /**
+     * Get the instances of a range.
+     *
+     * @param range
+     *   Index of the range.
+     *
+     * @return
+     *   Pointer to the first instance, valid until the next repack.
+     */
+    auto instances(std::uint32_t range) -> ModelData *;
+
+    /**
+     * Get the whole block of instances, laid out as described by layout().
+     *
+     * @return
+     *   Pointer to the first instance of the first range.
+     */
+    auto data() -> ModelData *;
+
+    /**
+     * Get the whole block of instances, laid out as described by layout().
+     *
+     * @return
+     *   Pointer to the first instance of the first range.
+     */
+    auto data() const -> const ModelData *;
+
+    /**
+     * Get the current layout.
+     *
+     * @return
+     *   The layout.
+     */
+    auto layout() const -> const InstanceLayout &;
+
+    /**
+     * Get the number of times the ranges have been repacked.
+     *
+     * @return
+     *   Number of repacks.
+     */
+    auto repacks() const -> std::uint32_t;
+
+  private:
+    /**
+     * Move every range to a new block, packed back to back by capacity.
+     */
+    auto repack() -> void;
+
+    /** Where each range starts and how many instances it has. */
+    InstanceLayout layout_;
+
+    /** Number of instances each range has room for. */
+    std::uint32_t capacities_[max_instance_ranges];
+
+    /** Block of instances. */
+    ModelData *instances_;
+
+    /** Number of repacks. */
+    std::uint32_t repacks_;
+};
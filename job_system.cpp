@@ -0,0 +1,383 @@
+#include "job_system.h"
+
+#include <cstdint>
+
+#include <Windows.h>
+#include <intrin.h>
+
+#include "clib.h"
+#include "cpu_profiler.h"
+#include "error.h"
+#include "log.h"
+
+namespace
+{
+
+/** Number of jobs each deque can hold, must be a power of two. */
+static constexpr auto g_deque_size = 1024u;
+
+/** Maximum number of threads that can register, workers included. */
+static constexpr auto g_max_threads = 16u;
+
+/** Threads other than workers that may register (main and simulation plus some spare). */
+static constexpr auto g_reserved_threads = 4u;
+
+/** Number of times an idle worker looks for work before going to sleep. */
+static constexpr auto g_spin_count = 64u;
+
+/**
+ * Chase-Lev deque of jobs. The owner pushes and pops at the bottom, thieves take from the top.
+ *
+ * Indices only ever increase and are compared by their difference, so wrapping around is fine.
+ */
+struct JobDeque
+{
+    /** Index of the oldest job, advanced by whoever takes it with a compare exchange. */
+    volatile long top;
+
+    /** Index one past the newest job, only written by the owner. */
+    volatile long bottom;
+
+    Job jobs[g_deque_size];
+};
+
+/** Thread local slot holding each thread's deque. */
+::DWORD g_tls_index = TLS_OUT_OF_INDEXES;
+
+/** Deques of every registered thread. */
+JobDeque *g_deques[g_max_threads];
+
+/** Number of registered threads. */
+volatile ::LONG g_thread_count;
+
+/** Number of worker threads. */
+std::uint32_t g_worker_count;
+
+/** Semaphore idle workers sleep on. */
+::HANDLE g_semaphore;
+
+/** Number of workers asleep, or about to be. */
+volatile ::LONG g_sleeping;
+
+/**
+ * Helper function to get the number of jobs between two deque indices.
+ *
+ * @param top
+ *   The top index.
+ * @param bottom
+ *   The bottom index.
+ *
+ * @return
+ *   Number of jobs, negative if the deque has been over popped.
+ */
+auto deque_size(long top, long bottom) -> std::int32_t
+{
+    return static_cast<std::int32_t>(static_cast<std::uint32_t>(bottom) - static_cast<std::uint32_t>(top));
+}
+
+/**
+ * Helper function to push a job on to the bottom of a deque, only called by the owner.
+ *
+ * @param deque
+ *   The deque.
+ * @param job
+ *   The job to push.
+ *
+ * @return
+ *   True if the job was pushed, false if the deque was full.
+ */
+auto push(JobDeque *deque, const Job &job) -> bool
+{
+    const auto bottom = deque->bottom;
+    if (deque_size(deque->top, bottom) >= static_cast<std::int32_t>(g_deque_size))
+    {
+        return false;
+    }
+
+    deque->jobs[static_cast<std::uint32_t>(bottom) & (g_deque_size - 1u)] = job;
+
+    // x86 doesn't reorder stores, so a thief that sees the new bottom sees the job
+    ::_WriteBarrier();
+    deque->bottom = bottom + 1;
+
+    return true;
+}
+
+/**
+ * Helper function to pop the newest job from the bottom of a deque, only called by the owner.
+ *
+ * @param deque
+ *   The deque.
+ * @param job
+ *   Out parameter for the job.
+ *
+ * @return
+ *   True if a job was popped, false if the deque was empty.
+ */
+auto pop(JobDeque *deque, Job *job) -> bool
+{
+    const auto bottom = deque->bottom - 1;
+
+    // claim the bottom job before looking at the top, this is the one place that needs a full fence as x86 can move a
+    // load ahead of an earlier store
+    ::InterlockedExchange(&deque->bottom, bottom);
+    const auto top = deque->top;
+
+    const auto size = deque_size(top, bottom);
+    if (size < 0)
+    {
+        deque->bottom = bottom + 1;
+        return false;
+    }
+
+    *job = deque->jobs[static_cast<std::uint32_t>(bottom) & (g_deque_size - 1u)];
+    if (size > 0)
+    {
+        return true;
+    }
+
+    // last job, so race any thieves for it
+    const auto won = ::InterlockedCompareExchange(&deque->top, top + 1, top) == top;
+    deque->bottom = bottom + 1;
+
+    return won;
+}
+
+/**
+ * Helper function to steal the oldest job from the top of a deque, called by any thread.
+ *
+ * @param deque
+ *   The deque.
+ * @param job
+ *   Out parameter for the job.
+ *
+ * @return
+ *   True if a job was stolen, false if the deque was empty or another thread got there first.
+ */
+auto steal(JobDeque *deque, Job *job) -> bool
+{
+    const auto top = deque->top;
+    ::_ReadBarrier();
+    const auto bottom = deque->bottom;
+
+    if (deque_size(top, bottom) <= 0)
+    {
+        return false;
+    }
+
+    // the copy may be torn if the owner wraps around onto it, but then the compare exchange fails and it's discarded
+    *job = deque->jobs[static_cast<std::uint32_t>(top) & (g_deque_size - 1u)];
+    ::_ReadWriteBarrier();
+
+    return ::InterlockedCompareExchange(&deque->top, top + 1, top) == top;
+}
+
+/**
+ * Helper function to find a job, first from the calling thread's deque and then by stealing from the others.
+ *
+ * @param self
+ *   Deque of the calling thread.
+ * @param job
+ *   Out parameter for the job.
+ *
+ * @return
+ *   True if a job was found, false otherwise.
+ */
+auto find_job(JobDeque *self, Job *job) -> bool
+{
+    if (pop(self, job))
+    {
+        return true;
+    }
+
+    // start from a different victim on each thread so thieves don't all pile on to the same deque
+    const auto thread_count = static_cast<std::uint32_t>(g_thread_count);
+    const auto start = static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(self) >> 12u);
+
+    for (auto i = 0u; i < thread_count; ++i)
+    {
+        auto *victim = g_deques[(start + i) % thread_count];
+        if ((victim != nullptr) && (victim != self) && steal(victim, job))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Helper function to run a job and mark it as finished.
+ *
+ * @param job
+ *   The job to run.
+ */
+auto run_job(const Job &job) -> void
+{
+    job.function(job.data, job.begin, job.end);
+
+    if (job.counter != nullptr)
+    {
+        ::InterlockedDecrement(&job.counter->pending);
+    }
+}
+
+/**
+ * Helper function to get the calling thread's deque.
+ *
+ * @return
+ *   The deque.
+ */
+auto current_deque() -> JobDeque *
+{
+    auto *deque = static_cast<JobDeque *>(::TlsGetValue(g_tls_index));
+    ensure(deque != nullptr, ErrorCode::JOB_SYSTEM_UNREGISTERED_THREAD);
+
+    return deque;
+}
+
+/**
+ * Entry point of a worker thread, runs jobs forever sleeping when there are none.
+ */
+auto worker_thread() -> void
+{
+    cpu_profiler_register_thread("worker");
+    job_system_register_thread();
+
+    auto *self = current_deque();
+    auto job = Job{};
+
+    for (;;)
+    {
+        auto found = false;
+        for (auto i = 0u; (i < g_spin_count) && !found; ++i)
+        {
+            found = find_job(self, &job);
+            if (!found)
+            {
+                ::YieldProcessor();
+            }
+        }
+
+        if (!found)
+        {
+            // announce we're going to sleep before the last look, so a submit either sees us or we see its job
+            ::InterlockedIncrement(&g_sleeping);
+            found = find_job(self, &job);
+
+            if (!found)
+            {
+                ::WaitForSingleObject(g_semaphore, INFINITE);
+            }
+
+            ::InterlockedDecrement(&g_sleeping);
+        }
+
+        if (found)
+        {
+            CPU_PROFILE_SCOPE("job");
+            run_job(job);
+        }
+    }
+}
+
+}
+
+auto job_system_init(std::uint32_t worker_count) -> void
+{
+    g_tls_index = ::TlsAlloc();
+
+    static constexpr auto max_workers = g_max_threads - g_reserved_threads;
+    g_worker_count = (worker_count < max_workers) ? worker_count : max_workers;
+    g_semaphore = ::CreateSemaphoreA(nullptr, 0, static_cast<::LONG>(g_worker_count) + 1, nullptr);
+
+    for (auto i = 0u; i < g_worker_count; ++i)
+    {
+        ::CreateThread(nullptr, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(worker_thread), nullptr, 0, nullptr);
+    }
+
+    log_format("job system started with %u workers", g_worker_count);
+}
+
+auto job_system_register_thread() -> void
+{
+    const auto index = static_cast<std::uint32_t>(::InterlockedIncrement(&g_thread_count) - 1);
+    ensure(index < g_max_threads, ErrorCode::JOB_SYSTEM_OVERFLOW);
+
+    auto *deque = static_cast<JobDeque *>(malloc(sizeof(JobDeque)));
+    deque->top = 0;
+    deque->bottom = 0;
+
+    g_deques[index] = deque;
+    ::TlsSetValue(g_tls_index, deque);
+}
+
+auto job_system_worker_count() -> std::uint32_t
+{
+    return g_worker_count;
+}
+
+auto job_system_submit(const Job &job) -> void
+{
+    if (job.counter != nullptr)
+    {
+        ::InterlockedIncrement(&job.counter->pending);
+    }
+
+    if (!push(current_deque(), job))
+    {
+        run_job(job);
+        return;
+    }
+
+    // the job has to be visible before checking for sleepers, otherwise a worker could miss it and sleep anyway
+    ::MemoryBarrier();
+    if (g_sleeping != 0)
+    {
+        ::ReleaseSemaphore(g_semaphore, 1, nullptr);
+    }
+}
+
+auto job_system_wait(JobCounter *counter) -> void
+{
+    auto *self = current_deque();
+    auto job = Job{};
+
+    while (counter->pending != 0)
+    {
+        if (find_job(self, &job))
+        {
+            run_job(job);
+        }
+        else
+        {
+            ::YieldProcessor();
+        }
+    }
+
+    // whatever the jobs wrote must be visible before the caller reads it
+    ::_ReadWriteBarrier();
+}
+
+auto job_system_parallel_for(std::uint32_t count, std::uint32_t grain, JobFunction function, void *data) -> void
+{
+    if ((count <= grain) || (g_worker_count == 0u))
+    {
+        if (count != 0u)
+        {
+            function(data, 0u, count);
+        }
+
+        return;
+    }
+
+    auto counter = JobCounter{};
+
+    for (auto begin = 0u; begin < count; begin += grain)
+    {
+        const auto end = ((count - begin) < grain) ? count : begin + grain;
+        job_system_submit({.function = function, .data = data, .begin = begin, .end = end, .counter = &counter});
+    }
+
+    job_system_wait(&counter);
+}
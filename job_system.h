@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Work stealing job system, a fixed pool of workers pulling jobs from per thread Chase-Lev deques.
+ *
+ * A thread pushes and pops jobs at the bottom of its own deque without any atomics, other threads steal from the top
+ * with a single compare exchange. So submitting and running jobs on one thread is cheap, and idle workers spread the
+ * load without a shared queue to fight over. Threads waiting on a counter run jobs rather than block, so a thread
+ * that fans work out also helps finish it.
+ *
+ * The only platform specific parts are thread creation, the thread local slot, the semaphore idle workers sleep on and
+ * the interlocked operations, each of which maps directly onto pthreads and C++ atomics.
+ */
+
+/**
+ * Function run by a job over the half open index range [begin, end).
+ */
+using JobFunction = void (*)(void *data, std::uint32_t begin, std::uint32_t end);
+
+/**
+ * Counter of unfinished jobs. Every job submitted with a counter increments it and decrements it once run, so waiting
+ * for zero waits for all of them, which is how one piece of work is made to depend on another.
+ */
+struct JobCounter
+{
+    volatile long pending;
+};
+
+/**
+ * A unit of work.
+ */
+struct Job
+{
+    JobFunction function;
+    void *data;
+    std::uint32_t begin;
+    std::uint32_t end;
+    JobCounter *counter;
+};
+
+/**
+ * Initialise the job system and start the workers, must be called once after the CPU profiler is initialised.
+ *
+ * @param worker_count
+ *   Number of worker threads to start, zero runs every job on the thread that waits for it.
+ */
+auto job_system_init(std::uint32_t worker_count) -> void;
+
+/**
+ * Register the calling thread, giving it a deque. A thread must be registered before it submits or waits for jobs.
+ */
+auto job_system_register_thread() -> void;
+
+/**
+ * Get the number of worker threads.
+ *
+ * @return
+ *   Number of workers.
+ */
+auto job_system_worker_count() -> std::uint32_t;
+
+/**
+ * Submit a job to the calling thread's deque, it may be run by any thread. If the deque is full the job is run
+ * immediately instead.
+ *
+ * @param job
+ *   The job to run.
+ */
+auto job_system_submit(const Job &job) -> void;
+
+/**
+ * Wait for a counter to reach zero, running jobs until it does.
+ *
+ * @param counter
+ *   The counter to wait for.
+ */
+auto job_system_wait(JobCounter *counter) -> void;
+
+/**
+ * Run a function over a range of indices split into jobs, returning once all of them are done.
+ *
+ * @param count
+ *   Number of indices, the function is called with ranges covering [0, count).
+ * @param grain
+ *   Most indices per job, ranges this small or smaller aren't worth the overhead so run on the calling thread.
+ * @param function
+ *   Function to run.
+ * @param data
+ *   Data passed to every call of the function.
+ */
+auto job_system_parallel_for(std::uint32_t count, std::uint32_t grain, JobFunction function, void *data) -> void;
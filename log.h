@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdarg>
+
 #include <Windows.h>
 
 #include "clib.h"
@@ -17,3 +19,24 @@ inline auto log(const char *msg) -> void
     const auto newline = "\n";
     write_res = ::WriteConsoleA(console, newline, 1, &written, nullptr);
 }
+
+/**
+ * Log a formatted message.
+ *
+ * Note that this goes through wvsprintf so there's no support for floats, callers have to split them into integer
+ * parts themselves.
+ *
+ * @param format
+ *   The wsprintf style format string.
+ */
+inline auto log_format(const char *format, ...) -> void
+{
+    char buffer[1024];
+
+    va_list args;
+    va_start(args, format);
+    ::wvsprintfA(buffer, format, args);
+    va_end(args);
+
+    log(buffer);
+}
@@ -1,59 +1,635 @@
+#include <cstddef>
 #include <cstdint>
 
 #include <Windows.h>
 
 #include "buffer.h"
 #include "camera.h"
-#include "dyn_array.h"
+#include "clib.h"
+#include "cpu_profiler.h"
+#include "dynamic_resolution.h"
+#include "entity_store.h"
 #include "event.h"
+#include "frame_clock.h"
+#include "frame_latency.h"
+#include "frame_pipeline.h"
 #include "func.h"
+#include "gpu_profiler.h"
+#include "gpu_projectiles.h"
+#include "input_log.h"
+#include "instance_allocator.h"
+#include "job_system.h"
 #include "log.h"
 #include "material.h"
+#include "material_permutations.h"
 #include "matrix4.h"
 #include "mesh.h"
+#include "mesh_optimiser.h"
+#include "noise.h"
 #include "opengl.h"
 #include "padding.h"
+#include "point_light.h"
+#include "program_cache.h"
+#include "projectiles.h"
 #include "quaternion.h"
+#include "render_queue.h"
 #include "scene.h"
 #include "shader.h"
 #include "shapes.h"
 #include "sound_player.h"
+#include "spatial_hash.h"
+#include "timer.h"
 #include "vector3.h"
 #include "vertex_data.h"
 #include "window.h"
 
+#if defined(TEKTITE_SPIRV)
+// generated by the spirv make target from the shader sources below
+#include "uber_frag_spv.h"
+#include "uber_vert_spv.h"
+#endif
+
 // https://stackoverflow.com/a/1583220
 EXTERN_C int _fltused = 0;
 
-// packed structs to mirror OpenGL alignment
+// the light buffer holds a count followed by this many lights, the shader light loop is limited to match
+static constexpr auto max_point_lights = 212u;
+
+// the player's gun is built from the first few cubes and cylinders in the scene
+static constexpr auto player_cube_count = 6u;
+static constexpr auto player_cylinder_count = 10u;
+
+// everything the render stage needs to draw a frame, written by the simulation stage, see frame_pipeline.h
+struct FrameSnapshot
+{
+    ModelData *models;
+    std::uint32_t model_capacity;
+    InstanceLayout layout;
+    float view[16];
+    float projection[16];
+    Vector3 camera_position;
+    std::uint32_t light_count;
+    PointLightBuffer lights[max_point_lights];
+    Vector3 spawn_positions[gpu_projectile_max_spawns];
+    Vector3 spawn_velocities[gpu_projectile_max_spawns];
+    std::uint32_t spawn_count;
+    std::uint32_t steps;
+    float alpha;
+    Vector3 target_positions[gpu_projectile_max_targets];
+    float target_radii[gpu_projectile_max_targets];
+    std::uint32_t target_count;
+    float time;
+    std::int64_t input_time;
+};
+
+// length of a simulation step, the speeds below are per step
+static constexpr auto simulation_step = 1.0f / 30.0f;
+static constexpr auto walk_speed = 0.4f;
+
+// most bullets handled by one job, a frame rarely has enough to split but a busy one can fan out, kept a multiple of
+// the eight simd lanes the projectiles are processed in
+static constexpr auto bullet_grain = 64u;
+
+// how close a bullet has to get to an enemy to hit it
+static constexpr auto enemy_hit_radius = 3.0f;
+
+// how far from the player a bullet can get before it's removed
+static constexpr auto bullet_cull_distance = 200.0f;
+
+// most bullets the gpu simulates at once, its buffers and instance range are a fixed reservation made up front, cpu
+// bullets start with room for this many and grow past it
+static constexpr auto max_bullets = 4096u;
+
+// target of a bullet that didn't hit anything
+static constexpr auto no_target = ~0u;
+
+// a run of instances of one mesh that all use the same shader permutation, the first instance is relative to the start
+// of its range in the instance allocator as ranges move when they grow
+struct DrawBatch
+{
+    const char *label;
+    const Mesh *mesh;
+    std::uint32_t features;
+    std::uint32_t range;
+    std::uint32_t first_instance;
+    std::uint32_t instance_count;
+};
+
+// smallest projected radius (in pixels) of an instance for each level of detail, anything smaller uses the last level
+static constexpr float lod_pixel_radii[max_mesh_lods - 1u] = {96.0f, 32.0f, 10.0f};
+
+/**
+ * Check the C++ structs that get copied into buffers match the layout the driver gave the shader blocks, the std140 and
+ * std430 rules are easy to get subtly wrong with vec3s.
+ *
+ * @param material
+ *   Linked uber shader permutation to check against.
+ */
+auto check_shader_layout(const Material &material) -> void
+{
+    material.check_layout(GL_UNIFORM, "view", 0u, 0u);
+    material.check_layout(GL_UNIFORM, "projection", sizeof(Matrix4), 0u);
+    material.check_layout(GL_UNIFORM, "eye", sizeof(Matrix4) * 2u, 0u);
+
+    material.check_layout(GL_BUFFER_VARIABLE, "num_points", 0u, 0u);
+    material.check_layout(
+        GL_BUFFER_VARIABLE, "points[0].point", 16u + offsetof(PointLightBuffer, position), sizeof(PointLightBuffer));
+    material.check_layout(
+        GL_BUFFER_VARIABLE,
+        "points[0].point_colour",
+        16u + offsetof(PointLightBuffer, colour),
+        sizeof(PointLightBuffer));
+    material.check_layout(
+        GL_BUFFER_VARIABLE,
+        "points[0].attenuation",
+        16u + offsetof(PointLightBuffer, attenuation),
+        sizeof(PointLightBuffer));
+
+    static constexpr struct
+    {
+        const char *name;
+        std::uint32_t offset;
+    } model_members[] = {
+        {"data[0].model", offsetof(ModelData, model)},
+        {"data[0].checker_colour1", offsetof(ModelData, checker_colour1)},
+        {"data[0].checker_colour2", offsetof(ModelData, checker_colour2)},
+        {"data[0].wood_colour1", offsetof(ModelData, wood_colour1)},
+        {"data[0].wood_colour2", offsetof(ModelData, wood_colour2)},
+        {"data[0].wood_colour3", offsetof(ModelData, wood_colour3)},
+        {"data[0].wood_scale", offsetof(ModelData, wood_scale)},
+        {"data[0].metal_colour", offsetof(ModelData, metal_colour)},
+        {"data[0].water_colour1", offsetof(ModelData, water_colour1)},
+        {"data[0].water_colour2", offsetof(ModelData, water_colour2)},
+        {"data[0].normal_scale", offsetof(ModelData, normal_scale)},
+    };
+
+    for (const auto &member : model_members)
+    {
+        material.check_layout(GL_BUFFER_VARIABLE, member.name, member.offset, sizeof(ModelData));
+    }
+}
+
+/**
+ * Pick the level of detail for an instance from its projected size.
+ *
+ * The size is worked out from the largest scale axis of the model matrix, all the comparisons are done squared so there
+ * are no square roots per instance.
+ *
+ * @param model
+ *   The instance.
+ * @param mesh
+ *   The mesh the instance draws.
+ * @param distance_squared
+ *   Squared distance from the camera to the instance.
+ * @param pixel_scale
+ *   Pixels per unit at a distance of one i.e. half the viewport height multiplied by the cotangent of half the fov.
+ *
+ * @return
+ *   Level of detail to draw the instance at.
+ */
+auto select_lod(const ModelData &model, const Mesh &mesh, float distance_squared, float pixel_scale) -> std::uint32_t
+{
+    const auto &m = model.model;
+
+    const auto scale_x = (m[0] * m[0]) + (m[1] * m[1]) + (m[2] * m[2]);
+    const auto scale_y = (m[4] * m[4]) + (m[5] * m[5]) + (m[6] * m[6]);
+    const auto scale_z = (m[8] * m[8]) + (m[9] * m[9]) + (m[10] * m[10]);
+    auto radius_squared = (scale_x > scale_y) ? scale_x : scale_y;
+    radius_squared = (radius_squared > scale_z) ? radius_squared : scale_z;
+
+    // projected radius is radius * pixel_scale / distance, compare without dividing either
+    const auto size_squared = radius_squared * pixel_scale * pixel_scale;
+
+    auto lod = 0u;
+    while (((lod + 1u) < mesh.lod_count()) &&
+           (size_squared < lod_pixel_radii[lod] * lod_pixel_radii[lod] * distance_squared))
+    {
+        ++lod;
+    }
+
+    return lod;
+}
+
+/**
+ * Get the squared distance from the camera to an instance.
+ *
+ * @param model
+ *   The instance.
+ * @param eye
+ *   Position of the camera.
+ *
+ * @return
+ *   Squared distance to the instance.
+ */
+auto distance_squared(const ModelData &model, const Vector3 &eye) -> float
+{
+    const auto dx = model.model[12] - eye.x;
+    const auto dy = model.model[13] - eye.y;
+    const auto dz = model.model[14] - eye.z;
+
+    return (dx * dx) + (dy * dy) + (dz * dz);
+}
+
+/**
+ * Submit batches to the render queue, as a packet per level of detail.
+ *
+ * Instances are regrouped through an index buffer, so the instances of a batch at each level end up contiguous and can
+ * be drawn with a single instanced call. Each instance is classified once and then bucketed by level, like a counting
+ * sort. Each packet is keyed on its program, mesh and level, with the depth of its nearest instance so the queue can
+ * draw front to back.
+ *
+ * @param batches
+ *   The batches to submit.
+ * @param batch_count
+ *   Number of batches.
+ * @param models
+ *   The model buffer the batches index.
+ * @param layout
+ *   Where each range starts in the model buffer.
+ * @param eye
+ *   Position of the camera.
+ * @param pixel_scale
+ *   Pixels per unit at a distance of one.
+ * @param materials
+ *   The permutations to draw the batches with.
+ * @param instance_lods
+ *   Scratch array with room for the level of every instance in the largest batch.
+ * @param instance_indices
+ *   Array to write the model buffer index of every instance to.
+ * @param instance_count
+ *   Number of instance indices in the array, updated.
+ * @param queue
+ *   The queue to submit to.
+ */
+auto submit_draw_batches(
+    const DrawBatch *batches,
+    std::uint32_t batch_count,
+    const ModelData *models,
+    const InstanceLayout &layout,
+    const Vector3 &eye,
+    float pixel_scale,
+    MaterialPermutations *materials,
+    std::uint8_t *instance_lods,
+    std::uint32_t *instance_indices,
+    std::uint32_t *instance_count,
+    RenderQueue *queue) -> void
+{
+    auto cursor = *instance_count;
+
+    for (auto i = 0u; i < batch_count; ++i)
+    {
+        const auto &batch = batches[i];
+        const auto &material = materials->get(batch.features);
+        const auto base_instance = layout.bases[batch.range] + batch.first_instance;
+
+        std::uint32_t lod_counts[max_mesh_lods];
+        float lod_nearest[max_mesh_lods];
+        for (auto lod = 0u; lod < max_mesh_lods; ++lod)
+        {
+            lod_counts[lod] = 0u;
+            lod_nearest[lod] = 1e9f;
+        }
+
+        // classify every instance once, remembering its level for the scatter below
+        for (auto j = 0u; j < batch.instance_count; ++j)
+        {
+            const auto &model = models[base_instance + j];
+            const auto distance = distance_squared(model, eye);
+            const auto lod = select_lod(model, *batch.mesh, distance, pixel_scale);
+
+            instance_lods[j] = static_cast<std::uint8_t>(lod);
+            ++lod_counts[lod];
+            lod_nearest[lod] = (distance < lod_nearest[lod]) ? distance : lod_nearest[lod];
+        }
+
+        // each level gets a contiguous run of the index array, in level order
+        std::uint32_t lod_cursors[max_mesh_lods];
+        for (auto lod = 0u; lod < max_mesh_lods; ++lod)
+        {
+            lod_cursors[lod] = cursor;
+            cursor += lod_counts[lod];
+        }
+
+        for (auto j = 0u; j < batch.instance_count; ++j)
+        {
+            instance_indices[lod_cursors[instance_lods[j]]++] = base_instance + j;
+        }
+
+        for (auto lod = 0u; lod < max_mesh_lods; ++lod)
+        {
+            if (lod_counts[lod] != 0u)
+            {
+                queue->submit(
+                    make_sort_key(
+                        RenderPass::SOLID,
+                        material.native_handle(),
+                        (batch.mesh->native_handle() * max_mesh_lods) + lod,
+                        static_cast<std::uint32_t>(to_int(lod_nearest[lod]))),
+                    {.material = &material,
+                     .mesh = batch.mesh,
+                     .lod = lod,
+                     .base_instance = lod_cursors[lod] - lod_counts[lod],
+                     .instance_count = lod_counts[lod],
+                     .label = batch.label});
+            }
+        }
+    }
+
+    *instance_count = cursor;
+}
+
+/**
+ * Classify a range of instances and add a batch for each run of consecutive instances that share a permutation.
+ *
+ * @param label
+ *   Name to profile the batches under.
+ * @param mesh
+ *   The mesh the instances draw.
+ * @param models
+ *   The instances.
+ * @param model_count
+ *   Number of instances.
+ * @param range
+ *   Range of the instances in the instance allocator.
+ * @param batches
+ *   Array of batches to add to.
+ * @param batch_count
+ *   Number of batches in the array, updated.
+ */
+auto add_draw_batches(
+    const char *label,
+    const Mesh *mesh,
+    const ModelData *models,
+    std::uint32_t model_count,
+    std::uint32_t range,
+    DrawBatch *batches,
+    std::uint32_t *batch_count) -> void
+{
+    auto start = 0u;
+    while (start < model_count)
+    {
+        const auto features = classify_material(models[start]);
+
+        auto end = start + 1u;
+        while ((end < model_count) && (classify_material(models[end]) == features))
+        {
+            ++end;
+        }
+
+        batches[(*batch_count)++] = {
+            .label = label,
+            .mesh = mesh,
+            .features = features,
+            .range = range,
+            .first_instance = start,
+            .instance_count = end - start};
+
+        start = end;
+    }
+}
+
+/**
+ * Create an entity for an instance from the scene.
+ *
+ * @param entities
+ *   Store to create the entity in.
+ * @param model
+ *   The instance, its transform and material are copied.
+ * @param mesh
+ *   Range of the mesh in the instance allocator.
+ * @param components
+ *   Any components beyond a transform, mesh and material, an attachment starts as the instance's transform.
+ *
+ * @return
+ *   The new entity.
+ */
+auto create_scene_entity(EntityStore *entities, const ModelData &model, std::uint32_t mesh, std::uint32_t components)
+    -> std::uint32_t
+{
+    const auto entity = entities->create(COMPONENT_TRANSFORM | COMPONENT_MESH | COMPONENT_MATERIAL | components);
+
+    entities->transform(entity) = model.model;
+    entities->mesh(entity) = mesh;
+    entities->material(entity) = {
+        .checker_colour1 = model.checker_colour1,
+        .checker_colour2 = model.checker_colour2,
+        .wood_colour1 = model.wood_colour1,
+        .wood_colour2 = model.wood_colour2,
+        .wood_colour3 = model.wood_colour3,
+        .wood_scale = model.wood_scale,
+        .metal_colour = model.metal_colour,
+        .water_colour1 = model.water_colour1,
+        .water_colour2 = model.water_colour2,
+        .normal_scale = model.normal_scale};
+
+    if ((components & COMPONENT_ATTACHMENT) != 0u)
+    {
+        entities->attachment(entity) = model.model;
+    }
+
+    return entity;
+}
+
+/**
+ * Read a whole number from an environment variable.
+ *
+ * @param name
+ *   Name of the variable.
+ * @param fallback
+ *   Value to use if the variable isn't set.
+ *
+ * @return
+ *   The value of the variable, ignoring anything after the leading digits.
+ */
+auto read_environment_uint(const char *name, std::uint32_t fallback) -> std::uint32_t
+{
+    char value[16];
+    const auto length = ::GetEnvironmentVariableA(name, value, sizeof(value));
+    if ((length == 0u) || (length >= sizeof(value)))
+    {
+        return fallback;
+    }
+
+    auto result = 0u;
+    for (const auto *cursor = value; (*cursor >= '0') && (*cursor <= '9'); ++cursor)
+    {
+        result = (result * 10u) + static_cast<std::uint32_t>(*cursor - '0');
+    }
+
+    return result;
+}
+
+/**
+ * Get the current time in the same units events are stamped with.
+ *
+ * @return
+ *   Current QueryPerformanceCounter value.
+ */
+auto performance_counter() -> std::int64_t
+{
+    auto counter = ::LARGE_INTEGER{};
+    ::QueryPerformanceCounter(&counter);
+
+    return counter.QuadPart;
+}
+
+/**
+ * Convert a time to QueryPerformanceCounter ticks.
+ *
+ * @param seconds
+ *   Time in seconds, short enough that the ticks fit in an int.
+ *
+ * @return
+ *   Number of ticks.
+ */
+auto to_performance_ticks(float seconds) -> std::int64_t
+{
+    auto frequency = ::LARGE_INTEGER{};
+    ::QueryPerformanceFrequency(&frequency);
+
+    // go via float to avoid needing the CRT 64-bit multiplication helpers
+    return to_int(static_cast<float>(frequency.QuadPart) * seconds);
+}
 
-#pragma warning(push)
-#pragma warning(disable : 4324)
-struct PointLightBuffer
+// the levels of detail of the round shapes, generated a level per job
+struct LodMeshJob
 {
-    alignas(16) Vector3 position;
-    alignas(16) Vector3 colour;
-    alignas(16) Vector3 attenuation;
+    const std::uint32_t *sector_counts;
+    VertexData **sphere_vertices;
+    std::uint32_t *sphere_vertex_counts;
+    std::uint32_t **sphere_indices;
+    std::uint32_t *sphere_index_counts;
+    VertexData **cylinder_vertices;
+    std::uint32_t *cylinder_vertex_counts;
+    std::uint32_t **cylinder_indices;
+    std::uint32_t *cylinder_index_counts;
 };
-#pragma warning(pop)
 
-// an entity is just a collection of offsets into the main object buffer for each shape
-struct Entity
+/**
+ * Job function to generate the sphere and cylinder of some levels of detail.
+ *
+ * @param data
+ *   The LodMeshJob.
+ * @param begin
+ *   First level to generate.
+ * @param end
+ *   One past the last level to generate.
+ */
+auto generate_lod_meshes(void *data, std::uint32_t begin, std::uint32_t end) -> void
+{
+    const auto &job = *static_cast<const LodMeshJob *>(data);
+
+    for (auto i = begin; i < end; ++i)
+    {
+        generate_sphere(
+            job.sector_counts[i],
+            job.sector_counts[i],
+            &job.sphere_vertices[i],
+            &job.sphere_vertex_counts[i],
+            &job.sphere_indices[i],
+            &job.sphere_index_counts[i]);
+        generate_cylinder(
+            job.sector_counts[i],
+            &job.cylinder_vertices[i],
+            &job.cylinder_vertex_counts[i],
+            &job.cylinder_indices[i],
+            &job.cylinder_index_counts[i]);
+
+        log_format(
+            "lod %u: sphere %u triangles, cylinder %u triangles",
+            i,
+            job.sphere_index_counts[i] / 3u,
+            job.cylinder_index_counts[i] / 3u);
+
+        // the generators emit simple row by row orders (and the cylinder duplicates its cap rings), so tidy them up
+        char name[32];
+        ::wsprintfA(name, "sphere lod %u", i);
+        optimise_mesh(
+            name,
+            job.sphere_vertices[i],
+            &job.sphere_vertex_counts[i],
+            job.sphere_indices[i],
+            job.sphere_index_counts[i]);
+        ::wsprintfA(name, "cylinder lod %u", i);
+        optimise_mesh(
+            name,
+            job.cylinder_vertices[i],
+            &job.cylinder_vertex_counts[i],
+            job.cylinder_indices[i],
+            job.cylinder_index_counts[i]);
+    }
+}
+
+// bullets to test against the targets, each job only writes the hits of its own bullets
+struct HitTestJob
 {
-    std::uint32_t sphere_start;
-    std::uint32_t sphere_end;
-    std::uint32_t cylinder_start;
-    std::uint32_t cylinder_end;
-    std::uint32_t cube_start;
-    std::uint32_t cube_end;
+    const Projectiles *projectiles;
+    const SpatialHash *target_hash;
+    const Vector3 *target_positions;
+    const float *target_radii;
+    std::uint32_t *bullet_targets;
 };
 
-struct Bullet
+/**
+ * Job function to find the target each of some bullets hits.
+ *
+ * @param data
+ *   The HitTestJob.
+ * @param begin
+ *   First bullet to test.
+ * @param end
+ *   One past the last bullet to test.
+ */
+auto hit_test_bullets(void *data, std::uint32_t begin, std::uint32_t end) -> void
+{
+    const auto &job = *static_cast<const HitTestJob *>(data);
+
+    for (auto i = begin; i < end; ++i)
+    {
+        // the grid only says the bounds overlap, so still check the actual distance
+        const auto position = job.projectiles->position(i);
+        CollisionPair pairs[gpu_projectile_max_targets];
+        const auto pair_count = job.target_hash->query(position, 0.0f, i, pairs, gpu_projectile_max_targets);
+
+        job.bullet_targets[i] = no_target;
+        for (auto j = 0u; j < pair_count; ++j)
+        {
+            const auto target = pairs[j].target;
+            if (Vector3::distance(position, job.target_positions[target]) < job.target_radii[target])
+            {
+                job.bullet_targets[i] = target;
+                break;
+            }
+        }
+    }
+}
+
+// bullets to write the instances and lights of, interpolated like everything else
+struct BulletEmitJob
 {
-    Vector3 position;
-    Vector3 velocity;
+    const Projectiles *projectiles;
+    float alpha;
+    ModelData *models;
+    PointLightBuffer *lights;
+    std::uint32_t light_count;
 };
 
+/**
+ * Job function to write the instances and lights of some bullets.
+ *
+ * @param data
+ *   The BulletEmitJob.
+ * @param begin
+ *   First bullet to write, a multiple of eight.
+ * @param end
+ *   One past the last bullet to write.
+ */
+auto emit_bullets(void *data, std::uint32_t begin, std::uint32_t end) -> void
+{
+    const auto &job = *static_cast<const BulletEmitJob *>(data);
+    job.projectiles->emit(job.alpha, begin, end, job.models, job.lights, job.light_count);
+}
+
 // uber shader code
 
 const auto *vertex_shader_src = R"(
@@ -86,33 +662,60 @@ const auto *vertex_shader_src = R"(
         ModelData data[];
     };
 
+    // instances are drawn via this so each level of detail can draw its instances as one contiguous range
+    layout(std430, binding = 3) readonly buffer instance_indices
+    {
+        uint instance_index[];
+    };
+
+    // packed meshes give the normal and tangent as two octahedral components, the same inputs are used either way (z is
+    // just zero when packed) so only this constant changes
+    #ifdef GL_SPIRV
+    layout (constant_id = 6) const bool packed_vertices = true;
+    #else
+    const bool packed_vertices = PACKED_VERTICES != 0;
+    #endif
+
     layout (location = 0) in vec3 aPos;
     layout (location = 1) in vec3 aNormal;
     layout (location = 2) in vec3 aTangent;
     layout (location = 3) in vec2 aUv;
 
-    out vec3 vNormal;
-    out vec2 vUv;
-    out vec4 vPos;
-    out mat3 tbn;
-    out flat int instance_id;
+    // explicit locations everywhere so the same source can be compiled to SPIR-V
+    layout (location = 0) out vec3 vNormal;
+    layout (location = 1) out vec2 vUv;
+    layout (location = 2) out vec4 vPos;
+    layout (location = 3) out mat3 tbn;
+    layout (location = 6) out flat int instance_id;
+
+    vec3 octahedral_decode(vec2 e)
+    {
+        vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+        float t = max(-v.z, 0.0);
+        v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+        return normalize(v);
+    }
 
     void main()
     {
-        mat4 model = data[gl_InstanceID + gl_BaseInstance].model;
+        int id = int(instance_index[gl_InstanceID + gl_BaseInstance]);
+        mat4 model = data[id].model;
+
+        vec3 normal = packed_vertices ? octahedral_decode(aNormal.xy) : aNormal;
+        vec3 tangent = packed_vertices ? octahedral_decode(aTangent.xy) : aTangent;
 
         gl_Position = projection * view * model * vec4(aPos, 1.0);
-        vNormal = normalize(mat3(transpose(inverse(model))) * aNormal);
+        vNormal = normalize(mat3(transpose(inverse(model))) * normal);
         vUv = aUv;
 
-        vec3 t = normalize(vec3(model * vec4(aTangent, 0.0)));
-        vec3 n = normalize(vec3(model * vec4(aNormal, 0.0)));
+        vec3 t = normalize(vec3(model * vec4(tangent, 0.0)));
+        vec3 n = normalize(vec3(model * vec4(normal, 0.0)));
         vec3 b = cross(n, t);
         tbn = mat3(t, b, n);
 
         vPos = model * vec4(aPos, 1.0);
     
-        instance_id = gl_InstanceID + gl_BaseInstance;
+        instance_id = id;
     }
 )";
 
@@ -159,15 +762,33 @@ const auto *fragment_shader_src = R"(
         ModelData data[];
     };
 
-    in vec3 vNormal;
-    in vec2 vUv;
-    in vec4 vPos;
-    in mat3 tbn;
-    in flat int instance_id;
-
-    out vec4 FragColor;
-
-    uniform float time;
+    layout (location = 0) in vec3 vNormal;
+    layout (location = 1) in vec2 vUv;
+    layout (location = 2) in vec4 vPos;
+    layout (location = 3) in mat3 tbn;
+    layout (location = 6) in flat int instance_id;
+
+    layout (location = 0) out vec4 FragColor;
+
+    layout (location = 0) uniform float time;
+
+    // when precompiled to SPIR-V the features are specialisation constants, otherwise they come from the injected
+    // FEATURE_* defines, either way they are constant so the unused patterns get compiled out
+    #ifdef GL_SPIRV
+    layout (constant_id = 0) const bool feature_checker = true;
+    layout (constant_id = 1) const bool feature_wood = false;
+    layout (constant_id = 2) const bool feature_metal = false;
+    layout (constant_id = 3) const bool feature_water = true;
+    layout (constant_id = 4) const bool feature_bump = true;
+    layout (constant_id = 5) const int max_point_lights = 212;
+    #else
+    const bool feature_checker = FEATURE_CHECKER != 0;
+    const bool feature_wood = FEATURE_WOOD != 0;
+    const bool feature_metal = FEATURE_METAL != 0;
+    const bool feature_water = FEATURE_WATER != 0;
+    const bool feature_bump = FEATURE_BUMP != 0;
+    const int max_point_lights = MAX_POINT_LIGHTS;
+    #endif
 
     float random(vec2 st)   
     {
@@ -305,14 +926,37 @@ const auto *fragment_shader_src = R"(
     
     void main()
     {
-        vec3 albedo = checker_pattern(data[instance_id].checker_colour1, data[instance_id].checker_colour2);
-        albedo += water_pattern(data[instance_id].water_colour1, data[instance_id].water_colour2);
+        vec3 albedo = vec3(0.0);
+
+        if (feature_checker)
+        {
+            albedo += checker_pattern(data[instance_id].checker_colour1, data[instance_id].checker_colour2);
+        }
+        if (feature_wood)
+        {
+            albedo += wood_pattern(data[instance_id].wood_colour1, data[instance_id].wood_colour2, data[instance_id].wood_colour3);
+        }
+        if (feature_metal)
+        {
+            albedo += metal_pattern(data[instance_id].metal_colour);
+        }
+        if (feature_water)
+        {
+            albedo += water_pattern(data[instance_id].water_colour1, data[instance_id].water_colour2);
+        }
+
+        vec3 normal = vNormal;
+        if (feature_bump)
+        {
+            normal += metal_bump_normal_pattern(data[instance_id].normal_scale);
+        }
         
         vec3 colour = vec3(0.3);
 
-        for (int i = 0; i < num_points; ++i)
+        int light_count = min(num_points, max_point_lights);
+        for (int i = 0; i < light_count; ++i)
         {
-            colour += calc_point(i, vNormal + metal_bump_normal_pattern(data[instance_id].normal_scale));
+            colour += calc_point(i, normal);
         }
 
         FragColor = vec4(colour * albedo, 1.0);
@@ -562,10 +1206,14 @@ auto loop_audio() -> void
     RAW_PADDING_LINE_QUARTER
     PADDING_END
 
+    cpu_profiler_register_thread("audio");
+
     auto sound_player = SoundPlayer{};
 
     for (;;)
     {
+        CPU_PROFILE_SCOPE("play notes");
+
         // not annoying at all
         Note notes[] = {
             {293.66, 0.1}, // D4
@@ -589,12 +1237,44 @@ SECTION("main") auto main() -> int
 
     log("starting");
 
-    auto window = Window{width, height};
+    const auto startup_timer = Timer{};
+
+    cpu_profiler_init();
+    cpu_profiler_register_thread("main");
+
+    // a worker per core the main thread isn't using, unless TEKTITE_JOB_WORKERS says otherwise
+    auto system_info = ::SYSTEM_INFO{};
+    ::GetSystemInfo(&system_info);
+    job_system_init(read_environment_uint("TEKTITE_JOB_WORKERS", system_info.dwNumberOfProcessors - 1u));
+    job_system_register_thread();
+
+#if defined(TEKTITE_BENCHMARK)
+    benchmark_noise();
+    benchmark_spatial_hash();
+    ::ExitProcess(0);
+#endif
 
-    auto vertex_shader = Shader{vertex_shader_src, ShaderType::VERTEX};
-    auto fragment_shader = Shader{fragment_shader_src, ShaderType::FRAGMENT};
+    auto window = Window{width, height};
 
-    auto material = Material{vertex_shader, fragment_shader};
+    auto program_cache = ProgramCache{};
+
+    // meshes are packed unless TEKTITE_NO_PACKED_VERTICES is set, which is handy for comparing the two
+    const auto packed_vertices = ::GetEnvironmentVariableA("TEKTITE_NO_PACKED_VERTICES", nullptr, 0) == 0;
+    const auto vertex_format = packed_vertices ? VertexFormat::PACKED : VertexFormat::FULL;
+    log_format("using %s vertices", packed_vertices ? "packed" : "full");
+
+#if defined(TEKTITE_SPIRV)
+    auto materials = MaterialPermutations{
+        g_uber_vertex_spirv,
+        sizeof(g_uber_vertex_spirv),
+        g_uber_fragment_spirv,
+        sizeof(g_uber_fragment_spirv),
+        max_point_lights,
+        packed_vertices};
+#else
+    auto materials = MaterialPermutations{
+        vertex_shader_src, fragment_shader_src, max_point_lights, packed_vertices, &program_cache};
+#endif
 
     // create a single instance of the three unit primitives
 
@@ -602,73 +1282,280 @@ SECTION("main") auto main() -> int
         g_cube_vertices,
         sizeof(g_cube_vertices) / sizeof(VertexData),
         g_cube_indices,
-        sizeof(g_cube_indices) / sizeof(std::uint32_t)};
-
-    VertexData *sphere_vertices{};
-    auto sphere_vertex_count = std::uint32_t{};
-    std::uint32_t *sphere_indices{};
-    auto sphere_index_count = std::uint32_t{};
-    generate_sphere(10, 10, &sphere_vertices, &sphere_vertex_count, &sphere_indices, &sphere_index_count);
-
-    const auto sphere_mesh = Mesh{sphere_vertices, sphere_vertex_count, sphere_indices, sphere_index_count};
-
-    VertexData *cylinder_vertices{};
-    auto cylinder_vertex_count = std::uint32_t{};
-    std::uint32_t *cylinder_indices{};
-    auto cylinder_index_count = std::uint32_t{};
-    generate_cylinder(10, &cylinder_vertices, &cylinder_vertex_count, &cylinder_indices, &cylinder_index_count);
-
-    auto cylinder_mesh = Mesh{cylinder_vertices, cylinder_vertex_count, cylinder_indices, cylinder_index_count};
+        sizeof(g_cube_indices) / sizeof(std::uint32_t),
+        vertex_format};
+
+    // the round shapes get a chain of tessellations, from close up down to a few pixels across
+    static constexpr std::uint32_t lod_sector_counts[max_mesh_lods] = {24u, 16u, 10u, 6u};
+
+    VertexData *sphere_vertices[max_mesh_lods]{};
+    std::uint32_t sphere_vertex_counts[max_mesh_lods]{};
+    std::uint32_t *sphere_indices[max_mesh_lods]{};
+    std::uint32_t sphere_index_counts[max_mesh_lods]{};
+
+    VertexData *cylinder_vertices[max_mesh_lods]{};
+    std::uint32_t cylinder_vertex_counts[max_mesh_lods]{};
+    std::uint32_t *cylinder_indices[max_mesh_lods]{};
+    std::uint32_t cylinder_index_counts[max_mesh_lods]{};
+
+    // every level is independent, so they're generated in parallel (which means the log lines come out in any order)
+    auto lod_mesh_job = LodMeshJob{
+        .sector_counts = lod_sector_counts,
+        .sphere_vertices = sphere_vertices,
+        .sphere_vertex_counts = sphere_vertex_counts,
+        .sphere_indices = sphere_indices,
+        .sphere_index_counts = sphere_index_counts,
+        .cylinder_vertices = cylinder_vertices,
+        .cylinder_vertex_counts = cylinder_vertex_counts,
+        .cylinder_indices = cylinder_indices,
+        .cylinder_index_counts = cylinder_index_counts};
+    job_system_parallel_for(max_mesh_lods, 1u, generate_lod_meshes, &lod_mesh_job);
+
+    const auto sphere_mesh =
+        Mesh{sphere_vertices, sphere_vertex_counts, sphere_indices, sphere_index_counts, max_mesh_lods, vertex_format};
+    auto cylinder_mesh = Mesh{
+        cylinder_vertices,
+        cylinder_vertex_counts,
+        cylinder_indices,
+        cylinder_index_counts,
+        max_mesh_lods,
+        vertex_format};
 
     // simple camera setup
     auto camera =
         Camera{{-2.0f, 1.0f, 5.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, M_PI / 4.0f, width, height, 0.1f, 1000.0f};
     const auto camera_buffer = Buffer{sizeof(Matrix4) * 2 + sizeof(Vector3)};
 
-    // use one large buffer for all the mesh instances, split into thirds (on for each shape)
-    // don't overflow this!
-    auto model_data_buffer = Buffer{sizeof(ModelData) * max_models_per_type * 3u};
-    model_data_buffer.write(
-        reinterpret_cast<const std::uint8_t *>(cube_models), sizeof(ModelData) * cube_model_count, 0);
-    model_data_buffer.write(
-        reinterpret_cast<const std::uint8_t *>(sphere_models),
-        sizeof(ModelData) * sphere_model_count,
-        sizeof(ModelData) * max_models_per_type);
-    model_data_buffer.write(
-        reinterpret_cast<const std::uint8_t *>(cylinder_models),
-        sizeof(ModelData) * cylinder_model_count,
-        sizeof(ModelData) * max_models_per_type * 2u);
+    // TEKTITE_GPU_PROJECTILES simulates the bullets in a compute shader, they're drawn at the lowest level of detail
+    // straight from what it writes, hits come back a few frames late and depend on how fast the gpu is so replays only
+    // play the same without it
+    const auto gpu_projectiles_enabled = ::GetEnvironmentVariableA("TEKTITE_GPU_PROJECTILES", nullptr, 0) != 0;
+    log_format("bullets simulated on the %s", gpu_projectiles_enabled ? "gpu" : "cpu");
+
+    // every instance has a place in one allocator, a range per kind of thing so each can be drawn as one run, ranges
+    // grow as needed so there's no fixed limit on any of them
+    auto instances = InstanceAllocator{};
+    const auto cube_range = instances.add_range(cube_model_count);
+    const auto sphere_range = instances.add_range(sphere_model_count);
+    const auto cylinder_range = instances.add_range(cylinder_model_count);
+    const auto bullet_range = instances.add_range(0u);
+
+    // the gpu bullets write their own instances, so their range is only ever reserved and kept last so nothing the
+    // cpu uploads comes after it
+    const auto gpu_bullet_range = instances.add_range(gpu_projectiles_enabled ? max_bullets : 0u);
+
+    // everything in the scene is an entity, the simulation only ever works on these and the render stage only ever sees
+    // the instances and lights written from them into snapshots, the gun follows the player and the first sphere is
+    // the one enemy
+    auto entities = EntityStore{};
+    for (auto i = 0u; i < cube_model_count; ++i)
+    {
+        create_scene_entity(&entities, cube_models[i], cube_range, (i < player_cube_count) ? COMPONENT_ATTACHMENT : 0u);
+    }
+    for (auto i = 0u; i < sphere_model_count; ++i)
+    {
+        const auto entity =
+            create_scene_entity(&entities, sphere_models[i], sphere_range, (i == 0u) ? COMPONENT_TARGET : 0u);
+        if (i == 0u)
+        {
+            entities.target_radius(entity) = enemy_hit_radius;
+        }
+    }
+    for (auto i = 0u; i < cylinder_model_count; ++i)
+    {
+        create_scene_entity(
+            &entities, cylinder_models[i], cylinder_range, (i < player_cylinder_count) ? COMPONENT_ATTACHMENT : 0u);
+    }
+
+    // nothing drawn is created or destroyed after this, so the instances come out in this order every frame
+    instances.resize(cube_range, entities.instance_count(cube_range));
+    instances.resize(sphere_range, entities.instance_count(sphere_range));
+    instances.resize(cylinder_range, entities.instance_count(cylinder_range));
+    entities.write_instances(instances.layout(), instances.data());
+
+    // one large buffer for all the instances and the index of every instance in it, rebuilt each frame in level of
+    // detail order, both are rewritten every frame so are just reallocated bigger when the instances outgrow them
+    auto model_data_buffer = Buffer{sizeof(ModelData) * instances.layout().total};
+    auto instance_index_buffer = Buffer{sizeof(std::uint32_t) * instances.layout().total};
+    auto instance_capacity = instances.layout().total;
+    auto *instance_indices = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * instance_capacity));
+    auto *instance_lods = static_cast<std::uint8_t *>(malloc(instance_capacity));
+
+    // classify every instance up front and group the draws by permutation, bullets are only ever a checker
+    static constexpr auto bullet_features = std::uint32_t{MATERIAL_FEATURE_CHECKER};
+
+    // at worst every instance is its own batch
+    const auto &static_layout = instances.layout();
+    const auto static_instance_count =
+        static_layout.counts[cube_range] + static_layout.counts[sphere_range] + static_layout.counts[cylinder_range];
+    auto *static_batches = static_cast<DrawBatch *>(malloc(sizeof(DrawBatch) * static_instance_count));
+    auto static_batch_count = 0u;
+    add_draw_batches(
+        "cubes",
+        &cube_mesh,
+        instances.instances(cube_range),
+        static_layout.counts[cube_range],
+        cube_range,
+        static_batches,
+        &static_batch_count);
+    add_draw_batches(
+        "spheres",
+        &sphere_mesh,
+        instances.instances(sphere_range),
+        static_layout.counts[sphere_range],
+        sphere_range,
+        static_batches,
+        &static_batch_count);
+    add_draw_batches(
+        "cylinders",
+        &cylinder_mesh,
+        instances.instances(cylinder_range),
+        static_layout.counts[cylinder_range],
+        cylinder_range,
+        static_batches,
+        &static_batch_count);
+
+    // compile everything we need now rather than hitching on the first frame, checking the layout of each permutation
+    // as the linker is free to drop members one of them doesn't use, the uniform slots are looked up once here so the
+    // per frame sets are just an index
+    bool permutation_used[material_permutation_count]{};
+    for (auto i = 0u; i < static_batch_count; ++i)
+    {
+        permutation_used[static_batches[i].features] = true;
+    }
+    permutation_used[bullet_features] = true;
+
+    UniformSlot time_slots[material_permutation_count];
+    for (auto i = 0u; i < material_permutation_count; ++i)
+    {
+        if (permutation_used[i])
+        {
+            const auto &material = materials.get(i);
+            check_shader_layout(material);
+            time_slots[i] = material.uniform_slot("time");
+        }
+    }
+
+    log_format("%u draw batches using %u permutations", static_batch_count, materials.compiled_count());
+
+    // report how long startup took, run with TEKTITE_NO_PROGRAM_CACHE set to compare against a cold start
+    const auto startup_ms = to_int(startup_timer.elapsed_seconds() * 1000.0f);
+    log_format(
+        "startup took %d ms (program cache %s, %u hits, %u misses)",
+        startup_ms,
+        program_cache.enabled() ? "enabled" : "disabled",
+        program_cache.hits(),
+        program_cache.misses());
 
     auto move_forward = false;
     auto move_backward = false;
     auto move_left = false;
     auto move_right = false;
 
-    auto light_buffer = Buffer{10240u};
-    auto player_light = PointLightBuffer{{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 0.09f, 0.032f}};
+    auto light_buffer = Buffer{16u + sizeof(PointLightBuffer) * max_point_lights};
+
+    // the player carries a light, attached where the camera starts so it follows the camera exactly
+    const auto player_light = entities.create(COMPONENT_TRANSFORM | COMPONENT_ATTACHMENT | COMPONENT_LIGHT);
+    entities.attachment(player_light) = Matrix4{camera.position()};
+    entities.light(player_light) = {.colour = {1.0f, 1.0f, 1.0f}, .attenuation = {1.0f, 0.09f, 0.032f}};
 
-    auto bullets = DynArray{sizeof(Bullet)};
+    // the target each bullet hit this step, if any, grown along with the projectiles
+    auto projectiles = Projectiles{max_bullets};
+    auto bullet_target_capacity = projectiles.capacity();
+    auto *bullet_targets = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * bullet_target_capacity));
+
+    auto gpu_projectiles = GpuProjectiles{max_bullets, sphere_mesh, sphere_mesh.lod_count() - 1u};
+    volatile long gpu_projectile_hits[gpu_projectile_max_targets]{};
 
     auto material_params_buffer = Buffer{1024u};
 
     auto time = 0.0f;
+    auto accumulator = 0.0f;
+
+    // the simulation moves the player, the camera is put somewhere between the last two positions to render
+    const auto start_position = camera.position();
+    auto player_position = start_position;
+    auto previous_player_position = start_position;
+    auto gun_yaw = 0.0f;
+
+    // bullets find what they might hit through a grid rather than testing every target, so the cost stays flat as more
+    // targets are added
+    auto target_hash = SpatialHash{8.0f, 16u, 16u * 64u};
+
+    // every draw goes through the queue, a packet per batch per level of detail
+    auto render_queue = RenderQueue{(static_batch_count + 2u) * max_mesh_lods};
+    auto frame_count = 0u;
+
+    // scene is drawn offscreen at whatever resolution keeps the gpu at 60fps, then stretched to the window, headless
+    // runs are for comparing images so always render at full resolution
+    auto dynamic_resolution =
+        DynamicResolution{width, height, window.framebuffer(), window.headless() ? 0.0f : 1.0f / 60.0f};
+
+    auto gpu_profiler = GpuProfiler{};
+
+    // input comes through the log so runs can be recorded and replayed, see input_log.h
+    auto input_log = InputLog{};
+
+    // vsync is on unless TEKTITE_SWAP_INTERVAL says otherwise (0 to run uncapped for profiling), TEKTITE_FRAME_LIMIT
+    // caps the frame rate without vsync, neither changes how the game plays
+    window.set_swap_interval(static_cast<int>(read_environment_uint("TEKTITE_SWAP_INTERVAL", 1u)));
+    const auto frame_limit = read_environment_uint("TEKTITE_FRAME_LIMIT", 0u);
+    auto frame_clock =
+        FrameClock{(frame_limit != 0u) ? 1.0f / static_cast<float>(static_cast<std::int32_t>(frame_limit)) : 0.0f};
+
+    // TEKTITE_MAX_FRAMES_IN_FLIGHT turns on low latency mode, the cpu waits rather than run ahead of the gpu by more
+    // than that many frames
+    auto frame_latency = FrameLatency{read_environment_uint("TEKTITE_MAX_FRAMES_IN_FLIGHT", 0u)};
+
+    // the simulation runs a frame ahead of rendering on its own thread, unless TEKTITE_NO_PIPELINE is set or in low
+    // latency mode where that extra frame is exactly what we're trying to get rid of, input is still only pumped once a
+    // frame as events taken any later would be recorded against the next frame and replay differently
+    auto pipeline = FramePipeline{sizeof(FrameSnapshot)};
+    const auto pipelined =
+        !frame_latency.enabled() && (::GetEnvironmentVariableA("TEKTITE_NO_PIPELINE", nullptr, 0) == 0);
+    log_format("simulation %s", pipelined ? "pipelined on its own thread" : "runs before rendering");
+
+    // run audio in separate thread, unless headless where there may not be an audio device
+    if (!window.headless())
+    {
+        ::CreateThread(nullptr, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(loop_audio), nullptr, 0, nullptr);
+    }
 
-    auto player = Entity{0u, 0u, 0u, 10u, 0u, 6u};
+    // simulation stage, steps the game and writes everything the render stage needs into the next snapshot
+    const auto simulate_frame = [&]()
+    {
+        auto frame_timer = Timer{};
+        auto *snapshot = static_cast<FrameSnapshot *>(pipeline.begin_produce());
 
-    // run audio in separate thread
-    ::CreateThread(nullptr, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(loop_audio), nullptr, 0, nullptr);
+        // don't count waiting for the render stage
+        frame_timer.reset();
 
-    while (window.running())
-    {
-        Event evt{};
-        auto has_event = window.pump_message(&evt);
+        cpu_profiler_begin_scope("simulation");
+        cpu_profiler_begin_scope("input");
 
         auto delta_x = 0.0f;
         auto delta_y = 0.0f;
+        auto input_time = std::int64_t{};
+        snapshot->spawn_count = 0u;
+
+        // replays step with the recorded frame times so they play out exactly as recorded, headless runs step once a
+        // frame so dumped frames don't depend on how fast the machine is
+        const auto measured_delta = window.headless() ? simulation_step : frame_clock.tick();
+        const auto now = performance_counter();
+
+        // input arrives on its own thread, take everything up to the time this frame's simulation advances to, which
+        // is now less whatever won't make up a whole step, so an event always lands in the step it happened during
+        auto remainder = accumulator + measured_delta;
+        while (remainder >= simulation_step)
+        {
+            remainder -= simulation_step;
+        }
+
+        const auto input_cut_off = now - to_performance_ticks(remainder);
 
-        while (has_event)
+        auto evt = Event{};
+        while (input_log.pump_message(&window, &evt, input_cut_off))
         {
-            // handle user input
             switch (evt.type)
             {
                 using enum EventType;
@@ -698,19 +1585,34 @@ SECTION("main") auto main() -> int
                 {
                     static constexpr auto sensitivity = float{0.002f};
                     delta_x += evt.data.mouse_move.delta_x * sensitivity;
+
+                    // latency is timed from the first movement of the frame
+                    input_time = (input_time == 0) ? evt.time : input_time;
                     break;
                 }
                 case LEFT_MOUSE_CLICK:
                 {
-                    auto bullet = Bullet{camera.position() + camera.direction() * 2.0f, camera.direction() * 2.0f};
-                    bullets.push_back(&bullet);
+                    const auto position = player_position + camera.direction() * 2.0f;
+                    if (!gpu_projectiles_enabled)
+                    {
+                        projectiles.spawn(position, camera.direction() * 2.0f);
+                    }
+                    else if (snapshot->spawn_count < gpu_projectile_max_spawns)
+                    {
+                        snapshot->spawn_positions[snapshot->spawn_count] = position;
+                        snapshot->spawn_velocities[snapshot->spawn_count] = camera.direction() * 2.0f;
+                        ++snapshot->spawn_count;
+                    }
                     break;
                 }
             }
-
-            has_event = window.pump_message(&evt);
         }
 
+        // a replay reads its recorded frame time along with the frame's events, so this has to come after pumping
+        const auto frame_delta = input_log.frame_delta(measured_delta);
+
+        cpu_profiler_end_scope();
+
         auto walk_direction = Vector3{};
         if (move_forward)
         {
@@ -729,173 +1631,453 @@ SECTION("main") auto main() -> int
             walk_direction += camera.right();
         }
 
-        // map the model buffer into memory, this allows us to easily update it
-        auto *mapped_model_data =
-            reinterpret_cast<ModelData *>(::glMapNamedBuffer(model_data_buffer.native_handle(), GL_WRITE_ONLY));
+        // gather everything bullets can hit, always in the same order as no targets are created or destroyed, so hits
+        // from the gpu a few frames old still refer to the right one
+        Vector3 target_positions[gpu_projectile_max_targets];
+        float target_radii[gpu_projectile_max_targets];
+        std::uint32_t target_entities[gpu_projectile_max_targets];
+        auto target_count = 0u;
+        for (auto a = 0u; a < entities.archetype_count(); ++a)
+        {
+            if (!entities.matches(a, COMPONENT_TRANSFORM | COMPONENT_TARGET))
+            {
+                continue;
+            }
+
+            const auto &archetype = entities.archetype(a);
+            for (auto i = 0u; i < archetype.count; ++i)
+            {
+                ensure(target_count < gpu_projectile_max_targets, ErrorCode::TOO_MANY_TARGETS);
+
+                const auto &transform = archetype.transforms[i];
+                target_positions[target_count] = {transform[12], transform[13], transform[14]};
+                target_radii[target_count] = archetype.target_radii[i];
+                target_entities[target_count] = archetype.entities[i];
+                ++target_count;
+            }
+        }
+
+        const auto move_target = [&](std::uint32_t target)
+        {
+            // generate a random position
+            const auto random_float = [](float min, float max) -> float
+            { return min + static_cast<float>(rand()) / (static_cast<float>(0xFFFFFFFF / (max - min))); };
+
+            auto &transform = entities.transform(target_entities[target]);
+            transform[12] = random_float(-20.0f, 20.0f);
+            transform[14] = random_float(-20.0f, 20.0f);
+            target_positions[target] = {transform[12], transform[13], transform[14]};
+
+            log("hit");
+        };
 
-        // the one enemy model is always the first sphere model
-        auto *enemy = &mapped_model_data[max_models_per_type];
-        const auto enemy_position = Vector3{enemy->model[12], enemy->model[13], enemy->model[14]};
+        // hits from the gpu are a few frames old by now, a target moves once however many bullets got it
+        for (auto i = 0u; i < target_count; ++i)
+        {
+            if (::InterlockedExchange(&gpu_projectile_hits[i], 0) != 0)
+            {
+                move_target(i);
+            }
+        }
 
-        // update the position of all the gun shapes
-        const auto speed = 0.4f;
-        if (walk_direction != Vector3{})
+        // step the simulation at a fixed rate however long the frame took, so the game plays the same at any frame rate
+        accumulator += frame_delta;
+        snapshot->steps = 0u;
+        while (accumulator >= simulation_step)
         {
-            const auto translation = Vector3::normalise(walk_direction) * speed;
-            camera.translate(translation);
+            accumulator -= simulation_step;
+            time += simulation_step;
+            ++snapshot->steps;
+
+            previous_player_position = player_position;
+            if (walk_direction != Vector3{})
+            {
+                player_position += Vector3::normalise(walk_direction) * walk_speed;
+            }
 
-            const auto translation_matrix = Matrix4{translation};
+            // remove bullets that are too far away and move the rest
+            projectiles.step(player_position, bullet_cull_distance);
 
-            // no spheres
+            target_hash.build(target_positions, target_radii, target_count);
 
-            // rely on knowing the fixed offsets of the cube and cylinder models
-            for (auto i = player.cube_start; i < player.cube_end; ++i)
+            // every hit is written before it's read, so nothing needs keeping
+            if (bullet_target_capacity < projectiles.capacity())
             {
-                mapped_model_data[i].model = translation_matrix * mapped_model_data[i].model;
+                free(bullet_targets);
+                bullet_target_capacity = projectiles.capacity();
+                bullet_targets = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * bullet_target_capacity));
             }
-            for (auto i = player.cylinder_start; i < player.cylinder_end; ++i)
+
+            // test the bullets against the targets in parallel, each job only writes the hits of its own bullets
+            auto hit_test_job = HitTestJob{
+                .projectiles = &projectiles,
+                .target_hash = &target_hash,
+                .target_positions = target_positions,
+                .target_radii = target_radii,
+                .bullet_targets = bullet_targets};
+            job_system_parallel_for(projectiles.count(), bullet_grain, hit_test_bullets, &hit_test_job);
+
+            // hits are resolved in order on this thread so the random positions don't depend on the number of workers,
+            // each is checked again as an earlier hit may have already moved the target away
+            for (auto i = 0u; i < projectiles.count(); ++i)
             {
-                mapped_model_data[i + (max_models_per_type * 2u)].model =
-                    translation_matrix * mapped_model_data[i + (max_models_per_type * 2u)].model;
+                // if the bullet hits a target, move the target
+                const auto target = bullet_targets[i];
+                if ((target != no_target) &&
+                    (Vector3::distance(projectiles.position(i), target_positions[target]) < target_radii[target]))
+                {
+                    move_target(target);
+                }
             }
         }
 
-        // rotate the gun shapes around the player with the camera
+        // everything is drawn part way between the last two steps, so motion is smooth even when steps and frames
+        // don't line up
+        const auto alpha = accumulator / simulation_step;
+        const auto render_position = Vector3::lerp(previous_player_position, player_position, alpha);
+
+        // mouse look isn't a rate, so it applies straight away rather than per step
         if (delta_x != 0.0f || delta_y != 0.0f)
         {
             camera.adjust_yaw(delta_x);
             camera.adjust_pitch(-delta_y);
+            gun_yaw += delta_x;
+        }
 
-            for (auto i = player.cube_start; i < player.cube_end; ++i)
-            {
-                mapped_model_data[i].model = Matrix4{camera.position()} * Matrix4{Quaternion{0.0f, -delta_x, 0.0f}} *
-                                             Matrix4{-camera.position()} * mapped_model_data[i].model;
-            }
-            for (auto i = player.cylinder_start; i < player.cylinder_end; ++i)
+        camera.translate(render_position - camera.position());
+
+        snapshot->time = time - ((1.0f - alpha) * simulation_step);
+        snapshot->input_time = input_time;
+        snapshot->alpha = alpha;
+        memcpy(snapshot->target_positions, target_positions, sizeof(Vector3) * target_count);
+        memcpy(snapshot->target_radii, target_radii, sizeof(float) * target_count);
+        snapshot->target_count = target_count;
+        memcpy(snapshot->view, camera.view(), sizeof(snapshot->view));
+        memcpy(snapshot->projection, camera.projection(), sizeof(snapshot->projection));
+        snapshot->camera_position = camera.position();
+
+        // the bullets are written straight into the snapshot, so only their range needs to be the right size
+        instances.resize(bullet_range, projectiles.count());
+        snapshot->layout = instances.layout();
+
+        // each snapshot owns its instances, grown to match the allocator, the gpu bullets come last and are written on
+        // the gpu
+        const auto &layout = snapshot->layout;
+        if (snapshot->model_capacity < layout.total)
+        {
+            if (snapshot->models != nullptr)
             {
-                mapped_model_data[i + (max_models_per_type * 2u)].model =
-                    Matrix4{camera.position()} * Matrix4{Quaternion{0.0f, -delta_x, -0.0f}} *
-                    Matrix4{-camera.position()} * mapped_model_data[i + (max_models_per_type * 2u)].model;
+                free_aligned16(snapshot->models);
             }
+
+            snapshot->models = static_cast<ModelData *>(malloc_aligned16(sizeof(ModelData) * layout.total));
+            snapshot->model_capacity = layout.total;
         }
 
-        ::glClearColor(0.0f, 0.5f, 1.0f, 1.0f);
-        ::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // rebuild everything attached to the player from where it started rather than nudging it every frame, so it
+        // exactly follows the interpolated camera
+        entities.follow(
+            Matrix4{render_position} * Matrix4{Quaternion{0.0f, -gun_yaw, 0.0f}} * Matrix4{-start_position});
+
+        // one linear walk over the entities fills every instance range but the bullets, and another the lights
+        entities.write_instances(layout, snapshot->models);
+        const auto entity_lights = entities.write_lights(snapshot->lights, max_point_lights);
+
+        // there can be far more bullets than lights, the nearest would be better but the first will do
+        const auto bullet_lights = (projectiles.count() < max_point_lights - entity_lights)
+                                       ? projectiles.count()
+                                       : max_point_lights - entity_lights;
+        snapshot->light_count = entity_lights + bullet_lights;
+
+        // update the bullet models and lights, interpolated like everything else, the grain keeps every job but the
+        // last on a whole number of simd lanes
+        auto bullet_emit_job = BulletEmitJob{
+            .projectiles = &projectiles,
+            .alpha = alpha,
+            .models = snapshot->models + layout.bases[bullet_range],
+            .lights = snapshot->lights + entity_lights,
+            .light_count = bullet_lights};
+        job_system_parallel_for(projectiles.count(), bullet_grain, emit_bullets, &bullet_emit_job);
+
+        cpu_profiler_end_scope();
+
+        // the gpu time is a couple of frames behind, but over a whole replay that doesn't matter
+        const auto stage_time = frame_timer.elapsed_seconds();
+        input_log.end_frame(stage_time, pipeline.gpu_time());
+        pipeline.end_produce(stage_time);
+
+        frame_clock.limit();
+    };
+
+    // render stage, uploads a snapshot and does all the gl calls
+    const auto render_frame = [&](const FrameSnapshot &snapshot)
+    {
+        const auto frame_timer = Timer{};
 
-        material.use();
+        cpu_profiler_begin_scope("frame");
+        cpu_profiler_begin_scope("render");
 
-        // not great but good enough
-        time += 1.0f / 30.0f;
-        material.set_uniform("time", time);
+        gpu_profiler.begin_frame();
+        gpu_profiler.begin_scope("frame");
 
-        const auto camera_pos = camera.position();
+        dynamic_resolution.begin_frame();
 
-        player_light.position = camera_pos;
+        gpu_profiler.begin_scope("clear");
+        ::glClearColor(0.0f, 0.5f, 1.0f, 1.0f);
+        ::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        gpu_profiler.end_scope();
 
         // update camera data
-        camera_buffer.write(reinterpret_cast<const std::uint8_t *>(camera.view()), sizeof(Matrix4), 0);
+        camera_buffer.write(reinterpret_cast<const std::uint8_t *>(snapshot.view), sizeof(Matrix4), 0);
         camera_buffer.write(
-            reinterpret_cast<const std::uint8_t *>(camera.projection()), sizeof(Matrix4), sizeof(Matrix4));
-        camera_buffer.write(reinterpret_cast<const std::uint8_t *>(&camera_pos), sizeof(Vector3), sizeof(Matrix4) * 2);
-        ::glBindBufferBase(GL_UNIFORM_BUFFER, 0, camera_buffer.native_handle());
+            reinterpret_cast<const std::uint8_t *>(snapshot.projection), sizeof(Matrix4), sizeof(Matrix4));
+        camera_buffer.write(
+            reinterpret_cast<const std::uint8_t *>(&snapshot.camera_position), sizeof(Vector3), sizeof(Matrix4) * 2);
+        render_queue.bind_buffer(GL_UNIFORM_BUFFER, 0, camera_buffer.native_handle());
+
+        // update the light buffer
+        light_buffer.write(reinterpret_cast<const std::uint8_t *>(&snapshot.light_count), sizeof(int), 0);
+        light_buffer.write(
+            reinterpret_cast<const std::uint8_t *>(snapshot.lights),
+            sizeof(PointLightBuffer) * snapshot.light_count,
+            16);
+
+        // the buffers are rewritten every frame, so when the instances outgrow them there's nothing to copy over, they
+        // grow by half again so this doesn't happen every frame while the bullets are increasing
+        const auto &layout = snapshot.layout;
+        if (layout.total > instance_capacity)
+        {
+            instance_capacity = layout.total + (layout.total / 2u);
+            model_data_buffer.reallocate(sizeof(ModelData) * instance_capacity);
+            instance_index_buffer.reallocate(sizeof(std::uint32_t) * instance_capacity);
+
+            free(instance_indices);
+            instance_indices = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * instance_capacity));
+            free(instance_lods);
+            instance_lods = static_cast<std::uint8_t *>(malloc(instance_capacity));
+
+            log_format("instance buffers grown to %u instances", instance_capacity);
+        }
 
-        auto *cursor = reinterpret_cast<std::uint8_t *>(bullets.begin());
+        // the snapshot has every instance the cpu wrote, so upload it in one go rather than mapping and patching
+        cpu_profiler_begin_scope("upload models");
+        model_data_buffer.write(
+            reinterpret_cast<const std::uint8_t *>(snapshot.models),
+            sizeof(ModelData) * (layout.bases[bullet_range] + layout.counts[bullet_range]),
+            0);
+        cpu_profiler_end_scope();
 
-        // remove bullets that are too far away
-        while (cursor != bullets.end())
+        // bind the SSBOs
+        render_queue.bind_buffer(GL_SHADER_STORAGE_BUFFER, 1, light_buffer.native_handle());
+        render_queue.bind_buffer(GL_SHADER_STORAGE_BUFFER, 2, model_data_buffer.native_handle());
+
+        cpu_profiler_begin_scope("submit");
+
+        // instance rendering, picking a level of detail for every instance so tiny bullets and distant scenery get far
+        // fewer triangles, the queue takes care of ordering the draws
+        const auto pixel_scale = snapshot.projection[5] * (static_cast<float>(height) / 2.0f);
+        auto instance_count = 0u;
+        submit_draw_batches(
+            static_batches,
+            static_batch_count,
+            snapshot.models,
+            layout,
+            snapshot.camera_position,
+            pixel_scale,
+            &materials,
+            instance_lods,
+            instance_indices,
+            &instance_count,
+            &render_queue);
+
+        // bullets are the only batch that changes
+        if (layout.counts[bullet_range] != 0u)
+        {
+            const auto bullet_batch = DrawBatch{
+                .label = "bullets",
+                .mesh = &sphere_mesh,
+                .features = bullet_features,
+                .range = bullet_range,
+                .first_instance = 0u,
+                .instance_count = layout.counts[bullet_range]};
+            submit_draw_batches(
+                &bullet_batch,
+                1u,
+                snapshot.models,
+                layout,
+                snapshot.camera_position,
+                pixel_scale,
+                &materials,
+                instance_lods,
+                instance_indices,
+                &instance_count,
+                &render_queue);
+        }
+
+        instance_index_buffer.write(
+            reinterpret_cast<const std::uint8_t *>(instance_indices), sizeof(std::uint32_t) * instance_count, 0);
+        render_queue.bind_buffer(GL_SHADER_STORAGE_BUFFER, 3, instance_index_buffer.native_handle());
+
+        // the gpu bullets write their instances, indices and lights after the ones just uploaded, so this has to come
+        // after all of them
+        if (gpu_projectiles_enabled)
         {
-            const auto *bullet = reinterpret_cast<Bullet *>(cursor);
-            if (Vector3::distance(bullet->position, camera_pos) > 200.0f)
+            for (auto i = 0u; i < snapshot.spawn_count; ++i)
             {
-                bullets.erase(cursor);
-                continue;
+                gpu_projectiles.spawn(snapshot.spawn_positions[i], snapshot.spawn_velocities[i]);
             }
 
-            cursor += bullets.element_size();
+            gpu_profiler.begin_scope("projectiles");
+            gpu_projectiles.update(
+                snapshot.steps,
+                snapshot.alpha,
+                snapshot.camera_position,
+                bullet_cull_distance,
+                snapshot.target_positions,
+                snapshot.target_radii,
+                snapshot.target_count,
+                snapshot.light_count,
+                max_point_lights - snapshot.light_count,
+                layout.bases[gpu_bullet_range],
+                layout.bases[gpu_bullet_range],
+                &render_queue);
+            gpu_profiler.end_scope();
+
+            gpu_projectiles.submit(materials.get(bullet_features), "bullets", &render_queue);
+
+            std::uint32_t hits[gpu_projectile_max_targets]{};
+            if (gpu_projectiles.read_hits(hits) != 0u)
+            {
+                for (auto i = 0u; i < snapshot.target_count; ++i)
+                {
+                    ::InterlockedExchangeAdd(&gpu_projectile_hits[i], static_cast<long>(hits[i]));
+                }
+            }
         }
 
-        // update the light buffer
-        const auto light_count = bullets.size() + 1;
-        light_buffer.write(reinterpret_cast<const std::uint8_t *>(&light_count), sizeof(int), 0);
-        light_buffer.write(reinterpret_cast<const std::uint8_t *>(&player_light), sizeof(PointLightBuffer), 16);
-
-        // update the bullet positions
-        for (auto i = 0u; i < bullets.size(); ++i)
-        {
-            auto *bullet =
-                reinterpret_cast<Bullet *>(reinterpret_cast<std::uint8_t *>(bullets.begin()) + (i * sizeof(Bullet)));
-            bullet->position += bullet->velocity;
-
-            // update the light attached to the bullet
-            auto bullet_light = PointLightBuffer{{bullet->position}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.01f, 0.032f}};
-            light_buffer.write(
-                reinterpret_cast<const std::uint8_t *>(&bullet_light),
-                sizeof(PointLightBuffer),
-                16 + (sizeof(PointLightBuffer) * (i + 1)));
-
-            auto *model_data = mapped_model_data + max_models_per_type + sphere_model_count + i;
-            model_data->model = Matrix4{bullet->position, {0.1f, 0.1f, 0.1f}};
-            model_data->checker_colour1 = {1.0f, 0.0f, 0.0f};
-            model_data->checker_colour2 = {1.0f, 0.0f, 0.0f};
-
-            // if the bullet hits the enemy, move the enemy
-            if (Vector3::distance(bullet->position, enemy_position) < 3.0f)
+        // uniforms are set on the programs directly, so this doesn't need to wait for the queue to bind them
+        for (auto i = 0u; i < material_permutation_count; ++i)
+        {
+            if (permutation_used[i])
             {
-                // generate a random position
-                const auto random_float = [](float min, float max) -> float
-                { return min + static_cast<float>(rand()) / (static_cast<float>(0xFFFFFFFF / (max - min))); };
+                materials.get(i).set_uniform(time_slots[i], snapshot.time);
+            }
+        }
 
-                enemy->model[12] = random_float(-20.0f, 20.0f);
-                enemy->model[14] = random_float(-20.0f, 20.0f);
+        cpu_profiler_end_scope();
 
-                log("hit");
-            }
+        gpu_profiler.begin_scope("scene");
+        render_queue.flush(&gpu_profiler);
+        gpu_profiler.end_scope();
+
+        gpu_profiler.begin_scope("upscale");
+        dynamic_resolution.end_frame();
+        gpu_profiler.end_scope();
+
+        gpu_profiler.end_scope();
+        gpu_profiler.end_frame();
+
+        if ((++frame_count % 600u) == 0u)
+        {
+            // no float formatting, so print as fixed point
+            const auto gpu_us = to_int(dynamic_resolution.gpu_frame_time() * 1000000.0f);
+            log_format(
+                "dynamic resolution: scale %d%%, gpu frame time %d.%03dms",
+                to_int(dynamic_resolution.scale() * 100.0f + 0.5f),
+                gpu_us / 1000,
+                gpu_us % 1000);
+
+            const auto &stats = render_queue.stats();
+            log_format(
+                "render queue: %u packets, %u draws, %u binds (%u redundant), %u program changes (%u redundant)",
+                stats.packets,
+                stats.draws,
+                stats.binds,
+                stats.redundant_binds,
+                stats.state_changes,
+                stats.redundant_state_changes);
+
+            gpu_profiler.dump();
+            frame_latency.report();
+            pipeline.report();
         }
 
-        // bind the SSBOs
-        ::glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, light_buffer.native_handle());
-        ::glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, model_data_buffer.native_handle());
-
-        // unmap the model buffer, should be RAII
-        ::glUnmapNamedBuffer(model_data_buffer.native_handle());
-
-        // instance rendering, draw each of the shape types
-
-        cube_mesh.bind();
-        ::glDrawElementsInstancedBaseInstance(
-            GL_TRIANGLES,
-            cube_mesh.index_count(),
-            GL_UNSIGNED_INT,
-            reinterpret_cast<void *>(cube_mesh.index_offset()),
-            cube_model_count,
-            0u);
-        cube_mesh.unbind();
-
-        sphere_mesh.bind();
-        ::glDrawElementsInstancedBaseInstance(
-            GL_TRIANGLES,
-            sphere_mesh.index_count(),
-            GL_UNSIGNED_INT,
-            reinterpret_cast<void *>(sphere_mesh.index_offset()),
-            sphere_model_count + bullets.size(),
-            max_models_per_type);
-        sphere_mesh.unbind();
-
-        cylinder_mesh.bind();
-        ::glDrawElementsInstancedBaseInstance(
-            GL_TRIANGLES,
-            cylinder_mesh.index_count(),
-            GL_UNSIGNED_INT,
-            reinterpret_cast<void *>(cylinder_mesh.index_offset()),
-            cylinder_model_count,
-            max_models_per_type * 2u);
-        cylinder_mesh.unbind();
+        cpu_profiler_end_scope();
 
+        // the swap can block on vsync, which isn't work the render stage did
+        const auto stage_time = frame_timer.elapsed_seconds();
+
+        cpu_profiler_begin_scope("swap");
         window.swap();
+        frame_latency.end_frame(snapshot.input_time);
+        cpu_profiler_end_scope();
+
+        cpu_profiler_end_scope();
+
+        const auto *gpu_frame = gpu_profiler.find("frame");
+        pipeline.end_consume(stage_time, (gpu_frame != nullptr) ? gpu_frame->last / 1000.0f : 0.0f);
+    };
+
+    // the simulation thread only stops producing frames once the window closes or the replay ends
+    auto run_simulation = [&]()
+    {
+        cpu_profiler_register_thread("simulation");
+        job_system_register_thread();
+
+        while (window.running() && !input_log.finished())
+        {
+            simulate_frame();
+        }
+
+        pipeline.finish();
+    };
+
+    // the thread entry point can't capture, so it gets the stage through its parameter
+    if (pipelined)
+    {
+        ::CreateThread(
+            nullptr,
+            0,
+            [](void *param) -> ::DWORD
+            {
+                (*static_cast<decltype(run_simulation) *>(param))();
+                return 0u;
+            },
+            &run_simulation,
+            0,
+            nullptr);
+    }
+
+    for (;;)
+    {
+        if (!pipelined)
+        {
+            if (!window.running() || input_log.finished())
+            {
+                break;
+            }
+
+            simulate_frame();
+        }
+
+        const auto *snapshot = static_cast<const FrameSnapshot *>(pipeline.begin_consume());
+        if (snapshot == nullptr)
+        {
+            break;
+        }
+
+        render_frame(*snapshot);
     }
 
     log("stopping");
 
+    // write a trace of the last few seconds if asked, TEKTITE_CPU_TRACE is the path to write it to
+    char trace_path[MAX_PATH];
+    if (::GetEnvironmentVariableA("TEKTITE_CPU_TRACE", trace_path, sizeof(trace_path)) != 0)
+    {
+        cpu_profiler_export(trace_path);
+    }
+
     // avoid cleanup, just die
     ::ExitProcess(0);
 }
@@ -1,61 +1,200 @@
 #include "material.h"
 
+#include <cstdint>
+
 #include "error.h"
 #include "log.h"
 #include "opengl.h"
+#include "program_cache.h"
 #include "shader.h"
 
-Material::Material(const Shader &vertex_shader, const Shader &fragment_shader)
-    : handle_{::glCreateProgram()}
+namespace
 {
-    ensure(handle_ != 0u, ErrorCode::FAILED_TO_CREATE_PROGRAM);
-
-    ::glAttachShader(handle_, vertex_shader.native_handle());
-    ::glAttachShader(handle_, fragment_shader.native_handle());
-    ::glLinkProgram(handle_);
 
+/**
+ * Helper function to check a program linked, logging the error and exiting if it didn't.
+ *
+ * @param handle
+ *   The program to check.
+ */
+auto check_link_status(::GLuint handle) -> void
+{
     ::GLint result{};
-    ::glGetProgramiv(handle_, GL_LINK_STATUS, &result);
+    ::glGetProgramiv(handle, GL_LINK_STATUS, &result);
 
     if (result != GL_TRUE)
     {
         char error_log[512];
-        ::glGetProgramInfoLog(handle_, sizeof(error_log), nullptr, error_log);
+        ::glGetProgramInfoLog(handle, sizeof(error_log), nullptr, error_log);
 
         log(error_log);
         die(ErrorCode::FAILED_TO_LINK_PROGRAM);
     }
 }
 
+/**
+ * Helper function to link a program.
+ *
+ * @param handle
+ *   The program to link.
+ * @param vertex_shader
+ *   The vertex shader.
+ * @param fragment_shader
+ *   The fragment shader.
+ */
+auto link(::GLuint handle, const Shader &vertex_shader, const Shader &fragment_shader) -> void
+{
+    ::glAttachShader(handle, vertex_shader.native_handle());
+    ::glAttachShader(handle, fragment_shader.native_handle());
+    ::glLinkProgram(handle);
+
+    check_link_status(handle);
+}
+
+/**
+ * Helper function to hash a uniform name (FNV-1a). Names are never compared, two active uniforms in one program with
+ * the same 32 bit hash is vanishingly unlikely.
+ *
+ * @param name
+ *   The name to hash.
+ *
+ * @return
+ *   Hash of the name.
+ */
+auto hash_name(const char *name) -> std::uint32_t
+{
+    auto hash = 2166136261u;
+
+    for (const auto *cursor = name; *cursor != '\0'; ++cursor)
+    {
+        hash = (hash ^ static_cast<std::uint8_t>(*cursor)) * 16777619u;
+    }
+
+    return hash;
+}
+
+}
+
+Material::Material()
+    : handle_{}
+    , uniform_hashes_{}
+    , uniform_locations_{}
+{
+    reflect();
+}
+
+Material::Material(const Shader &vertex_shader, const Shader &fragment_shader)
+    : handle_{::glCreateProgram()}
+    , uniform_hashes_{}
+    , uniform_locations_{}
+{
+    ensure(handle_ != 0u, ErrorCode::FAILED_TO_CREATE_PROGRAM);
+
+    link(handle_, vertex_shader, fragment_shader);
+    reflect();
+}
+
+Material::Material(const Shader &compute_shader)
+    : handle_{::glCreateProgram()}
+    , uniform_hashes_{}
+    , uniform_locations_{}
+{
+    ensure(handle_ != 0u, ErrorCode::FAILED_TO_CREATE_PROGRAM);
+
+    ::glAttachShader(handle_, compute_shader.native_handle());
+    ::glLinkProgram(handle_);
+
+    check_link_status(handle_);
+    reflect();
+}
+
+Material::Material(const char *vertex_source, const char *fragment_source, const char *defines, ProgramCache *cache)
+    : handle_{::glCreateProgram()}
+    , uniform_hashes_{}
+    , uniform_locations_{}
+{
+    ensure(handle_ != 0u, ErrorCode::FAILED_TO_CREATE_PROGRAM);
+
+    const auto key = cache->key(vertex_source, fragment_source, defines);
+
+    if (!cache->load(key, handle_))
+    {
+        const auto vertex_shader = Shader{vertex_source, ShaderType::VERTEX, defines};
+        const auto fragment_shader = Shader{fragment_source, ShaderType::FRAGMENT, defines};
+
+        // has to be set before linking for the driver to keep the binary around
+        ::glProgramParameteri(handle_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        link(handle_, vertex_shader, fragment_shader);
+
+        cache->store(key, handle_);
+    }
+
+    reflect();
+}
+
 auto Material::use() const -> void
 {
     ::glUseProgram(handle_);
 }
 
+auto Material::uniform_slot(const char *name) const -> UniformSlot
+{
+    const auto hash = hash_name(name);
+
+    for (auto i = 0u; i < uniform_table_size; ++i)
+    {
+        const auto index = (hash + i) & (uniform_table_size - 1u);
+
+        if (uniform_locations_[index] == -1)
+        {
+            break;
+        }
+
+        if (uniform_hashes_[index] == hash)
+        {
+            return {static_cast<std::int32_t>(index)};
+        }
+    }
+
+    return {-1};
+}
+
 auto Material::set_uniform(const char *name, const Matrix4 &obj) const -> void
 {
-    // not efficient to get the location every time, but it is easy
-    if (const auto location = ::glGetUniformLocation(handle_, name); location != -1)
+    set_uniform(uniform_slot(name), obj);
+}
+
+auto Material::set_uniform(UniformSlot slot, const Matrix4 &obj) const -> void
+{
+    if (slot.index != -1)
     {
-        ::glUniformMatrix4fv(location, 1, GL_FALSE, obj.data());
+        ::glProgramUniformMatrix4fv(handle_, uniform_locations_[slot.index], 1, GL_FALSE, obj.data());
     }
 }
 
 auto Material::set_uniform(const char *name, int obj) const -> void
 {
-    // not efficient to get the location every time, but it is easy
-    if (const auto location = ::glGetUniformLocation(handle_, name); location != -1)
+    set_uniform(uniform_slot(name), obj);
+}
+
+auto Material::set_uniform(UniformSlot slot, int obj) const -> void
+{
+    if (slot.index != -1)
     {
-        ::glUniform1i(location, obj);
+        ::glProgramUniform1i(handle_, uniform_locations_[slot.index], obj);
     }
 }
 
 auto Material::set_uniform(const char *name, float obj) const -> void
 {
-    // not efficient to get the location every time, but it is easy
-    if (const auto location = ::glGetUniformLocation(handle_, name); location != -1)
+    set_uniform(uniform_slot(name), obj);
+}
+
+auto Material::set_uniform(UniformSlot slot, float obj) const -> void
+{
+    if (slot.index != -1)
     {
-        ::glUniform1f(location, obj);
+        ::glProgramUniform1f(handle_, uniform_locations_[slot.index], obj);
     }
 }
 
@@ -63,3 +202,97 @@ auto Material::native_handle() const -> ::GLuint
 {
     return handle_;
 }
+
+auto Material::check_layout(
+    ::GLenum interface, const char *name, std::uint32_t offset, std::uint32_t array_stride) const -> void
+{
+    const auto index = ::glGetProgramResourceIndex(handle_, interface, name);
+    if (index == GL_INVALID_INDEX)
+    {
+        log_format("layout of %s not checked, it is not active", name);
+        return;
+    }
+
+    // only storage block members have a top level stride, uniform block members just have the one array stride
+    const ::GLenum properties[] = {
+        GL_OFFSET, (interface == GL_BUFFER_VARIABLE) ? GL_TOP_LEVEL_ARRAY_STRIDE : GL_ARRAY_STRIDE};
+    ::GLint values[2]{};
+    ::glGetProgramResourceiv(handle_, interface, index, 2, properties, 2, nullptr, values);
+
+    if ((values[0] != static_cast<::GLint>(offset)) || (values[1] != static_cast<::GLint>(array_stride)))
+    {
+        log_format(
+            "layout of %s is offset %d stride %d, expected offset %u stride %u",
+            name,
+            values[0],
+            values[1],
+            offset,
+            array_stride);
+        die(ErrorCode::SHADER_LAYOUT_MISMATCH);
+    }
+}
+
+auto Material::reflect() -> void
+{
+    for (auto i = 0u; i < uniform_table_size; ++i)
+    {
+        uniform_locations_[i] = -1;
+    }
+
+    if (handle_ == 0u)
+    {
+        return;
+    }
+
+    auto uniform_count = ::GLint{};
+    ::glGetProgramiv(handle_, GL_ACTIVE_UNIFORMS, &uniform_count);
+
+    for (auto i = 0; i < uniform_count; ++i)
+    {
+        // the location comes from the same walk as the name rather than looking the name up again, which isn't
+        // reliable for SPIR-V programs
+        static constexpr ::GLenum properties[] = {GL_LOCATION};
+        auto location = ::GLint{-1};
+        ::glGetProgramResourceiv(handle_, GL_UNIFORM, static_cast<::GLuint>(i), 1, properties, 1, nullptr, &location);
+
+        // members of uniform blocks are active uniforms too, but they have no location to set
+        if (location == -1)
+        {
+            continue;
+        }
+
+        char name[64];
+        auto length = ::GLsizei{};
+        ::glGetProgramResourceName(handle_, GL_UNIFORM, static_cast<::GLuint>(i), sizeof(name), &length, name);
+
+        // SPIR-V built without debug names has nothing to look a uniform up by, so it can't be set through the table
+        if (length == 0)
+        {
+            log_format("uniform at location %d has no name, only programs with names are reflected", location);
+            continue;
+        }
+
+        // arrays are reported by their first element, but are set by their plain name
+        if ((length >= 3) && (name[length - 3] == '[') && (name[length - 2] == '0') && (name[length - 1] == ']'))
+        {
+            name[length - 3] = '\0';
+        }
+
+        const auto hash = hash_name(name);
+        auto inserted = false;
+
+        for (auto j = 0u; (j < uniform_table_size) && !inserted; ++j)
+        {
+            const auto index = (hash + j) & (uniform_table_size - 1u);
+
+            if (uniform_locations_[index] == -1)
+            {
+                uniform_hashes_[index] = hash;
+                uniform_locations_[index] = location;
+                inserted = true;
+            }
+        }
+
+        ensure(inserted, ErrorCode::TOO_MANY_UNIFORMS);
+    }
+}
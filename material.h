@@ -4,16 +4,33 @@
 
 #include "matrix4.h"
 #include "opengl.h"
+#include "program_cache.h"
 #include "shader.h"
 
+/**
+ * Handle to a uniform of a material, an index into its table of reflected uniforms. Only valid for the material that
+ * created it.
+ */
+struct UniformSlot
+{
+    std::int32_t index;
+};
+
 /**
  * Class representing a material i.e. a linkedn OpenGl program.
  *
- * Note that for simplicity no cleanup is performed.
+ * After linking the active uniforms are reflected into a small hash table, so setting a uniform never has to ask the
+ * driver for its location. Uniforms are set directly on the program, so the material doesn't need to be in use. Note
+ * that for simplicity no cleanup is performed.
  */
 class Material
 {
   public:
+    /**
+     * Construct an empty material, it has no program so must be assigned to before it is used.
+     */
+    Material();
+
     /**
      * Construct a new material.
      *
@@ -24,11 +41,47 @@ class Material
      */
     Material(const Shader &vertex_shader, const Shader &fragment_shader);
 
+    /**
+     * Construct a new compute material, it is run with RenderQueue::dispatch rather than drawn with.
+     *
+     * @param compute_shader
+     *   The compute shader.
+     */
+    Material(const Shader &compute_shader);
+
+    /**
+     * Construct a new material from source, going via the program cache.
+     *
+     * If the cache has a binary that the driver accepts then no shaders are compiled at all, otherwise the shaders are
+     * compiled and linked as normal and the result is written back to the cache.
+     *
+     * @param vertex_source
+     *   The vertex shader source.
+     * @param fragment_source
+     *   The fragment shader source.
+     * @param defines
+     *   Extra source to inject after the #version line of both shaders.
+     * @param cache
+     *   The program cache to use.
+     */
+    Material(const char *vertex_source, const char *fragment_source, const char *defines, ProgramCache *cache);
+
     /**
      * Use the material.
      */
     auto use() const -> void;
 
+    /**
+     * Look up the slot of a uniform, do this once and keep the slot for per-frame sets.
+     *
+     * @param name
+     *   The name of the uniform.
+     *
+     * @return
+     *   Slot of the uniform, setting an invalid slot (i.e. for a uniform that isn't active) does nothing.
+     */
+    auto uniform_slot(const char *name) const -> UniformSlot;
+
     /**
      * Set a uniform matrix.
      *
@@ -39,6 +92,16 @@ class Material
      */
     auto set_uniform(const char *name, const Matrix4 &obj) const -> void;
 
+    /**
+     * Set a uniform matrix.
+     *
+     * @param slot
+     *   The slot of the uniform.
+     * @param obj
+     *   The matrix to set.
+     */
+    auto set_uniform(UniformSlot slot, const Matrix4 &obj) const -> void;
+
     /**
      * Set a uniform integer.
      *
@@ -49,6 +112,16 @@ class Material
      */
     auto set_uniform(const char *name, int obj) const -> void;
 
+    /**
+     * Set a uniform integer.
+     *
+     * @param slot
+     *   The slot of the uniform.
+     * @param obj
+     *   The integer to set.
+     */
+    auto set_uniform(UniformSlot slot, int obj) const -> void;
+
     /**
      * Set a uniform float.
      *
@@ -59,6 +132,16 @@ class Material
      */
     auto set_uniform(const char *name, float obj) const -> void;
 
+    /**
+     * Set a uniform float.
+     *
+     * @param slot
+     *   The slot of the uniform.
+     * @param obj
+     *   The float to set.
+     */
+    auto set_uniform(UniformSlot slot, float obj) const -> void;
+
     /**
      * Get the native handle of the material.
      *
@@ -67,7 +150,38 @@ class Material
      */
     auto native_handle() const -> ::GLuint;
 
+    /**
+     * Check that a member of a shader storage or uniform block is where the C++ side expects it to be, dies if not.
+     *
+     * Members the linker has optimised away have no layout to check and are skipped.
+     *
+     * @param interface
+     *   GL_BUFFER_VARIABLE for a member of a shader storage block, GL_UNIFORM for a member of a uniform block.
+     * @param name
+     *   Full name of the member, e.g. "data[0].model".
+     * @param offset
+     *   Expected offset of the member from the start of its block.
+     * @param array_stride
+     *   Expected stride of the (top level for storage blocks) array the member is in, zero if it isn't in one.
+     */
+    auto check_layout(::GLenum interface, const char *name, std::uint32_t offset, std::uint32_t array_stride) const
+        -> void;
+
   private:
+    /**
+     * Fill the uniform table from the linked program.
+     */
+    auto reflect() -> void;
+
+    /** Number of entries in the uniform table, must be a power of two. */
+    static constexpr auto uniform_table_size = 16u;
+
     /** The native handle of the material. */
     ::GLuint handle_;
+
+    /** Hashes of the uniform names, open addressed on the low bits. */
+    std::uint32_t uniform_hashes_[uniform_table_size];
+
+    /** Locations of the uniforms, -1 for an empty entry. */
+    ::GLint uniform_locations_[uniform_table_size];
 };
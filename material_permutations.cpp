@@ -0,0 +1,185 @@
+#include "material_permutations.h"
+
+#include <cstdint>
+
+#include <Windows.h>
+
+#include "error.h"
+#include "log.h"
+#include "material.h"
+#include "model_data.h"
+#include "program_cache.h"
+#include "shader.h"
+#include "vector3.h"
+
+namespace
+{
+
+/** Number of feature bits, which are also the first specialisation constant ids. */
+static constexpr auto g_feature_count = 5u;
+
+/** Specialisation constant id of the light limit in the fragment shader. */
+static constexpr auto g_max_point_lights_constant_id = g_feature_count;
+
+/** Specialisation constant id of the packed vertex flag in the vertex shader. */
+static constexpr auto g_packed_vertices_constant_id = g_feature_count + 1u;
+
+/**
+ * Helper function to build the #define block for a set of features.
+ *
+ * @param features
+ *   Bitwise or of MaterialFeature values.
+ * @param max_point_lights
+ *   Limit on the number of lights.
+ * @param packed_vertices
+ *   Whether meshes use the packed vertex format.
+ * @param defines
+ *   Buffer to write the defines to, must be large enough.
+ */
+auto build_defines(std::uint32_t features, std::uint32_t max_point_lights, bool packed_vertices, char *defines) -> void
+{
+    ::wsprintfA(
+        defines,
+        "#define FEATURE_CHECKER %d\n"
+        "#define FEATURE_WOOD %d\n"
+        "#define FEATURE_METAL %d\n"
+        "#define FEATURE_WATER %d\n"
+        "#define FEATURE_BUMP %d\n"
+        "#define MAX_POINT_LIGHTS %u\n"
+        "#define PACKED_VERTICES %d\n",
+        (features & MATERIAL_FEATURE_CHECKER) != 0u,
+        (features & MATERIAL_FEATURE_WOOD) != 0u,
+        (features & MATERIAL_FEATURE_METAL) != 0u,
+        (features & MATERIAL_FEATURE_WATER) != 0u,
+        (features & MATERIAL_FEATURE_BUMP) != 0u,
+        max_point_lights,
+        packed_vertices);
+}
+
+}
+
+auto classify_material(const ModelData &model) -> std::uint32_t
+{
+    auto features = 0u;
+
+    if ((model.checker_colour1 != Vector3{}) || (model.checker_colour2 != Vector3{}))
+    {
+        features |= MATERIAL_FEATURE_CHECKER;
+    }
+
+    if ((model.water_colour1 != Vector3{}) || (model.water_colour2 != Vector3{}))
+    {
+        features |= MATERIAL_FEATURE_WATER;
+    }
+
+    if (model.normal_scale != 0.0f)
+    {
+        features |= MATERIAL_FEATURE_BUMP;
+    }
+
+    return features;
+}
+
+MaterialPermutations::MaterialPermutations(
+    const char *vertex_source,
+    const char *fragment_source,
+    std::uint32_t max_point_lights,
+    bool packed_vertices,
+    ProgramCache *cache)
+    : vertex_source_{vertex_source}
+    , fragment_source_{fragment_source}
+    , vertex_spirv_{}
+    , vertex_spirv_size_{}
+    , fragment_spirv_{}
+    , fragment_spirv_size_{}
+    , max_point_lights_{max_point_lights}
+    , packed_vertices_{packed_vertices}
+    , cache_{cache}
+    , materials_{}
+    , compiled_count_{}
+{
+}
+
+MaterialPermutations::MaterialPermutations(
+    const std::uint32_t *vertex_spirv,
+    std::uint32_t vertex_spirv_size,
+    const std::uint32_t *fragment_spirv,
+    std::uint32_t fragment_spirv_size,
+    std::uint32_t max_point_lights,
+    bool packed_vertices)
+    : vertex_source_{}
+    , fragment_source_{}
+    , vertex_spirv_{vertex_spirv}
+    , vertex_spirv_size_{vertex_spirv_size}
+    , fragment_spirv_{fragment_spirv}
+    , fragment_spirv_size_{fragment_spirv_size}
+    , max_point_lights_{max_point_lights}
+    , packed_vertices_{packed_vertices}
+    , cache_{}
+    , materials_{}
+    , compiled_count_{}
+{
+}
+
+auto MaterialPermutations::get(std::uint32_t features) -> const Material &
+{
+    ensure(features < material_permutation_count, ErrorCode::UNKNOWN_MATERIAL_PERMUTATION);
+
+    auto &material = materials_[features];
+
+    if (material.native_handle() == 0u)
+    {
+        if (vertex_spirv_ != nullptr)
+        {
+            // feature bit i is specialisation constant i, the light limit comes straight after them
+            std::uint32_t constant_ids[g_feature_count + 1u];
+            std::uint32_t constant_values[g_feature_count + 1u];
+
+            for (auto i = 0u; i < g_feature_count; ++i)
+            {
+                constant_ids[i] = i;
+                constant_values[i] = (features >> i) & 1u;
+            }
+
+            constant_ids[g_feature_count] = g_max_point_lights_constant_id;
+            constant_values[g_feature_count] = max_point_lights_;
+
+            const auto vertex_constant_id = g_packed_vertices_constant_id;
+            const auto vertex_constant_value = packed_vertices_ ? 1u : 0u;
+
+            const auto vertex_shader = Shader{
+                vertex_spirv_,
+                vertex_spirv_size_,
+                ShaderType::VERTEX,
+                &vertex_constant_id,
+                &vertex_constant_value,
+                1u};
+            const auto fragment_shader = Shader{
+                fragment_spirv_,
+                fragment_spirv_size_,
+                ShaderType::FRAGMENT,
+                constant_ids,
+                constant_values,
+                g_feature_count + 1u};
+
+            material = Material{vertex_shader, fragment_shader};
+        }
+        else
+        {
+            char defines[256];
+            build_defines(features, max_point_lights_, packed_vertices_, defines);
+
+            material = Material{vertex_source_, fragment_source_, defines, cache_};
+        }
+
+        ++compiled_count_;
+        log_format("created material permutation %u", features);
+    }
+
+    return material;
+}
+
+auto MaterialPermutations::compiled_count() const -> std::uint32_t
+{
+    return compiled_count_;
+}
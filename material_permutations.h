@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+
+#include "material.h"
+#include "model_data.h"
+#include "program_cache.h"
+
+/**
+ * Bit flags for the optional parts of the uber shader. Each one maps to a FEATURE_* define when compiling from GLSL and
+ * to the specialisation constant with the same id as the bit index when loading SPIR-V.
+ */
+enum MaterialFeature : std::uint32_t
+{
+    MATERIAL_FEATURE_CHECKER = 1u << 0u,
+    MATERIAL_FEATURE_WOOD = 1u << 1u,
+    MATERIAL_FEATURE_METAL = 1u << 2u,
+    MATERIAL_FEATURE_WATER = 1u << 3u,
+    MATERIAL_FEATURE_BUMP = 1u << 4u,
+};
+
+/** Number of possible permutations, one for every combination of features. */
+static constexpr auto material_permutation_count = 32u;
+
+/**
+ * Work out which features an instance actually needs.
+ *
+ * A pattern is only needed if it can contribute something, e.g. a checker with two black colours adds nothing to the
+ * albedo so can be skipped. Note that the original uber shader never drew the wood or metal patterns, so to keep the
+ * scene looking the same those are never enabled here, they are only available to callers that ask for them.
+ *
+ * @param model
+ *   The instance to classify.
+ *
+ * @return
+ *   Bitwise or of the MaterialFeature values the instance needs.
+ */
+auto classify_material(const ModelData &model) -> std::uint32_t;
+
+/**
+ * Class managing all the permutations of the uber shader.
+ *
+ * Programs are only created the first time a permutation is asked for. From GLSL they go via the program cache so a
+ * warm start doesn't compile anything, from SPIR-V there is no GLSL to parse in the first place. Note that for
+ * simplicity no cleanup is performed.
+ */
+class MaterialPermutations
+{
+  public:
+    /**
+     * Construct a new permutation set.
+     *
+     * @param vertex_source
+     *   Source of the vertex shader.
+     * @param fragment_source
+     *   Source of the fragment shader, expected to use the FEATURE_* and MAX_POINT_LIGHTS defines.
+     * @param max_point_lights
+     *   Limit on the number of lights the light loop will process.
+     * @param packed_vertices
+     *   Whether meshes use the packed vertex format, sets the PACKED_VERTICES define.
+     * @param cache
+     *   Cache to load and store programs with.
+     */
+    MaterialPermutations(
+        const char *vertex_source,
+        const char *fragment_source,
+        std::uint32_t max_point_lights,
+        bool packed_vertices,
+        ProgramCache *cache);
+
+    /**
+     * Construct a new permutation set from precompiled SPIR-V.
+     *
+     * @param vertex_spirv
+     *   SPIR-V of the vertex shader, expected to have specialisation constant 6 for the packed vertex flag.
+     * @param vertex_spirv_size
+     *   Size in bytes of the vertex shader SPIR-V.
+     * @param fragment_spirv
+     *   SPIR-V of the fragment shader, expected to have specialisation constants 0-4 for the features and 5 for the
+     *   light limit.
+     * @param fragment_spirv_size
+     *   Size in bytes of the fragment shader SPIR-V.
+     * @param max_point_lights
+     *   Limit on the number of lights the light loop will process.
+     * @param packed_vertices
+     *   Whether meshes use the packed vertex format.
+     */
+    MaterialPermutations(
+        const std::uint32_t *vertex_spirv,
+        std::uint32_t vertex_spirv_size,
+        const std::uint32_t *fragment_spirv,
+        std::uint32_t fragment_spirv_size,
+        std::uint32_t max_point_lights,
+        bool packed_vertices);
+
+    /**
+     * Get the material for a set of features, compiling it if necessary.
+     *
+     * @param features
+     *   Bitwise or of MaterialFeature values.
+     *
+     * @return
+     *   The material for the features.
+     */
+    auto get(std::uint32_t features) -> const Material &;
+
+    /**
+     * Get the number of permutations that have been compiled.
+     *
+     * @return
+     *   Number of compiled permutations.
+     */
+    auto compiled_count() const -> std::uint32_t;
+
+  private:
+    /** Source of the vertex shader, kept around for lazy compilation. */
+    const char *vertex_source_;
+
+    /** Source of the fragment shader, kept around for lazy compilation. */
+    const char *fragment_source_;
+
+    /** SPIR-V of the vertex shader, null when compiling from source. */
+    const std::uint32_t *vertex_spirv_;
+
+    /** Size in bytes of the vertex shader SPIR-V. */
+    std::uint32_t vertex_spirv_size_;
+
+    /** SPIR-V of the fragment shader, null when compiling from source. */
+    const std::uint32_t *fragment_spirv_;
+
+    /** Size in bytes of the fragment shader SPIR-V. */
+    std::uint32_t fragment_spirv_size_;
+
+    /** Limit on the number of lights the light loop will process. */
+    std::uint32_t max_point_lights_;
+
+    /** Whether meshes use the packed vertex format. */
+    bool packed_vertices_;
+
+    /** Cache to load and store programs with, null when loading SPIR-V. */
+    ProgramCache *cache_;
+
+    /** Materials indexed by feature bits, empty until first requested. */
+    Material materials_[material_permutation_count];
+
+    /** Number of compiled permutations. */
+    std::uint32_t compiled_count_;
+};
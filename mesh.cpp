@@ -1,28 +1,281 @@
 #include "mesh.h"
 
+#include <bit>
+#include <cstdint>
+
 #include "buffer.h"
+#include "clib.h"
 #include "error.h"
 #include "opengl.h"
 #include "vertex_data.h"
 
+namespace
+{
+
+/**
+ * Helper function to get the size of a vertex in a given format.
+ *
+ * @param format
+ *   The vertex format.
+ *
+ * @return
+ *   Size in bytes of a vertex.
+ */
+auto vertex_size(VertexFormat format) -> std::uint32_t
+{
+    return (format == VertexFormat::PACKED) ? sizeof(PackedVertexData) : sizeof(VertexData);
+}
+
+/**
+ * Helper function to get the size of an index, indices are relative to their level so only the largest level matters.
+ *
+ * @param vertex_counts
+ *   The number of vertices for each level.
+ * @param lod_count
+ *   The number of levels.
+ *
+ * @return
+ *   Size in bytes of an index.
+ */
+auto index_size(const std::uint32_t *vertex_counts, std::uint32_t lod_count) -> std::uint32_t
+{
+    for (auto i = 0u; i < lod_count; ++i)
+    {
+        if (vertex_counts[i] > 0x10000u)
+        {
+            return sizeof(std::uint32_t);
+        }
+    }
+
+    return sizeof(std::uint16_t);
+}
+
+/**
+ * Helper function to get the size of the buffer needed for all the levels of detail of a mesh.
+ *
+ * @param vertex_counts
+ *   The number of vertices for each level.
+ * @param index_counts
+ *   The number of indices for each level.
+ * @param lod_count
+ *   The number of levels.
+ * @param format
+ *   The vertex format.
+ *
+ * @return
+ *   Size in bytes of the buffer.
+ */
+auto buffer_size(
+    const std::uint32_t *vertex_counts,
+    const std::uint32_t *index_counts,
+    std::uint32_t lod_count,
+    VertexFormat format) -> std::uint32_t
+{
+    auto size = 0u;
+
+    for (auto i = 0u; i < lod_count; ++i)
+    {
+        size += vertex_size(format) * vertex_counts[i] + index_size(vertex_counts, lod_count) * index_counts[i];
+    }
+
+    return size;
+}
+
+/**
+ * Helper function to convert a float in [-1, 1] to a snorm16, rounding to nearest.
+ *
+ * @param value
+ *   The value to convert, clamped if out of range.
+ *
+ * @return
+ *   The snorm16 value.
+ */
+auto to_snorm16(float value) -> std::int16_t
+{
+    const auto clamped = (value > 1.0f) ? 1.0f : ((value < -1.0f) ? -1.0f : value);
+    return static_cast<std::int16_t>(to_int((clamped * 32767.0f) + ((clamped >= 0.0f) ? 0.5f : -0.5f)));
+}
+
+/**
+ * Helper function to convert a float to a half float, rounding to nearest. Values too small for a normal half are
+ * flushed to zero, which is fine for texture coordinates.
+ *
+ * @param value
+ *   The value to convert.
+ *
+ * @return
+ *   The bits of the half float.
+ */
+auto to_half(float value) -> std::uint16_t
+{
+    const auto bits = std::bit_cast<std::uint32_t>(value);
+    const auto sign = static_cast<std::uint16_t>((bits >> 16u) & 0x8000u);
+    const auto exponent = static_cast<std::int32_t>((bits >> 23u) & 0xffu) - 127 + 15;
+    const auto mantissa = bits & 0x7fffffu;
+
+    if (exponent <= 0)
+    {
+        return sign;
+    }
+
+    if (exponent >= 31)
+    {
+        return sign | 0x7c00u;
+    }
+
+    // a carry out of the mantissa correctly bumps the exponent
+    auto half = static_cast<std::uint32_t>(sign) | (static_cast<std::uint32_t>(exponent) << 10u) | (mantissa >> 13u);
+    if ((mantissa & 0x1000u) != 0u)
+    {
+        ++half;
+    }
+
+    return static_cast<std::uint16_t>(half);
+}
+
+/**
+ * Helper function to octahedral encode a unit vector, i.e. project it on to an octahedron and unfold that into a
+ * square.
+ *
+ * @param v
+ *   The unit vector to encode.
+ * @param encoded
+ *   Array to write the two snorm16 components to.
+ */
+auto octahedral_encode(const Vector3 &v, std::int16_t *encoded) -> void
+{
+    const auto abs_x = (v.x < 0.0f) ? -v.x : v.x;
+    const auto abs_y = (v.y < 0.0f) ? -v.y : v.y;
+    const auto abs_z = (v.z < 0.0f) ? -v.z : v.z;
+    const auto l1_norm = abs_x + abs_y + abs_z;
+
+    auto x = v.x / l1_norm;
+    auto y = v.y / l1_norm;
+
+    // fold the lower hemisphere over the diagonals
+    if (v.z < 0.0f)
+    {
+        const auto folded_x = (1.0f - ((y < 0.0f) ? -y : y)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+        const auto folded_y = (1.0f - ((x < 0.0f) ? -x : x)) * ((y >= 0.0f) ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    encoded[0] = to_snorm16(x);
+    encoded[1] = to_snorm16(y);
+}
+
+/**
+ * Helper function to pack a vertex.
+ *
+ * @param vertex
+ *   The vertex to pack.
+ *
+ * @return
+ *   The packed vertex.
+ */
+auto pack_vertex(const VertexData &vertex) -> PackedVertexData
+{
+    auto packed = PackedVertexData{
+        .position =
+            {to_snorm16(vertex.position.x), to_snorm16(vertex.position.y), to_snorm16(vertex.position.z), 0},
+        .normal = {},
+        .tangent = {},
+        .uv = {to_half(vertex.uv.x), to_half(vertex.uv.y)}};
+
+    octahedral_encode(vertex.normal, packed.normal);
+    octahedral_encode(vertex.tangent, packed.tangent);
+
+    return packed;
+}
+
+}
+
 Mesh::Mesh(
     const VertexData *vertex_data,
     std::uint32_t vertex_count,
     const std::uint32_t *indices,
-    std::uint32_t index_count)
+    std::uint32_t index_count,
+    VertexFormat format)
+    : Mesh(&vertex_data, &vertex_count, &indices, &index_count, 1u, format)
+{
+}
+
+Mesh::Mesh(
+    const VertexData *const *vertex_data,
+    const std::uint32_t *vertex_counts,
+    const std::uint32_t *const *indices,
+    const std::uint32_t *index_counts,
+    std::uint32_t lod_count,
+    VertexFormat format)
     : vao_{}
-    , vbo_(sizeof(VertexData) * vertex_count + sizeof(std::uint32_t) * index_count)
-    , index_count_{index_count}
-    , index_offset_{sizeof(VertexData) * vertex_count}
+    , vbo_(buffer_size(vertex_counts, index_counts, lod_count, format))
+    , lod_count_{lod_count}
+    , index_type_{
+          (index_size(vertex_counts, lod_count) == sizeof(std::uint16_t)) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT}
+    , index_counts_{}
+    , index_offsets_{}
+    , base_vertices_{}
 {
-    vbo_.write(reinterpret_cast<const std::uint8_t *>(vertex_data), sizeof(VertexData) * vertex_count, 0u);
-    vbo_.write(
-        reinterpret_cast<const std::uint8_t *>(indices),
-        sizeof(std::uint32_t) * index_count,
-        sizeof(VertexData) * vertex_count);
+    ensure(lod_count <= max_mesh_lods, ErrorCode::TOO_MANY_MESH_LODS);
+
+    const auto stride = vertex_size(format);
+
+    // all the vertices go first so every level shares the one vertex binding, indices are packed in after them
+    auto vertex_offset = std::size_t{};
+    auto base_vertex = 0u;
+    for (auto i = 0u; i < lod_count; ++i)
+    {
+        if (format == VertexFormat::PACKED)
+        {
+            auto *packed = static_cast<PackedVertexData *>(malloc(sizeof(PackedVertexData) * vertex_counts[i]));
+            for (auto j = 0u; j < vertex_counts[i]; ++j)
+            {
+                packed[j] = pack_vertex(vertex_data[i][j]);
+            }
+
+            vbo_.write(reinterpret_cast<const std::uint8_t *>(packed), stride * vertex_counts[i], vertex_offset);
+            free(packed);
+        }
+        else
+        {
+            vbo_.write(
+                reinterpret_cast<const std::uint8_t *>(vertex_data[i]), stride * vertex_counts[i], vertex_offset);
+        }
+
+        base_vertices_[i] = static_cast<std::int32_t>(base_vertex);
+        vertex_offset += stride * vertex_counts[i];
+        base_vertex += vertex_counts[i];
+    }
+
+    const auto index_bytes = index_size(vertex_counts, lod_count);
+    auto index_offset = vertex_offset;
+    for (auto i = 0u; i < lod_count; ++i)
+    {
+        if (index_type_ == GL_UNSIGNED_SHORT)
+        {
+            auto *short_indices = static_cast<std::uint16_t *>(malloc(sizeof(std::uint16_t) * index_counts[i]));
+            for (auto j = 0u; j < index_counts[i]; ++j)
+            {
+                short_indices[j] = static_cast<std::uint16_t>(indices[i][j]);
+            }
+
+            vbo_.write(
+                reinterpret_cast<const std::uint8_t *>(short_indices), index_bytes * index_counts[i], index_offset);
+            free(short_indices);
+        }
+        else
+        {
+            vbo_.write(reinterpret_cast<const std::uint8_t *>(indices[i]), index_bytes * index_counts[i], index_offset);
+        }
+
+        index_counts_[i] = index_counts[i];
+        index_offsets_[i] = index_offset;
+        index_offset += index_bytes * index_counts[i];
+    }
 
     ::glCreateVertexArrays(1, &vao_);
-    ::glVertexArrayVertexBuffer(vao_, 0, vbo_.native_handle(), 0, sizeof(VertexData));
+    ::glVertexArrayVertexBuffer(vao_, 0, vbo_.native_handle(), 0, stride);
     ::glVertexArrayElementBuffer(vao_, vbo_.native_handle());
 
     ::glEnableVertexArrayAttrib(vao_, 0);
@@ -30,10 +283,21 @@ Mesh::Mesh(
     ::glEnableVertexArrayAttrib(vao_, 2);
     ::glEnableVertexArrayAttrib(vao_, 3);
 
-    ::glVertexArrayAttribFormat(vao_, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexData, position));
-    ::glVertexArrayAttribFormat(vao_, 1, 3, GL_FLOAT, GL_FALSE, offsetof(VertexData, normal));
-    ::glVertexArrayAttribFormat(vao_, 2, 3, GL_FLOAT, GL_FALSE, offsetof(VertexData, tangent));
-    ::glVertexArrayAttribFormat(vao_, 3, 2, GL_FLOAT, GL_FALSE, offsetof(VertexData, uv));
+    if (format == VertexFormat::PACKED)
+    {
+        // the shader reads the two octahedral components into a vec3 (z is zero) and decodes them itself
+        ::glVertexArrayAttribFormat(vao_, 0, 4, GL_SHORT, GL_TRUE, offsetof(PackedVertexData, position));
+        ::glVertexArrayAttribFormat(vao_, 1, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertexData, normal));
+        ::glVertexArrayAttribFormat(vao_, 2, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertexData, tangent));
+        ::glVertexArrayAttribFormat(vao_, 3, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertexData, uv));
+    }
+    else
+    {
+        ::glVertexArrayAttribFormat(vao_, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexData, position));
+        ::glVertexArrayAttribFormat(vao_, 1, 3, GL_FLOAT, GL_FALSE, offsetof(VertexData, normal));
+        ::glVertexArrayAttribFormat(vao_, 2, 3, GL_FLOAT, GL_FALSE, offsetof(VertexData, tangent));
+        ::glVertexArrayAttribFormat(vao_, 3, 2, GL_FLOAT, GL_FALSE, offsetof(VertexData, uv));
+    }
 
     ::glVertexArrayAttribBinding(vao_, 0, 0);
     ::glVertexArrayAttribBinding(vao_, 1, 0);
@@ -51,12 +315,32 @@ auto Mesh::unbind() const -> void
     ::glBindVertexArray(0);
 }
 
-auto Mesh::index_count() const -> std::uint32_t
+auto Mesh::native_handle() const -> ::GLuint
+{
+    return vao_;
+}
+
+auto Mesh::lod_count() const -> std::uint32_t
+{
+    return lod_count_;
+}
+
+auto Mesh::index_count(std::uint32_t lod) const -> std::uint32_t
+{
+    return index_counts_[lod];
+}
+
+auto Mesh::index_type() const -> ::GLenum
+{
+    return index_type_;
+}
+
+auto Mesh::index_offset(std::uint32_t lod) const -> std::uintptr_t
 {
-    return index_count_;
+    return index_offsets_[lod];
 }
 
-auto Mesh::index_offset() const -> std::uintptr_t
+auto Mesh::base_vertex(std::uint32_t lod) const -> std::int32_t
 {
-    return index_offset_;
+    return base_vertices_[lod];
 }
@@ -6,8 +6,27 @@
 #include "opengl.h"
 #include "vertex_data.h"
 
+/** Maximum number of levels of detail a mesh can have. */
+static constexpr auto max_mesh_lods = 4u;
+
+/**
+ * Layout of the vertices of a mesh on the GPU.
+ */
+enum class VertexFormat
+{
+    /** VertexData as is. */
+    FULL,
+
+    /** PackedVertexData, the shader has to decode the normal and tangent. */
+    PACKED,
+};
+
 /**
  * Class representing a mesh on the GPU.
+ *
+ * A mesh can have several levels of detail, all stored in the one buffer (vertices for every level followed by indices
+ * for every level). Each level's indices are relative to its own vertices, so it has to be drawn with a base vertex.
+ * Indices are stored as 16 bit when every level has few enough vertices.
  */
 class Mesh
 {
@@ -22,13 +41,40 @@ class Mesh
      *   The indices.
      * @param index_count
      *  The number of indices.
+     * @param format
+     *   The layout to store the vertices in.
      */
   public:
     Mesh(
         const VertexData *vertex_data,
         std::uint32_t vertex_count,
         const std::uint32_t *indices,
-        std::uint32_t index_count);
+        std::uint32_t index_count,
+        VertexFormat format);
+
+    /**
+     * Construct a new mesh with several levels of detail, the first being the most detailed.
+     *
+     * @param vertex_data
+     *   The vertex data for each level.
+     * @param vertex_counts
+     *   The number of vertices for each level.
+     * @param indices
+     *   The indices for each level.
+     * @param index_counts
+     *   The number of indices for each level.
+     * @param lod_count
+     *   The number of levels, at most max_mesh_lods.
+     * @param format
+     *   The layout to store the vertices in.
+     */
+    Mesh(
+        const VertexData *const *vertex_data,
+        const std::uint32_t *vertex_counts,
+        const std::uint32_t *const *indices,
+        const std::uint32_t *index_counts,
+        std::uint32_t lod_count,
+        VertexFormat format);
 
     /**
      * Bind the mesh for rendering.
@@ -40,21 +86,62 @@ class Mesh
      */
     auto unbind() const -> void;
 
+    /**
+     * Get the native handle of the mesh i.e. its vertex array object.
+     *
+     * @return
+     *   The native handle of the mesh.
+     */
+    auto native_handle() const -> ::GLuint;
+
+    /**
+     * Get the number of levels of detail.
+     *
+     * @return
+     *   The number of levels of detail.
+     */
+    auto lod_count() const -> std::uint32_t;
+
     /**
      * Get the number of indices.
      *
+     * @param lod
+     *   The level of detail.
+     *
      * @return
      *  The number of indices.
      */
-    auto index_count() const -> std::uint32_t;
+    auto index_count(std::uint32_t lod = 0u) const -> std::uint32_t;
+
+    /**
+     * Get the type of the indices.
+     *
+     * @return
+     *   GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+     */
+    auto index_type() const -> ::GLenum;
 
     /**
      * Get the offset of the indices into the GPU buffer.
      *
+     * @param lod
+     *   The level of detail.
+     *
      * @return
      * The offset of the indices.
      */
-    auto index_offset() const -> std::uintptr_t;
+    auto index_offset(std::uint32_t lod = 0u) const -> std::uintptr_t;
+
+    /**
+     * Get the index of the first vertex, to be added to every index when drawing.
+     *
+     * @param lod
+     *   The level of detail.
+     *
+     * @return
+     *   The base vertex.
+     */
+    auto base_vertex(std::uint32_t lod = 0u) const -> std::int32_t;
 
   private:
     /** The vertex array object. */
@@ -63,9 +150,18 @@ class Mesh
     /** The vertex buffer object. */
     Buffer vbo_;
 
-    /** The number of indices. */
-    std::uint32_t index_count_;
+    /** The number of levels of detail. */
+    std::uint32_t lod_count_;
+
+    /** The type of the indices. */
+    ::GLenum index_type_;
+
+    /** The number of indices of each level. */
+    std::uint32_t index_counts_[max_mesh_lods];
+
+    /** The offset of the indices of each level. */
+    std::uintptr_t index_offsets_[max_mesh_lods];
 
-    /** The offset of the indices. */
-    std::uintptr_t index_offset_;
+    /** The base vertex of each level. */
+    std::int32_t base_vertices_[max_mesh_lods];
 };
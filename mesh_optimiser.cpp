@@ -0,0 +1,484 @@
+#include "mesh_optimiser.h"
+
+#include <cstdint>
+
+#include "clib.h"
+#include "log.h"
+#include "vertex_data.h"
+
+namespace
+{
+
+/** Size of the FIFO cache used to report statistics, a reasonable stand in for current hardware. */
+static constexpr auto g_analysis_cache_size = 16u;
+
+/** Size of the LRU cache the optimiser models, larger than the real one as recommended by Forsyth. */
+static constexpr auto g_optimiser_cache_size = 32u;
+
+/** Score of a vertex used by the last triangle, slightly lower than the next few so strips don't double back. */
+static constexpr auto g_last_triangle_score = 0.75f;
+
+/** Scale of the bonus for vertices with few triangles left, so lone triangles get cleared up rather than stranded. */
+static constexpr auto g_valence_boost_scale = 2.0f;
+
+/** Number of remaining triangles per vertex that have a precomputed valence score, more than this use the last one. */
+static constexpr auto g_max_valence = 32u;
+
+/** Grid attributes are snapped to when welding. */
+static constexpr auto g_weld_scale = 1024.0f;
+
+/** Number of attributes compared when welding. */
+static constexpr auto g_weld_attributes = 11u;
+
+/**
+ * Helper function to snap the attributes of a vertex to the weld grid.
+ *
+ * @param vertex
+ *   The vertex to snap.
+ * @param snapped
+ *   Array to write the snapped attributes to.
+ */
+auto snap_vertex(const VertexData &vertex, std::int32_t *snapped) -> void
+{
+    const float attributes[g_weld_attributes] = {
+        vertex.position.x,
+        vertex.position.y,
+        vertex.position.z,
+        vertex.normal.x,
+        vertex.normal.y,
+        vertex.normal.z,
+        vertex.tangent.x,
+        vertex.tangent.y,
+        vertex.tangent.z,
+        vertex.uv.x,
+        vertex.uv.y};
+
+    for (auto i = 0u; i < g_weld_attributes; ++i)
+    {
+        const auto scaled = attributes[i] * g_weld_scale;
+        snapped[i] = to_int(scaled + ((scaled >= 0.0f) ? 0.5f : -0.5f));
+    }
+}
+
+/**
+ * Helper function to hash snapped attributes (FNV-1a over the words).
+ *
+ * @param snapped
+ *   The snapped attributes.
+ *
+ * @return
+ *   The hash.
+ */
+auto hash_snapped(const std::int32_t *snapped) -> std::uint32_t
+{
+    auto hash = 2166136261u;
+
+    for (auto i = 0u; i < g_weld_attributes; ++i)
+    {
+        hash = (hash ^ static_cast<std::uint32_t>(snapped[i])) * 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * Helper function to score a vertex for the cache optimiser.
+ *
+ * @param cache_position
+ *   Position of the vertex in the cache, -1 if it isn't in it.
+ * @param remaining
+ *   Number of triangles still to be emitted that use the vertex.
+ * @param cache_scores
+ *   Precomputed score for each cache position.
+ * @param valence_scores
+ *   Precomputed score for each number of remaining triangles.
+ *
+ * @return
+ *   Score of the vertex, higher is better.
+ */
+auto vertex_score(
+    std::int32_t cache_position,
+    std::uint32_t remaining,
+    const float *cache_scores,
+    const float *valence_scores) -> float
+{
+    if (remaining == 0u)
+    {
+        // no triangles left, so it doesn't matter
+        return -1.0f;
+    }
+
+    const auto cache_score = (cache_position >= 0) ? cache_scores[cache_position] : 0.0f;
+    return cache_score + valence_scores[(remaining < g_max_valence) ? remaining : g_max_valence - 1u];
+}
+
+}
+
+auto analyse_vertex_cache(const std::uint32_t *indices, std::uint32_t index_count, std::uint32_t vertex_count)
+    -> VertexCacheStats
+{
+    // a vertex is in a FIFO cache if fewer than cache size misses have happened since it was last loaded
+    auto *load_times = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * vertex_count));
+    for (auto i = 0u; i < vertex_count; ++i)
+    {
+        load_times[i] = 0u;
+    }
+
+    // misses start at the cache size so nothing looks like it's already loaded
+    auto misses = g_analysis_cache_size;
+    for (auto i = 0u; i < index_count; ++i)
+    {
+        if ((misses - load_times[indices[i]]) >= g_analysis_cache_size)
+        {
+            load_times[indices[i]] = misses++;
+        }
+    }
+
+    free(load_times);
+
+    const auto transformed = static_cast<float>(misses - g_analysis_cache_size);
+
+    return {
+        .acmr = (index_count == 0u) ? 0.0f : transformed / static_cast<float>(index_count / 3u),
+        .atvr = (vertex_count == 0u) ? 0.0f : transformed / static_cast<float>(vertex_count)};
+}
+
+auto weld_vertices(VertexData *vertices, std::uint32_t *vertex_count, std::uint32_t *indices, std::uint32_t index_count)
+    -> void
+{
+    auto table_size = 1u;
+    while (table_size < (*vertex_count * 2u))
+    {
+        table_size *= 2u;
+    }
+
+    // open addressed table of welded vertex index + 1, zero is empty
+    auto *table = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * table_size));
+    auto *snapped = static_cast<std::int32_t *>(malloc(sizeof(std::int32_t) * g_weld_attributes * *vertex_count));
+    auto *remap = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * *vertex_count));
+
+    for (auto i = 0u; i < table_size; ++i)
+    {
+        table[i] = 0u;
+    }
+
+    auto welded_count = 0u;
+    for (auto i = 0u; i < *vertex_count; ++i)
+    {
+        auto *attributes = snapped + (welded_count * g_weld_attributes);
+        snap_vertex(vertices[i], attributes);
+
+        auto slot = hash_snapped(attributes) & (table_size - 1u);
+        while (table[slot] != 0u)
+        {
+            const auto *existing = snapped + ((table[slot] - 1u) * g_weld_attributes);
+            if (memcmp(existing, attributes, sizeof(std::int32_t) * g_weld_attributes) == 0)
+            {
+                break;
+            }
+
+            slot = (slot + 1u) & (table_size - 1u);
+        }
+
+        if (table[slot] == 0u)
+        {
+            // first time we've seen this vertex, move it down to the end of the welded ones
+            vertices[welded_count] = vertices[i];
+            table[slot] = ++welded_count;
+        }
+
+        remap[i] = table[slot] - 1u;
+    }
+
+    for (auto i = 0u; i < index_count; ++i)
+    {
+        indices[i] = remap[indices[i]];
+    }
+
+    *vertex_count = welded_count;
+
+    free(remap);
+    free(snapped);
+    free(table);
+}
+
+auto optimise_vertex_cache(std::uint32_t *indices, std::uint32_t index_count, std::uint32_t vertex_count) -> void
+{
+    const auto triangle_count = index_count / 3u;
+    if (triangle_count == 0u)
+    {
+        return;
+    }
+
+    // the scores only depend on small integers so work them out up front, pow(x, 1.5) is x * sqrt(x) and the valence
+    // boost is scale * pow(valence, -0.5)
+    float cache_scores[g_optimiser_cache_size];
+    for (auto i = 0u; i < g_optimiser_cache_size; ++i)
+    {
+        if (i < 3u)
+        {
+            cache_scores[i] = g_last_triangle_score;
+        }
+        else
+        {
+            const auto scaler = 1.0f - (static_cast<float>(i - 3u) / static_cast<float>(g_optimiser_cache_size - 3u));
+            cache_scores[i] = scaler * sqrt(scaler);
+        }
+    }
+
+    float valence_scores[g_max_valence];
+    valence_scores[0] = 0.0f;
+    for (auto i = 1u; i < g_max_valence; ++i)
+    {
+        valence_scores[i] = g_valence_boost_scale / sqrt(static_cast<float>(i));
+    }
+
+    // per vertex: triangles left to emit, where its list of triangles starts, cache position and score
+    auto *remaining = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * vertex_count));
+    auto *adjacency_offsets = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * vertex_count));
+    auto *cache_positions = static_cast<std::int32_t *>(malloc(sizeof(std::int32_t) * vertex_count));
+    auto *scores = static_cast<float *>(malloc(sizeof(float) * vertex_count));
+
+    // per triangle: score and whether it has been emitted
+    auto *triangle_scores = static_cast<float *>(malloc(sizeof(float) * triangle_count));
+    auto *emitted = static_cast<bool *>(malloc(sizeof(bool) * triangle_count));
+
+    auto *adjacency = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * index_count));
+    auto *output = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * index_count));
+
+    for (auto i = 0u; i < vertex_count; ++i)
+    {
+        remaining[i] = 0u;
+        cache_positions[i] = -1;
+    }
+
+    for (auto i = 0u; i < index_count; ++i)
+    {
+        ++remaining[indices[i]];
+    }
+
+    auto offset = 0u;
+    for (auto i = 0u; i < vertex_count; ++i)
+    {
+        adjacency_offsets[i] = offset;
+        offset += remaining[i];
+        scores[i] = vertex_score(-1, remaining[i], cache_scores, valence_scores);
+    }
+
+    // fill the adjacency lists, using remaining as a cursor and restoring it as we go
+    for (auto i = 0u; i < vertex_count; ++i)
+    {
+        remaining[i] = 0u;
+    }
+
+    for (auto i = 0u; i < index_count; ++i)
+    {
+        const auto vertex = indices[i];
+        adjacency[adjacency_offsets[vertex] + remaining[vertex]++] = i / 3u;
+    }
+
+    for (auto i = 0u; i < triangle_count; ++i)
+    {
+        emitted[i] = false;
+        triangle_scores[i] = scores[indices[(i * 3u) + 0u]] + scores[indices[(i * 3u) + 1u]] +
+                             scores[indices[(i * 3u) + 2u]];
+    }
+
+    // three extra entries for the triangle being added before the cache is trimmed
+    std::uint32_t cache[g_optimiser_cache_size + 3u];
+    auto cache_count = 0u;
+
+    auto best_triangle = -1;
+    auto output_count = 0u;
+
+    for (auto emitted_count = 0u; emitted_count < triangle_count; ++emitted_count)
+    {
+        // nothing in the cache is any use, so fall back to the best triangle anywhere
+        if (best_triangle == -1)
+        {
+            auto best_score = -1e9f;
+            for (auto i = 0u; i < triangle_count; ++i)
+            {
+                if (!emitted[i] && (triangle_scores[i] > best_score))
+                {
+                    best_score = triangle_scores[i];
+                    best_triangle = static_cast<std::int32_t>(i);
+                }
+            }
+        }
+
+        const auto triangle = static_cast<std::uint32_t>(best_triangle);
+        emitted[triangle] = true;
+
+        // emit the triangle and take it out of its vertices' lists
+        for (auto i = 0u; i < 3u; ++i)
+        {
+            const auto vertex = indices[(triangle * 3u) + i];
+            output[output_count++] = vertex;
+
+            auto *triangles = adjacency + adjacency_offsets[vertex];
+            for (auto j = 0u; j < remaining[vertex]; ++j)
+            {
+                if (triangles[j] == triangle)
+                {
+                    triangles[j] = triangles[remaining[vertex] - 1u];
+                    break;
+                }
+            }
+
+            --remaining[vertex];
+        }
+
+        // the triangle's vertices go to the front of the cache, everything else shuffles down
+        std::uint32_t new_cache[g_optimiser_cache_size + 3u];
+        auto new_cache_count = 0u;
+        for (auto i = 0u; i < 3u; ++i)
+        {
+            new_cache[new_cache_count++] = indices[(triangle * 3u) + i];
+        }
+
+        for (auto i = 0u; i < cache_count; ++i)
+        {
+            const auto vertex = cache[i];
+            if ((vertex != new_cache[0]) && (vertex != new_cache[1]) && (vertex != new_cache[2]))
+            {
+                new_cache[new_cache_count++] = vertex;
+            }
+        }
+
+        // rescore everything that was in the cache, including anything that just fell out of it
+        for (auto i = 0u; i < new_cache_count; ++i)
+        {
+            const auto vertex = new_cache[i];
+            cache_positions[vertex] = (i < g_optimiser_cache_size) ? static_cast<std::int32_t>(i) : -1;
+            scores[vertex] = vertex_score(cache_positions[vertex], remaining[vertex], cache_scores, valence_scores);
+        }
+
+        // rescore the triangles that use those vertices, picking the best one for next time
+        auto best_score = -1e9f;
+        best_triangle = -1;
+        for (auto i = 0u; i < new_cache_count; ++i)
+        {
+            const auto vertex = new_cache[i];
+            const auto *triangles = adjacency + adjacency_offsets[vertex];
+
+            for (auto j = 0u; j < remaining[vertex]; ++j)
+            {
+                const auto candidate = triangles[j];
+                const auto score = scores[indices[(candidate * 3u) + 0u]] + scores[indices[(candidate * 3u) + 1u]] +
+                                   scores[indices[(candidate * 3u) + 2u]];
+                triangle_scores[candidate] = score;
+
+                if ((i < g_optimiser_cache_size) && (score > best_score))
+                {
+                    best_score = score;
+                    best_triangle = static_cast<std::int32_t>(candidate);
+                }
+            }
+        }
+
+        cache_count = (new_cache_count < g_optimiser_cache_size) ? new_cache_count : g_optimiser_cache_size;
+        for (auto i = 0u; i < cache_count; ++i)
+        {
+            cache[i] = new_cache[i];
+        }
+    }
+
+    memcpy(indices, output, sizeof(std::uint32_t) * index_count);
+
+    free(output);
+    free(adjacency);
+    free(emitted);
+    free(triangle_scores);
+    free(scores);
+    free(cache_positions);
+    free(adjacency_offsets);
+    free(remaining);
+}
+
+auto optimise_vertex_fetch(
+    VertexData *vertices,
+    std::uint32_t *vertex_count,
+    std::uint32_t *indices,
+    std::uint32_t index_count) -> void
+{
+    // new index of each vertex, assigned in order of first use
+    auto *remap = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * *vertex_count));
+    auto *reordered = static_cast<VertexData *>(malloc(sizeof(VertexData) * *vertex_count));
+
+    for (auto i = 0u; i < *vertex_count; ++i)
+    {
+        remap[i] = 0xffffffffu;
+    }
+
+    auto next = 0u;
+    for (auto i = 0u; i < index_count; ++i)
+    {
+        const auto vertex = indices[i];
+        if (remap[vertex] == 0xffffffffu)
+        {
+            remap[vertex] = next;
+            reordered[next] = vertices[vertex];
+            ++next;
+        }
+
+        indices[i] = remap[vertex];
+    }
+
+    memcpy(vertices, reordered, sizeof(VertexData) * next);
+    *vertex_count = next;
+
+    free(reordered);
+    free(remap);
+}
+
+auto optimise_mesh(
+    const char *name,
+    VertexData *vertices,
+    std::uint32_t *vertex_count,
+    std::uint32_t *indices,
+    std::uint32_t index_count) -> void
+{
+    const auto original_vertex_count = *vertex_count;
+    const auto before = analyse_vertex_cache(indices, index_count, *vertex_count);
+
+    weld_vertices(vertices, vertex_count, indices, index_count);
+
+    // tiny meshes can fit in the cache whatever the order, in which case the optimiser can only make things worse
+    auto *original_indices = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * index_count));
+    memcpy(original_indices, indices, sizeof(std::uint32_t) * index_count);
+
+    const auto welded = analyse_vertex_cache(indices, index_count, *vertex_count);
+    optimise_vertex_cache(indices, index_count, *vertex_count);
+
+    if (analyse_vertex_cache(indices, index_count, *vertex_count).acmr > welded.acmr)
+    {
+        memcpy(indices, original_indices, sizeof(std::uint32_t) * index_count);
+    }
+
+    free(original_indices);
+
+    optimise_vertex_fetch(vertices, vertex_count, indices, index_count);
+
+    const auto after = analyse_vertex_cache(indices, index_count, *vertex_count);
+
+    // no floats in wsprintf, so log to three decimal places as fixed point
+    const auto acmr_before = to_int(before.acmr * 1000.0f);
+    const auto atvr_before = to_int(before.atvr * 1000.0f);
+    const auto acmr_after = to_int(after.acmr * 1000.0f);
+    const auto atvr_after = to_int(after.atvr * 1000.0f);
+
+    log_format(
+        "%s: %u -> %u vertices, acmr %d.%03d -> %d.%03d, atvr %d.%03d -> %d.%03d",
+        name,
+        original_vertex_count,
+        *vertex_count,
+        acmr_before / 1000,
+        acmr_before % 1000,
+        acmr_after / 1000,
+        acmr_after % 1000,
+        atvr_before / 1000,
+        atvr_before % 1000,
+        atvr_after / 1000,
+        atvr_after % 1000);
+}
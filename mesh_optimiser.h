@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+
+#include "vertex_data.h"
+
+/**
+ * Results of running an index buffer through a simulated post-transform vertex cache.
+ */
+struct VertexCacheStats
+{
+    /** Average cache miss ratio, vertices transformed per triangle (0.5 is ideal for a large grid, 3 is the worst). */
+    float acmr;
+
+    /** Average transform to vertex ratio, vertices transformed per unique vertex (1 is ideal). */
+    float atvr;
+};
+
+/**
+ * Simulate a FIFO post-transform vertex cache over a triangle list.
+ *
+ * @param indices
+ *   The triangle list.
+ * @param index_count
+ *   Number of indices.
+ * @param vertex_count
+ *   Number of vertices the indices refer to.
+ *
+ * @return
+ *   Cache statistics for the index order.
+ */
+auto analyse_vertex_cache(const std::uint32_t *indices, std::uint32_t index_count, std::uint32_t vertex_count)
+    -> VertexCacheStats;
+
+/**
+ * Merge vertices that are the same to within a small tolerance, e.g. the duplicated ring where a seam closes.
+ *
+ * @param vertices
+ *   The vertices, compacted in place.
+ * @param vertex_count
+ *   Number of vertices, updated to the number left after welding.
+ * @param indices
+ *   The triangle list, remapped in place.
+ * @param index_count
+ *   Number of indices.
+ */
+auto weld_vertices(VertexData *vertices, std::uint32_t *vertex_count, std::uint32_t *indices, std::uint32_t index_count)
+    -> void;
+
+/**
+ * Reorder triangles so that vertices are reused while they're still in the post-transform cache.
+ *
+ * This is Tom Forsyth's linear speed vertex cache optimisation: every vertex is scored by its position in a simulated
+ * LRU cache and by how many triangles still use it, and the next triangle is always the best scoring one touching the
+ * cache.
+ *
+ * @param indices
+ *   The triangle list, reordered in place.
+ * @param index_count
+ *   Number of indices.
+ * @param vertex_count
+ *   Number of vertices the indices refer to.
+ */
+auto optimise_vertex_cache(std::uint32_t *indices, std::uint32_t index_count, std::uint32_t vertex_count) -> void;
+
+/**
+ * Reorder vertices into the order the triangles first use them, so fetches walk through memory linearly. Vertices no
+ * triangle uses are dropped.
+ *
+ * @param vertices
+ *   The vertices, reordered in place.
+ * @param vertex_count
+ *   Number of vertices, updated if any were unused.
+ * @param indices
+ *   The triangle list, remapped in place.
+ * @param index_count
+ *   Number of indices.
+ */
+auto optimise_vertex_fetch(
+    VertexData *vertices,
+    std::uint32_t *vertex_count,
+    std::uint32_t *indices,
+    std::uint32_t index_count) -> void;
+
+/**
+ * Run a generated mesh through every stage (weld, cache, fetch) and log the cache statistics before and after. The new
+ * triangle order is only kept if it beats the original.
+ *
+ * @param name
+ *   Name of the mesh for the log.
+ * @param vertices
+ *   The vertices, modified in place.
+ * @param vertex_count
+ *   Number of vertices, updated.
+ * @param indices
+ *   The triangle list, modified in place.
+ * @param index_count
+ *   Number of indices.
+ */
+auto optimise_mesh(
+    const char *name,
+    VertexData *vertices,
+    std::uint32_t *vertex_count,
+    std::uint32_t *indices,
+    std::uint32_t index_count) -> void;
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "matrix4.h"
+#include "vector3.h"
+
+// packed struct to mirror the std430 layout of the ModelData struct in the shaders
+
+#pragma warning(push)
+#pragma warning(disable : 4324)
+struct ModelData
+{
+    Matrix4 model;
+    alignas(16) Vector3 checker_colour1;
+    alignas(16) Vector3 checker_colour2;
+    alignas(16) Vector3 wood_colour1;
+    alignas(16) Vector3 wood_colour2;
+    alignas(16) Vector3 wood_colour3;
+    float wood_scale;
+    alignas(16) Vector3 metal_colour;
+    alignas(16) Vector3 water_colour1;
+    alignas(16) Vector3 water_colour2;
+    float normal_scale;
+};
+
+// everything in ModelData apart from the transform, what an entity stores as its material, see entity_store.h
+
+struct MaterialParams
+{
+    alignas(16) Vector3 checker_colour1;
+    alignas(16) Vector3 checker_colour2;
+    alignas(16) Vector3 wood_colour1;
+    alignas(16) Vector3 wood_colour2;
+    alignas(16) Vector3 wood_colour3;
+    float wood_scale;
+    alignas(16) Vector3 metal_colour;
+    alignas(16) Vector3 water_colour1;
+    alignas(16) Vector3 water_colour2;
+    float normal_scale;
+};
+#pragma warning(pop)
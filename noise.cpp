@@ -0,0 +1,568 @@
+#include "noise.h"
+
+#include <cstdint>
+
+#include <Windows.h>
+
+#include "clib.h"
+#include "float8.h"
+#include "log.h"
+#include "timer.h"
+
+namespace
+{
+
+/** Size in pixels of the tiles the image is split into, width must be a multiple of 8. */
+static constexpr auto g_tile_width = 64u;
+static constexpr auto g_tile_height = 16u;
+
+/** Parameters the shader passes to tile_weave. */
+static constexpr auto g_weave_scale = 8.0f;
+static constexpr auto g_weave_count = 3.0f;
+static constexpr auto g_weave_width = 0.75f;
+static constexpr auto g_weave_smoothness = 1.0f;
+
+/** Largest difference from the scalar reference the benchmark accepts for the hash based patterns. */
+static constexpr auto g_noise_tolerance = 1.0f / 64.0f;
+
+/** Largest difference from the scalar reference the benchmark accepts for the tile weave distance field. */
+static constexpr auto g_weave_tolerance = 0.0001f;
+
+/**
+ * Shared state for all the threads generating an image.
+ */
+struct NoiseJob
+{
+    NoisePattern pattern;
+    NoiseImage *image;
+    float scale;
+    std::uint32_t tiles_x;
+    std::uint32_t tile_count;
+
+    /** Index of the next tile to be claimed, threads bump this until it runs off the end. */
+    volatile ::LONG next_tile;
+};
+
+/**
+ * Helper function to get the offset of each lane, i.e. {0, 1, ..., 7}.
+ */
+auto lane_offsets() -> Float8
+{
+    return {::_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), ::_mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f)};
+}
+
+/**
+ * Helper function to get the number of channels a pattern writes.
+ *
+ * @param pattern
+ *   The pattern.
+ *
+ * @return
+ *   Channel count.
+ */
+auto channel_count(NoisePattern pattern) -> std::uint32_t
+{
+    return pattern == NoisePattern::TILE_WEAVE ? 3u : 1u;
+}
+
+/**
+ * Port of the GLSL sdf_lens.
+ */
+auto sdf_lens8(const Float8 &x, const Float8 &y, float width, float height) -> Float8
+{
+    const auto d = height / width - width / 4.0f;
+    const auto r = width / 2.0f + d;
+    const auto b = sqrt(r * r - d * d);
+
+    const auto px = abs8(x);
+    const auto py = abs8(y);
+
+    // par = p.xyxy - vec4(0.0, b, -d, 0.0)
+    const auto par_x = px;
+    const auto par_y = py - float8(b);
+    const auto par_z = px + float8(d);
+    const auto par_w = py;
+
+    const auto inner = sqrt8(par_x * par_x + par_y * par_y);
+    const auto outer = sqrt8(par_z * par_z + par_w * par_w) - float8(r);
+
+    return select8(greater8(par_y * float8(d), px * float8(b)), inner, outer);
+}
+
+/**
+ * Helper function to evaluate the distance field part of tile_weave.
+ */
+auto weave_distance8(const Float8 &x, const Float8 &y, float scale, float count, float width) -> Float8
+{
+    const auto sx = x * float8(scale);
+    const auto sy = y * float8(scale);
+
+    // alternate the strand direction in a checkerboard
+    const auto sum = floor8(sx) + floor8(sy);
+    const auto c = sum - float8(2.0f) * floor8(sum * float8(0.5f));
+
+    const auto fx = fract8(sx);
+    const auto fy = fract8(sy);
+
+    auto px = mix8(fx, fy, c);
+    auto py = mix8(fy, fx, c);
+
+    px = fract8(px * float8(count));
+    py = fract8(py);
+
+    px = px * float8(2.0f) - float8(1.0f);
+    py = py * float8(2.0f) - float8(1.0f);
+
+    return sdf_lens8(px, py, width * 2.0f, 1.0f);
+}
+
+/**
+ * Helper function to fill one tile of an image.
+ *
+ * @param job
+ *   The job the tile belongs to.
+ * @param tile
+ *   Index of the tile.
+ */
+auto generate_tile(NoiseJob *job, std::uint32_t tile) -> void
+{
+    auto *image = job->image;
+    const auto channels = image->channel_count;
+
+    const auto start_x = (tile % job->tiles_x) * g_tile_width;
+    const auto start_y = (tile / job->tiles_x) * g_tile_height;
+    const auto end_x = start_x + g_tile_width < image->width ? start_x + g_tile_width : image->width;
+    const auto end_y = start_y + g_tile_height < image->height ? start_y + g_tile_height : image->height;
+
+    const auto step_x = job->scale / static_cast<float>(image->width);
+    const auto step_y = job->scale / static_cast<float>(image->height);
+
+    float results[3u][8u];
+
+    for (auto py = start_y; py < end_y; ++py)
+    {
+        const auto y = float8((static_cast<float>(py) + 0.5f) * step_y);
+
+        for (auto px = start_x; px < end_x; px += 8u)
+        {
+            const auto x = (float8(static_cast<float>(px) + 0.5f) + lane_offsets()) * float8(step_x);
+
+            switch (job->pattern)
+            {
+                using enum NoisePattern;
+                case RANDOM: store8(results[0], random8(x, y)); break;
+                case NOISE: store8(results[0], noise8(x, y)); break;
+                case FBM: store8(results[0], fbm8(x, y)); break;
+                case TILE_WEAVE:
+                {
+                    auto strength = Float8{};
+                    auto gradient_x = Float8{};
+                    auto gradient_y = Float8{};
+                    tile_weave8(
+                        x,
+                        y,
+                        g_weave_scale,
+                        g_weave_count,
+                        g_weave_width,
+                        g_weave_smoothness,
+                        step_x,
+                        step_y,
+                        &strength,
+                        &gradient_x,
+                        &gradient_y);
+
+                    store8(results[0], strength);
+                    store8(results[1], gradient_x);
+                    store8(results[2], gradient_y);
+                    break;
+                }
+            }
+
+            // interleave the channels into the image, clipping the last batch of a row
+            const auto lanes = end_x - px < 8u ? end_x - px : 8u;
+            auto *dst = image->pixels + ((py * image->width) + px) * channels;
+
+            for (auto lane = 0u; lane < lanes; ++lane)
+            {
+                for (auto channel = 0u; channel < channels; ++channel)
+                {
+                    *dst++ = results[channel][lane];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Thread entry point, keep claiming tiles until there are none left.
+ */
+auto WINAPI noise_worker(::LPVOID param) -> ::DWORD
+{
+    auto *job = static_cast<NoiseJob *>(param);
+
+    for (;;)
+    {
+        const auto tile = static_cast<std::uint32_t>(::InterlockedIncrement(&job->next_tile) - 1);
+        if (tile >= job->tile_count)
+        {
+            break;
+        }
+
+        generate_tile(job, tile);
+    }
+
+    return 0;
+}
+
+/**
+ * Reference sine in double precision, used to check the SIMD version.
+ */
+auto reference_sin(double x) -> double
+{
+    static constexpr auto two_pi = 6.283185307179586476925;
+
+    const auto k = ::_mm_cvtsd_si32(::_mm_set_sd(x / two_pi));
+    const auto r = x - (static_cast<double>(k) * two_pi);
+    const auto r2 = r * r;
+
+    // plenty of terms for [-pi, pi]
+    auto term = r;
+    auto sum = r;
+    for (auto i = 1; i < 12; ++i)
+    {
+        term *= -r2 / static_cast<double>((2 * i) * (2 * i + 1));
+        sum += term;
+    }
+
+    return sum;
+}
+
+/**
+ * Reference square root, correctly rounded unlike the clib version.
+ */
+auto reference_sqrt(float x) -> float
+{
+    return ::_mm_cvtss_f32(::_mm_sqrt_ss(::_mm_set_ss(x)));
+}
+
+/**
+ * Scalar transliterations of the GLSL, float maths but with an exact sin. The hash ones set near_wrap if any hash came
+ * within the tolerance of wrapping, where the SIMD version may have landed at the other end of the range.
+ */
+auto reference_random(float x, float y, bool *near_wrap) -> float
+{
+    const auto dot = (x * 12.9898f) + (y * 78.233f);
+    const auto value = fract(static_cast<float>(reference_sin(dot)) * 43758.5453123f);
+
+    *near_wrap = *near_wrap || (value < g_noise_tolerance) || (value > 1.0f - g_noise_tolerance);
+    return value;
+}
+
+auto reference_noise(float x, float y, bool *near_wrap) -> float
+{
+    const auto ix = floor(x);
+    const auto iy = floor(y);
+    const auto fx = x - ix;
+    const auto fy = y - iy;
+
+    const auto a = reference_random(ix, iy, near_wrap);
+    const auto b = reference_random(ix + 1.0f, iy, near_wrap);
+    const auto c = reference_random(ix, iy + 1.0f, near_wrap);
+    const auto d = reference_random(ix + 1.0f, iy + 1.0f, near_wrap);
+
+    const auto ux = fx * fx * (3.0f - 2.0f * fx);
+    const auto uy = fy * fy * (3.0f - 2.0f * fy);
+
+    return (a + (b - a) * ux) + (c - a) * uy * (1.0f - ux) + (d - b) * ux * uy;
+}
+
+auto reference_fbm(float x, float y, bool *near_wrap) -> float
+{
+    auto value = 0.0f;
+    auto amplitude = 0.5f;
+
+    for (auto i = 0; i < 6; ++i)
+    {
+        value += amplitude * reference_noise(x, y, near_wrap);
+        x *= 2.0f;
+        y *= 2.0f;
+        amplitude *= 0.5f;
+    }
+
+    return value;
+}
+
+auto reference_weave_distance(float x, float y) -> float
+{
+    const auto sx = x * g_weave_scale;
+    const auto sy = y * g_weave_scale;
+
+    // mod(i.x + i.y, 2.0)
+    const auto sum = floor(sx) + floor(sy);
+    const auto c = sum - 2.0f * floor(sum / 2.0f);
+
+    const auto fx = fract(sx);
+    const auto fy = fract(sy);
+
+    auto px = fract((fx + (fy - fx) * c) * g_weave_count) * 2.0f - 1.0f;
+    auto py = fract(fy + (fx - fy) * c) * 2.0f - 1.0f;
+
+    // sdf_lens(p, width * 2.0, 1.0)
+    const auto width = g_weave_width * 2.0f;
+    const auto d = 1.0f / width - width / 4.0f;
+    const auto r = width / 2.0f + d;
+    const auto b = reference_sqrt(r * r - d * d);
+
+    px = px < 0.0f ? -px : px;
+    py = py < 0.0f ? -py : py;
+
+    return ((py - b) * d > px * b) ? reference_sqrt(px * px + (py - b) * (py - b))
+                                    : reference_sqrt((px + d) * (px + d) + py * py) - r;
+}
+
+/**
+ * Helper function to log a float with a fixed number of decimal places (wsprintf can't do floats).
+ */
+auto log_fixed(const char *label, const char *pattern_name, float value, const char *units) -> void
+{
+    const auto scaled = to_int(value * 100000.0f);
+    log_format("%s %s: %d.%05d %s", label, pattern_name, scaled / 100000, scaled % 100000, units);
+}
+
+}
+
+auto random8(const Float8 &x, const Float8 &y) -> Float8
+{
+    const auto dot = x * float8(12.9898f) + y * float8(78.233f);
+    return fract8(sin8(dot) * float8(43758.5453123f));
+}
+
+auto noise8(const Float8 &x, const Float8 &y) -> Float8
+{
+    const auto ix = floor8(x);
+    const auto iy = floor8(y);
+    const auto fx = x - ix;
+    const auto fy = y - iy;
+
+    const auto one = float8(1.0f);
+
+    const auto a = random8(ix, iy);
+    const auto b = random8(ix + one, iy);
+    const auto c = random8(ix, iy + one);
+    const auto d = random8(ix + one, iy + one);
+
+    const auto ux = fx * fx * (float8(3.0f) - float8(2.0f) * fx);
+    const auto uy = fy * fy * (float8(3.0f) - float8(2.0f) * fy);
+
+    return mix8(a, b, ux) + (c - a) * uy * (one - ux) + (d - b) * ux * uy;
+}
+
+auto fbm8(const Float8 &x, const Float8 &y) -> Float8
+{
+    auto value = float8(0.0f);
+    auto amplitude = 0.5f;
+    auto sx = x;
+    auto sy = y;
+
+    for (auto i = 0; i < 6; ++i)
+    {
+        value = value + float8(amplitude) * noise8(sx, sy);
+        sx = sx * float8(2.0f);
+        sy = sy * float8(2.0f);
+        amplitude *= 0.5f;
+    }
+
+    return value;
+}
+
+auto tile_weave8(
+    const Float8 &x,
+    const Float8 &y,
+    float scale,
+    float count,
+    float width,
+    float smoothness,
+    float pixel_width,
+    float pixel_height,
+    Float8 *strength,
+    Float8 *gradient_x,
+    Float8 *gradient_y) -> void
+{
+    const auto d = weave_distance8(x, y, scale, count, width);
+
+    // stand in for dFdx/dFdy
+    const auto gx = weave_distance8(x + float8(pixel_width), y, scale, count, width) - d;
+    const auto gy = weave_distance8(x, y + float8(pixel_height), scale, count, width) - d;
+
+    const auto s =
+        float8(1.0f) - smoothstep8(float8(0.0f), abs8(gx) + abs8(gy) + float8(smoothness), float8(0.0f) - d);
+
+    // normalize(grad) is undefined for a zero gradient, we just call that flat
+    const auto length = sqrt8(gx * gx + gy * gy);
+    const auto has_length = greater8(length, float8(0.0f));
+    const auto edge = smoothstep8(float8(1.0f), float8(0.99f), s) * smoothstep8(float8(0.0f), float8(0.01f), s);
+
+    *strength = s;
+    *gradient_x = select8(has_length, gx / length * edge, float8(0.0f));
+    *gradient_y = select8(has_length, gy / length * edge, float8(0.0f));
+}
+
+auto generate_noise_image(
+    NoisePattern pattern,
+    std::uint32_t width,
+    std::uint32_t height,
+    float scale,
+    std::uint32_t thread_count) -> NoiseImage
+{
+    auto image = NoiseImage{
+        .pixels = nullptr, .width = width, .height = height, .channel_count = channel_count(pattern)};
+    image.pixels = static_cast<float *>(malloc(sizeof(float) * width * height * image.channel_count));
+
+    const auto tiles_x = (width + g_tile_width - 1u) / g_tile_width;
+    const auto tiles_y = (height + g_tile_height - 1u) / g_tile_height;
+
+    auto job = NoiseJob{
+        .pattern = pattern,
+        .image = &image,
+        .scale = scale,
+        .tiles_x = tiles_x,
+        .tile_count = tiles_x * tiles_y,
+        .next_tile = 0};
+
+    if (thread_count == 0u)
+    {
+        auto info = ::SYSTEM_INFO{};
+        ::GetSystemInfo(&info);
+        thread_count = info.dwNumberOfProcessors;
+    }
+
+    if (thread_count > MAXIMUM_WAIT_OBJECTS)
+    {
+        thread_count = MAXIMUM_WAIT_OBJECTS;
+    }
+
+    // the calling thread does its share too
+    ::HANDLE threads[MAXIMUM_WAIT_OBJECTS];
+    for (auto i = 0u; i < thread_count - 1u; ++i)
+    {
+        threads[i] = ::CreateThread(nullptr, 0, noise_worker, &job, 0, nullptr);
+    }
+
+    noise_worker(&job);
+
+    if (thread_count > 1u)
+    {
+        ::WaitForMultipleObjects(thread_count - 1u, threads, TRUE, INFINITE);
+
+        for (auto i = 0u; i < thread_count - 1u; ++i)
+        {
+            ::CloseHandle(threads[i]);
+        }
+    }
+
+    return image;
+}
+
+auto benchmark_noise() -> void
+{
+    static constexpr auto size = 1024u;
+    static constexpr auto scale = 15.0f;
+
+    const char *names[] = {"random", "noise", "fbm", "tile_weave"};
+    const NoisePattern patterns[] = {
+        NoisePattern::RANDOM, NoisePattern::NOISE, NoisePattern::FBM, NoisePattern::TILE_WEAVE};
+
+    for (auto i = 0u; i < sizeof(patterns) / sizeof(NoisePattern); ++i)
+    {
+        auto timer = Timer{};
+        const auto single = generate_noise_image(patterns[i], size, size, scale, 1u);
+        const auto single_seconds = timer.elapsed_seconds();
+
+        timer.reset();
+        const auto threaded = generate_noise_image(patterns[i], size, size, scale);
+        const auto threaded_seconds = timer.elapsed_seconds();
+        free(threaded.pixels);
+
+        const auto samples = static_cast<float>(size * size) / 1000000.0f;
+        log_fixed("noise 1 thread", names[i], samples / single_seconds, "Msamples/s");
+        log_fixed("noise all threads", names[i], samples / threaded_seconds, "Msamples/s");
+
+        // the weave's gradient is a finite difference rather than dFdx/dFdy so there's nothing exact to compare it
+        // with, but the distance field it comes from is checked directly
+        auto max_error = 0.0f;
+        auto checked = 0u;
+        auto mismatches = 0u;
+        for (auto y = 0u; y < size; y += 7u)
+        {
+            for (auto x = 0u; x < size; x += 7u)
+            {
+                const auto u = (static_cast<float>(x) + 0.5f) * (scale / static_cast<float>(size));
+                const auto v = (static_cast<float>(y) + 0.5f) * (scale / static_cast<float>(size));
+
+                auto actual = 0.0f;
+                auto expected = 0.0f;
+                auto near_wrap = false;
+                switch (patterns[i])
+                {
+                    using enum NoisePattern;
+                    case RANDOM:
+                    {
+                        actual = single.pixels[(y * size) + x];
+                        expected = reference_random(u, v, &near_wrap);
+                        break;
+                    }
+                    case NOISE:
+                    {
+                        actual = single.pixels[(y * size) + x];
+                        expected = reference_noise(u, v, &near_wrap);
+                        break;
+                    }
+                    case FBM:
+                    {
+                        actual = single.pixels[(y * size) + x];
+                        expected = reference_fbm(u, v, &near_wrap);
+                        break;
+                    }
+                    case TILE_WEAVE:
+                    {
+                        float lanes[8];
+                        const auto distance =
+                            weave_distance8(float8(u), float8(v), g_weave_scale, g_weave_count, g_weave_width);
+                        store8(lanes, distance);
+                        actual = lanes[0];
+                        expected = reference_weave_distance(u, v);
+                        break;
+                    }
+                }
+
+                auto error = actual - expected;
+                error = error < 0.0f ? -error : error;
+
+                // a hash close to a whole number can legitimately wrap to the other end of the range, for random that
+                // is just the error measured the other way round, but noise and fbm blend the hashes so there's no
+                // right answer to compare with
+                if (patterns[i] == NoisePattern::RANDOM)
+                {
+                    error = error > 0.5f ? 1.0f - error : error;
+                }
+                else if (near_wrap)
+                {
+                    continue;
+                }
+
+                const auto tolerance =
+                    (patterns[i] == NoisePattern::TILE_WEAVE) ? g_weave_tolerance : g_noise_tolerance;
+                mismatches += (error > tolerance) ? 1u : 0u;
+                max_error = error > max_error ? error : max_error;
+                ++checked;
+            }
+        }
+
+        log_fixed("noise max error", names[i], max_error, "");
+        if (mismatches != 0u)
+        {
+            log_format("noise %s: %u of %u samples disagree with the reference", names[i], mismatches, checked);
+        }
+        free(single.pixels);
+    }
+}
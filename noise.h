@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+
+#include "float8.h"
+
+/**
+ * CPU ports of the procedural functions in the uber shader. Each call evaluates eight samples at once, the results
+ * match the GLSL to within the precision of the GPU sin (the hashes multiply sin by a large constant, so don't expect
+ * them to be bit exact, no two GPUs agree either).
+ */
+
+/**
+ * Port of the GLSL random(vec2).
+ *
+ * @param x
+ *   X coordinates of the samples.
+ * @param y
+ *   Y coordinates of the samples.
+ *
+ * @return
+ *   Pseudo random values in [0, 1).
+ */
+auto random8(const Float8 &x, const Float8 &y) -> Float8;
+
+/**
+ * Port of the GLSL noise(vec2), smoothed value noise.
+ *
+ * @param x
+ *   X coordinates of the samples.
+ * @param y
+ *   Y coordinates of the samples.
+ *
+ * @return
+ *   Noise values.
+ */
+auto noise8(const Float8 &x, const Float8 &y) -> Float8;
+
+/**
+ * Port of the GLSL fbm(vec2), six octaves of noise.
+ *
+ * @param x
+ *   X coordinates of the samples.
+ * @param y
+ *   Y coordinates of the samples.
+ *
+ * @return
+ *   Fractal noise values.
+ */
+auto fbm8(const Float8 &x, const Float8 &y) -> Float8;
+
+/**
+ * Port of the GLSL tile_weave.
+ *
+ * The shader uses dFdx/dFdy for the gradient, on the CPU we don't have a quad to difference against so we evaluate the
+ * distance field again one pixel over in each direction.
+ *
+ * @param x
+ *   X coordinates of the samples.
+ * @param y
+ *   Y coordinates of the samples.
+ * @param scale
+ *   Number of tiles per unit.
+ * @param count
+ *   Number of strands per tile.
+ * @param width
+ *   Width of each strand.
+ * @param smoothness
+ *   Extra edge softness.
+ * @param pixel_width
+ *   Distance between horizontally neighbouring samples, used for the x gradient.
+ * @param pixel_height
+ *   Distance between vertically neighbouring samples, used for the y gradient.
+ * @param strength
+ *   Out value for the weave mask (x component of the GLSL result).
+ * @param gradient_x
+ *   Out value for the x gradient (y component of the GLSL result).
+ * @param gradient_y
+ *   Out value for the y gradient (z component of the GLSL result).
+ */
+auto tile_weave8(
+    const Float8 &x,
+    const Float8 &y,
+    float scale,
+    float count,
+    float width,
+    float smoothness,
+    float pixel_width,
+    float pixel_height,
+    Float8 *strength,
+    Float8 *gradient_x,
+    Float8 *gradient_y) -> void;
+
+/**
+ * Enumeration of the patterns the image generator can produce.
+ */
+enum class NoisePattern
+{
+    RANDOM,
+    NOISE,
+    FBM,
+    TILE_WEAVE
+};
+
+/**
+ * A generated image, pixels are tightly packed rows of channel_count floats.
+ *
+ * Note that for simplicity pixels is never freed.
+ */
+struct NoiseImage
+{
+    float *pixels;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t channel_count;
+};
+
+/**
+ * Generate an image of a pattern, the work is split into tiles and shared out across threads.
+ *
+ * Pixel (x, y) is sampled at ((x + 0.5) / width, (y + 0.5) / height) * scale, i.e. the same as the shader sampling at
+ * vUv * scale.
+ *
+ * @param pattern
+ *   The pattern to generate.
+ * @param width
+ *   Width of the image in pixels.
+ * @param height
+ *   Height of the image in pixels.
+ * @param scale
+ *   Scale applied to the uv coordinates.
+ * @param thread_count
+ *   Number of threads to use, 0 means one per core.
+ *
+ * @return
+ *   The generated image.
+ */
+auto generate_noise_image(
+    NoisePattern pattern,
+    std::uint32_t width,
+    std::uint32_t height,
+    float scale,
+    std::uint32_t thread_count = 0u) -> NoiseImage;
+
+/**
+ * Benchmark the generator and log the throughput of each pattern in Msamples/s, along with the largest difference from
+ * a scalar double precision transliteration of the GLSL.
+ */
+auto benchmark_noise() -> void;
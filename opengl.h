@@ -10,6 +10,8 @@
     DO(::PFNGLDELETESHADERPROC, glDeleteShader)                                                                        \
     DO(::PFNGLSHADERSOURCEPROC, glShaderSource)                                                                        \
     DO(::PFNGLCOMPILESHADERPROC, glCompileShader)                                                                      \
+    DO(::PFNGLSHADERBINARYPROC, glShaderBinary)                                                                        \
+    DO(::PFNGLSPECIALIZESHADERPROC, glSpecializeShader)                                                                \
     DO(::PFNGLGETSHADERIVPROC, glGetShaderiv)                                                                          \
     DO(::PFNGLGETPROGRAMIVPROC, glGetProgramiv)                                                                        \
     DO(::PFNGLCREATEPROGRAMPROC, glCreateProgram)                                                                      \
@@ -51,14 +53,38 @@
     DO(::PFNGLBINDSAMPLERPROC, glBindSampler)                                                                          \
     DO(::PFNGLGETSHADERINFOLOGPROC, glGetShaderInfoLog)                                                                \
     DO(::PFNGLGETPROGRAMINFOLOGPROC, glGetProgramInfoLog)                                                              \
-    DO(::PFNGLGETACTIVEUNIFORMPROC, glGetActiveUniform)                                                                \
+    DO(::PFNGLGETPROGRAMBINARYPROC, glGetProgramBinary)                                                                \
+    DO(::PFNGLPROGRAMBINARYPROC, glProgramBinary)                                                                      \
+    DO(::PFNGLPROGRAMPARAMETERIPROC, glProgramParameteri)                                                              \
+    DO(::PFNGLPROGRAMUNIFORM1FPROC, glProgramUniform1f)                                                                \
+    DO(::PFNGLPROGRAMUNIFORM1IPROC, glProgramUniform1i)                                                                \
+    DO(::PFNGLPROGRAMUNIFORMMATRIX4FVPROC, glProgramUniformMatrix4fv)                                                  \
+    DO(::PFNGLGETPROGRAMRESOURCEINDEXPROC, glGetProgramResourceIndex)                                                  \
+    DO(::PFNGLGETPROGRAMRESOURCEIVPROC, glGetProgramResourceiv)                                                        \
+    DO(::PFNGLGETPROGRAMRESOURCENAMEPROC, glGetProgramResourceName)                                                    \
     DO(::PFNGLCREATEFRAMEBUFFERSPROC, glCreateFramebuffers)                                                            \
     DO(::PFNGLDELETEFRAMEBUFFERSPROC, glDeleteFramebuffers)                                                            \
     DO(::PFNGLBINDFRAMEBUFFERPROC, glBindFramebuffer)                                                                  \
     DO(::PFNGLNAMEDFRAMEBUFFERTEXTUREPROC, glNamedFramebufferTexture)                                                  \
     DO(::PFNGLBLITNAMEDFRAMEBUFFERPROC, glBlitNamedFramebuffer)                                                        \
+    DO(::PFNGLCHECKNAMEDFRAMEBUFFERSTATUSPROC, glCheckNamedFramebufferStatus)                                          \
+    DO(::PFNGLCREATEQUERIESPROC, glCreateQueries)                                                                      \
+    DO(::PFNGLBEGINQUERYPROC, glBeginQuery)                                                                            \
+    DO(::PFNGLENDQUERYPROC, glEndQuery)                                                                                \
+    DO(::PFNGLGETQUERYOBJECTUIVPROC, glGetQueryObjectuiv)                                                              \
+    DO(::PFNGLGETQUERYOBJECTUI64VPROC, glGetQueryObjectui64v)                                                          \
+    DO(::PFNGLQUERYCOUNTERPROC, glQueryCounter)                                                                        \
+    DO(::PFNGLPUSHDEBUGGROUPPROC, glPushDebugGroup)                                                                    \
+    DO(::PFNGLPOPDEBUGGROUPPROC, glPopDebugGroup)                                                                      \
+    DO(::PFNGLFENCESYNCPROC, glFenceSync)                                                                              \
+    DO(::PFNGLCLIENTWAITSYNCPROC, glClientWaitSync)                                                                    \
+    DO(::PFNGLDELETESYNCPROC, glDeleteSync)                                                                            \
     DO(::PFNGLDRAWELEMENTSINSTANCEDPROC, glDrawElementsInstanced)                                                      \
     DO(::PFNGLDRAWELEMENTSINSTANCEDBASEINSTANCEPROC, glDrawElementsInstancedBaseInstance)                              \
+    DO(::PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC, glDrawElementsInstancedBaseVertexBaseInstance)          \
+    DO(::PFNGLDRAWELEMENTSINDIRECTPROC, glDrawElementsIndirect)                                                        \
+    DO(::PFNGLDISPATCHCOMPUTEPROC, glDispatchCompute)                                                                  \
+    DO(::PFNGLMEMORYBARRIERPROC, glMemoryBarrier)                                                                      \
     DO(::PFNGLMAPNAMEDBUFFERPROC, glMapNamedBuffer)                                                                    \
     DO(::PFNGLUNMAPNAMEDBUFFERPROC, glUnmapNamedBuffer)                                                                \
     DO(::PFNGLDRAWARRAYSEXTPROC, glDrawArraysEXT)
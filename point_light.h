@@ -0,0 +1,15 @@
+#pragma once
+
+#include "vector3.h"
+
+// packed struct to mirror the std430 layout of the PointLight struct in the shaders
+
+#pragma warning(push)
+#pragma warning(disable : 4324)
+struct PointLightBuffer
+{
+    alignas(16) Vector3 position;
+    alignas(16) Vector3 colour;
+    alignas(16) Vector3 attenuation;
+};
+#pragma warning(pop)
@@ -0,0 +1,208 @@
+#include "program_cache.h"
+
+#include <cstdint>
+
+#include <Windows.h>
+
+#include "clib.h"
+#include "log.h"
+#include "opengl.h"
+
+namespace
+{
+
+/** Magic number at the start of every cache file, bump if the format changes. */
+static constexpr auto g_cache_magic = std::uint32_t{0x314b5450u};
+
+/** Largest binary we'll believe a cache file holds, real ones are a few hundred kilobytes at most. */
+static constexpr auto g_max_binary_length = 64u * 1024u * 1024u;
+
+/**
+ * Header written before the program binary.
+ */
+struct ProgramCacheHeader
+{
+    std::uint32_t magic;
+    std::uint32_t key_high;
+    std::uint32_t key_low;
+    ::GLenum format;
+    std::uint32_t length;
+};
+
+/**
+ * Helper function to mix a string into a key. The two halves are FNV-1a style hashes with different seeds and primes,
+ * which is plenty to tell a handful of shaders apart (and avoids the CRT 64-bit multiply helper).
+ *
+ * @param str
+ *   The string to hash, may be null.
+ * @param key
+ *   The key to update.
+ */
+auto hash_string(const char *str, ProgramCacheKey *key) -> void
+{
+    if (str != nullptr)
+    {
+        for (const auto *cursor = str; *cursor != '\0'; ++cursor)
+        {
+            const auto c = static_cast<std::uint8_t>(*cursor);
+            key->high = (key->high ^ c) * 16777619u;
+            key->low = (key->low ^ c) * 0x5bd1e995u;
+        }
+    }
+
+    // separator so "ab" + "c" and "a" + "bc" hash differently
+    key->high = (key->high ^ 0xffu) * 16777619u;
+    key->low = (key->low ^ 0xffu) * 0x5bd1e995u;
+}
+
+/**
+ * Helper function to build the path of the cache file for a key.
+ *
+ * @param key
+ *   The key.
+ * @param path
+ *   Buffer to write the path to.
+ */
+auto cache_path(const ProgramCacheKey &key, char *path) -> void
+{
+    ::wsprintfA(path, "program_cache_%08x%08x.bin", key.high, key.low);
+}
+
+}
+
+ProgramCache::ProgramCache()
+    : enabled_{::GetEnvironmentVariableA("TEKTITE_NO_PROGRAM_CACHE", nullptr, 0) == 0}
+    , driver_key_{.high = 2166136261u, .low = 0x9747b28cu}
+    , hits_{}
+    , misses_{}
+{
+    hash_string(reinterpret_cast<const char *>(::glGetString(GL_VENDOR)), &driver_key_);
+    hash_string(reinterpret_cast<const char *>(::glGetString(GL_RENDERER)), &driver_key_);
+    hash_string(reinterpret_cast<const char *>(::glGetString(GL_VERSION)), &driver_key_);
+
+    if (!enabled_)
+    {
+        log("program cache disabled");
+    }
+}
+
+auto ProgramCache::key(const char *vertex_source, const char *fragment_source, const char *defines) const
+    -> ProgramCacheKey
+{
+    auto key = driver_key_;
+
+    hash_string(vertex_source, &key);
+    hash_string(fragment_source, &key);
+    hash_string(defines, &key);
+
+    return key;
+}
+
+auto ProgramCache::load(const ProgramCacheKey &key, ::GLuint program) -> bool
+{
+    if (!enabled_)
+    {
+        ++misses_;
+        return false;
+    }
+
+    char path[MAX_PATH];
+    cache_path(key, path);
+
+    const auto file =
+        ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        ++misses_;
+        return false;
+    }
+
+    auto header = ProgramCacheHeader{};
+    auto read = ::DWORD{};
+    auto linked = ::GLint{};
+
+    // a truncated or corrupt file is just a miss, so check the length fits before trusting it with an allocation
+    auto size_high = ::DWORD{};
+    const auto size = ::GetFileSize(file, &size_high);
+
+    if (::ReadFile(file, &header, sizeof(header), &read, nullptr) && (read == sizeof(header)) &&
+        (header.magic == g_cache_magic) && (header.key_high == key.high) && (header.key_low == key.low) &&
+        (size != INVALID_FILE_SIZE) && (size_high == 0u) && (header.length <= g_max_binary_length) &&
+        (header.length == size - sizeof(header)))
+    {
+        auto *binary = malloc(header.length);
+
+        if (::ReadFile(file, binary, header.length, &read, nullptr) && (read == header.length))
+        {
+            // the driver can still refuse the binary (e.g. after an update), the link status tells us if it did
+            ::glProgramBinary(program, header.format, binary, header.length);
+            ::glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        }
+
+        free(binary);
+    }
+
+    ::CloseHandle(file);
+
+    if (linked != GL_TRUE)
+    {
+        log_format("program cache rejected %s", path);
+        ++misses_;
+        return false;
+    }
+
+    ++hits_;
+    return true;
+}
+
+auto ProgramCache::store(const ProgramCacheKey &key, ::GLuint program) const -> void
+{
+    if (!enabled_)
+    {
+        return;
+    }
+
+    auto length = ::GLint{};
+    ::glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+    {
+        return;
+    }
+
+    auto *binary = malloc(length);
+    auto header = ProgramCacheHeader{.magic = g_cache_magic, .key_high = key.high, .key_low = key.low};
+    auto written_length = ::GLsizei{};
+
+    ::glGetProgramBinary(program, length, &written_length, &header.format, binary);
+    header.length = static_cast<std::uint32_t>(written_length);
+
+    char path[MAX_PATH];
+    cache_path(key, path);
+
+    // failing to write the cache isn't fatal, we'll just compile again next time
+    const auto file = ::CreateFileA(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        auto written = ::DWORD{};
+        ::WriteFile(file, &header, sizeof(header), &written, nullptr);
+        ::WriteFile(file, binary, header.length, &written, nullptr);
+        ::CloseHandle(file);
+    }
+
+    free(binary);
+}
+
+auto ProgramCache::enabled() const -> bool
+{
+    return enabled_;
+}
+
+auto ProgramCache::hits() const -> std::uint32_t
+{
+    return hits_;
+}
+
+auto ProgramCache::misses() const -> std::uint32_t
+{
+    return misses_;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+
+#include "opengl.h"
+
+/**
+ * Key identifying a cached program, a hash of the shader sources and the driver that compiled them.
+ */
+struct ProgramCacheKey
+{
+    std::uint32_t high;
+    std::uint32_t low;
+};
+
+/**
+ * Class for caching linked program binaries on disk, so that later runs can skip compiling and linking.
+ *
+ * Binaries are only valid for the driver that produced them, so the vendor, renderer and version strings are part of
+ * the key. Even then a driver is free to reject a binary, callers must be prepared to fall back to compiling.
+ *
+ * Note that a GL context must be current before constructing the cache.
+ */
+class ProgramCache
+{
+  public:
+    /**
+     * Construct a new program cache.
+     *
+     * The cache can be disabled by setting the TEKTITE_NO_PROGRAM_CACHE environment variable, which is handy for
+     * comparing startup times.
+     */
+    ProgramCache();
+
+    /**
+     * Create a key for a set of sources.
+     *
+     * @param vertex_source
+     *   The vertex shader source.
+     * @param fragment_source
+     *   The fragment shader source.
+     * @param defines
+     *   Any source injected into both shaders.
+     *
+     * @return
+     *   Key for the sources with the current driver.
+     */
+    auto key(const char *vertex_source, const char *fragment_source, const char *defines) const -> ProgramCacheKey;
+
+    /**
+     * Try and load a cached binary into a program.
+     *
+     * @param key
+     *   Key of the program to load.
+     * @param program
+     *   Program object to load the binary in to.
+     *
+     * @return
+     *   True if the program was loaded and linked successfully, false if it needs compiling.
+     */
+    auto load(const ProgramCacheKey &key, ::GLuint program) -> bool;
+
+    /**
+     * Save the binary of a linked program, it must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+     *
+     * @param key
+     *   Key to store the program under.
+     * @param program
+     *   Linked program to save.
+     */
+    auto store(const ProgramCacheKey &key, ::GLuint program) const -> void;
+
+    /**
+     * Check if the cache is enabled.
+     *
+     * @return
+     *   True if the cache is enabled.
+     */
+    auto enabled() const -> bool;
+
+    /**
+     * Get the number of successful loads.
+     *
+     * @return
+     *   Number of cache hits.
+     */
+    auto hits() const -> std::uint32_t;
+
+    /**
+     * Get the number of loads that failed, either because there was nothing cached or the driver rejected it.
+     *
+     * @return
+     *   Number of cache misses.
+     */
+    auto misses() const -> std::uint32_t;
+
+  private:
+    /** Flag indicating if the cache is enabled. */
+    bool enabled_;
+
+    /** Hash of the driver strings, used to seed every key. */
+    ProgramCacheKey driver_key_;
+
+    /** Number of cache hits. */
+    std::uint32_t hits_;
+
+    /** Number of cache misses. */
+    std::uint32_t misses_;
+};
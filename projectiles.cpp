@@ -0,0 +1,229 @@
+#include "projectiles.h"
+
+#include <cstdint>
+
+#include "clib.h"
+#include "float8.h"
+#include "matrix4.h"
+#include "model_data.h"
+#include "point_light.h"
+#include "vector3.h"
+
+namespace
+{
+
+/** Number of float arrays, position, previous position and velocity. */
+static constexpr auto g_array_count = 9u;
+
+/** Smallest number of projectiles the arrays grow to. */
+static constexpr auto g_min_capacity = 64u;
+
+/** Uniform scale of a projectile's sphere. */
+static constexpr auto g_projectile_scale = 0.1f;
+
+/**
+ * Helper function to write the lanes of a block whose bit is set in a mask to consecutive elements.
+ *
+ * @param dst
+ *   Where to write the first kept lane.
+ * @param lanes
+ *   The lanes, already stored out of registers.
+ * @param keep
+ *   Bit mask of the lanes to keep.
+ *
+ * @return
+ *   Number of lanes kept.
+ */
+auto compact(float *dst, const float *lanes, int keep) -> std::uint32_t
+{
+    // always write and conditionally advance, so there's no branch to mispredict, the writes can only land on
+    // elements already read
+    auto cursor = 0;
+    for (auto lane = 0; lane < 8; ++lane)
+    {
+        dst[cursor] = lanes[lane];
+        cursor += (keep >> lane) & 1;
+    }
+
+    return static_cast<std::uint32_t>(cursor);
+}
+
+}
+
+Projectiles::Projectiles(std::uint32_t capacity)
+    : capacity_{}
+    , count_{}
+    , x_{}
+    , y_{}
+    , z_{}
+    , previous_x_{}
+    , previous_y_{}
+    , previous_z_{}
+    , velocity_x_{}
+    , velocity_y_{}
+    , velocity_z_{}
+{
+    grow((capacity < g_min_capacity) ? g_min_capacity : capacity);
+}
+
+auto Projectiles::spawn(const Vector3 &position, const Vector3 &velocity) -> void
+{
+    if (count_ == capacity_)
+    {
+        grow(capacity_ * 2u);
+    }
+
+    x_[count_] = position.x;
+    y_[count_] = position.y;
+    z_[count_] = position.z;
+    previous_x_[count_] = position.x;
+    previous_y_[count_] = position.y;
+    previous_z_[count_] = position.z;
+    velocity_x_[count_] = velocity.x;
+    velocity_y_[count_] = velocity.y;
+    velocity_z_[count_] = velocity.z;
+    ++count_;
+}
+
+auto Projectiles::step(const Vector3 &centre, float range) -> void
+{
+    const auto centre_x = float8(centre.x);
+    const auto centre_y = float8(centre.y);
+    const auto centre_z = float8(centre.z);
+    const auto range_squared = float8(range * range);
+
+    auto kept = 0u;
+
+    for (auto base = 0u; base < count_; base += 8u)
+    {
+        const auto x = load8(x_ + base);
+        const auto y = load8(y_ + base);
+        const auto z = load8(z_ + base);
+        const auto velocity_x = load8(velocity_x_ + base);
+        const auto velocity_y = load8(velocity_y_ + base);
+        const auto velocity_z = load8(velocity_z_ + base);
+
+        // squared distance saves a square root per projectile
+        const auto dx = x - centre_x;
+        const auto dy = y - centre_y;
+        const auto dz = z - centre_z;
+        auto keep = ~movemask8(less8(range_squared, (dx * dx) + (dy * dy) + (dz * dz))) & 0xff;
+
+        // lanes past the end are padding
+        const auto remaining = count_ - base;
+        if (remaining < 8u)
+        {
+            keep &= (1 << remaining) - 1;
+        }
+
+        float lanes[g_array_count][8];
+        store8(lanes[0], x + velocity_x);
+        store8(lanes[1], y + velocity_y);
+        store8(lanes[2], z + velocity_z);
+        store8(lanes[3], x);
+        store8(lanes[4], y);
+        store8(lanes[5], z);
+        store8(lanes[6], velocity_x);
+        store8(lanes[7], velocity_y);
+        store8(lanes[8], velocity_z);
+
+        const auto block_kept = compact(x_ + kept, lanes[0], keep);
+        compact(y_ + kept, lanes[1], keep);
+        compact(z_ + kept, lanes[2], keep);
+        compact(previous_x_ + kept, lanes[3], keep);
+        compact(previous_y_ + kept, lanes[4], keep);
+        compact(previous_z_ + kept, lanes[5], keep);
+        compact(velocity_x_ + kept, lanes[6], keep);
+        compact(velocity_y_ + kept, lanes[7], keep);
+        compact(velocity_z_ + kept, lanes[8], keep);
+
+        kept += block_kept;
+    }
+
+    count_ = kept;
+}
+
+auto Projectiles::emit(
+    float alpha,
+    std::uint32_t begin,
+    std::uint32_t end,
+    ModelData *models,
+    PointLightBuffer *lights,
+    std::uint32_t light_count) const -> void
+{
+    const auto t = float8(alpha);
+
+    for (auto base = begin; base < end; base += 8u)
+    {
+        float lanes[3][8];
+        store8(lanes[0], mix8(load8(previous_x_ + base), load8(x_ + base), t));
+        store8(lanes[1], mix8(load8(previous_y_ + base), load8(y_ + base), t));
+        store8(lanes[2], mix8(load8(previous_z_ + base), load8(z_ + base), t));
+
+        const auto lane_count = ((end - base) < 8u) ? (end - base) : 8u;
+        for (auto lane = 0u; lane < lane_count; ++lane)
+        {
+            const auto position = Vector3{lanes[0][lane], lanes[1][lane], lanes[2][lane]};
+            const auto index = base + lane;
+
+            models[index].model = Matrix4{position, {g_projectile_scale, g_projectile_scale, g_projectile_scale}};
+            models[index].checker_colour1 = {1.0f, 0.0f, 0.0f};
+            models[index].checker_colour2 = {1.0f, 0.0f, 0.0f};
+
+            if (index < light_count)
+            {
+                lights[index] = {position, {1.0f, 0.0f, 0.0f}, {1.0f, 0.01f, 0.032f}};
+            }
+        }
+    }
+}
+
+auto Projectiles::position(std::uint32_t index) const -> Vector3
+{
+    return {x_[index], y_[index], z_[index]};
+}
+
+auto Projectiles::count() const -> std::uint32_t
+{
+    return count_;
+}
+
+auto Projectiles::capacity() const -> std::uint32_t
+{
+    return capacity_;
+}
+
+auto Projectiles::grow(std::uint32_t capacity) -> void
+{
+    // pad to a whole block so the last one can be loaded in one go
+    const auto stride = (capacity + 7u) & ~7u;
+    auto *block = static_cast<float *>(malloc(sizeof(float) * stride * g_array_count));
+    auto *old_block = x_;
+
+    // the padding lanes are loaded and computed with, so keep them well behaved
+    for (auto i = 0u; i < stride * g_array_count; ++i)
+    {
+        block[i] = 0.0f;
+    }
+
+    float **arrays[] = {
+        &x_, &y_, &z_, &previous_x_, &previous_y_, &previous_z_, &velocity_x_, &velocity_y_, &velocity_z_};
+    for (auto i = 0u; i < g_array_count; ++i)
+    {
+        auto *array = block + (stride * i);
+
+        if (*arrays[i] != nullptr)
+        {
+            memcpy(array, *arrays[i], sizeof(float) * count_);
+        }
+
+        *arrays[i] = array;
+    }
+
+    if (old_block != nullptr)
+    {
+        free(old_block);
+    }
+
+    capacity_ = capacity;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+
+#include "model_data.h"
+#include "point_light.h"
+#include "vector3.h"
+
+/**
+ * Class storing every projectile as separate arrays of floats, so they can be processed eight at a time.
+ *
+ * Each step integrates every projectile, culls the ones out of range and compacts the survivors in a single 8 wide
+ * pass. Every array is padded to a multiple of eight, so the last block can be loaded whole and the lanes past the end
+ * are masked off rather than handled by a scalar tail.
+ *
+ * Note that for simplicity no cleanup is performed.
+ */
+class Projectiles
+{
+  public:
+    /**
+     * Construct a new, empty, projectile system.
+     *
+     * @param capacity
+     *   Number of projectiles to make room for up front, more can be added as the arrays grow.
+     */
+    Projectiles(std::uint32_t capacity);
+
+    /**
+     * Add a projectile, growing the arrays if they're full.
+     *
+     * @param position
+     *   Starting position.
+     * @param velocity
+     *   Distance moved each step.
+     */
+    auto spawn(const Vector3 &position, const Vector3 &velocity) -> void;
+
+    /**
+     * Step every projectile. Any more than range away from the centre are removed first, the rest move by their
+     * velocity. Survivors keep their order.
+     *
+     * @param centre
+     *   Point range is measured from.
+     * @param range
+     *   Furthest a projectile can be from the centre.
+     */
+    auto step(const Vector3 &centre, float range) -> void;
+
+    /**
+     * Write the instance transform and light of some projectiles, interpolated between the last two steps.
+     *
+     * @param alpha
+     *   How far between the previous and current step to place them.
+     * @param begin
+     *   First projectile to write, must be a multiple of eight.
+     * @param end
+     *   One past the last projectile to write.
+     * @param models
+     *   Instance data to write, indexed the same as the projectiles.
+     * @param lights
+     *   Lights to write, indexed the same as the projectiles.
+     * @param light_count
+     *   Number of projectiles that get a light, any after only write their instance.
+     */
+    auto emit(
+        float alpha,
+        std::uint32_t begin,
+        std::uint32_t end,
+        ModelData *models,
+        PointLightBuffer *lights,
+        std::uint32_t light_count) const -> void;
+
+    /**
+     * Get the position of a projectile.
+     *
+     * @param index
+     *   Index of the projectile.
+     *
+     * @return
+     *   Position after the last step.
+     */
+    auto position(std::uint32_t index) const -> Vector3;
+
+    /**
+     * Get the number of projectiles.
+     *
+     * @return
+     *   Number of projectiles alive.
+     */
+    auto count() const -> std::uint32_t;
+
+    /**
+     * Get the number of projectiles there's room for before the arrays next grow.
+     *
+     * @return
+     *   Current capacity.
+     */
+    auto capacity() const -> std::uint32_t;
+
+  private:
+    /**
+     * Move every array to a bigger block.
+     *
+     * @param capacity
+     *   New number of projectiles to have room for.
+     */
+    auto grow(std::uint32_t capacity) -> void;
+
+    /** Number of projectiles there's room for. */
+    std::uint32_t capacity_;
+
+    /** Number of projectiles alive. */
+    std::uint32_t count_;
+
+    /** Position components, also the start of the block every array is allocated in. */
+    float *x_;
+    float *y_;
+    float *z_;
+
+    /** Position components before the last step. */
+    float *previous_x_;
+    float *previous_y_;
+    float *previous_z_;
+
+    /** Velocity components. */
+    float *velocity_x_;
+    float *velocity_y_;
+    float *velocity_z_;
+};
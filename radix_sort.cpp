@@ -0,0 +1,81 @@
+#include "radix_sort.h"
+
+#include <cstdint>
+
+namespace
+{
+
+/** Number of bytes in a key, and so the most passes a sort can need. */
+static constexpr auto g_key_bytes = sizeof(std::uint64_t);
+
+/**
+ * Helper function to get a byte of a key, keys are little endian so byte zero is the least significant.
+ *
+ * @param item
+ *   The item to get the key byte of.
+ * @param byte
+ *   Index of the byte.
+ *
+ * @return
+ *   The key byte.
+ */
+auto key_byte(const RadixSortItem &item, std::uint32_t byte) -> std::uint8_t
+{
+    return reinterpret_cast<const std::uint8_t *>(&item.key)[byte];
+}
+
+}
+
+auto radix_sort(RadixSortItem *items, RadixSortItem *scratch, std::uint32_t count) -> RadixSortItem *
+{
+    std::uint32_t histograms[g_key_bytes][256];
+    for (auto byte = 0u; byte < g_key_bytes; ++byte)
+    {
+        for (auto bucket = 0u; bucket < 256u; ++bucket)
+        {
+            histograms[byte][bucket] = 0u;
+        }
+    }
+
+    for (auto i = 0u; i < count; ++i)
+    {
+        for (auto byte = 0u; byte < g_key_bytes; ++byte)
+        {
+            ++histograms[byte][key_byte(items[i], byte)];
+        }
+    }
+
+    auto *source = items;
+    auto *destination = scratch;
+
+    for (auto byte = 0u; byte < g_key_bytes; ++byte)
+    {
+        auto *histogram = histograms[byte];
+
+        // if every key lands in the same bucket this pass wouldn't move anything
+        if ((count == 0u) || (histogram[key_byte(source[0], byte)] == count))
+        {
+            continue;
+        }
+
+        // turn the counts into the offset of each bucket
+        auto offset = 0u;
+        for (auto bucket = 0u; bucket < 256u; ++bucket)
+        {
+            const auto bucket_count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucket_count;
+        }
+
+        for (auto i = 0u; i < count; ++i)
+        {
+            destination[histogram[key_byte(source[i], byte)]++] = source[i];
+        }
+
+        auto *tmp = source;
+        source = destination;
+        destination = tmp;
+    }
+
+    return source;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * An item to sort, a key and whatever the caller wants to carry along with it (typically an index).
+ */
+struct RadixSortItem
+{
+    std::uint64_t key;
+    std::uint32_t value;
+};
+
+/**
+ * Sort items by key, smallest first.
+ *
+ * This is a least significant digit radix sort a byte at a time, so it's stable and linear in the number of items. The
+ * histograms for every byte are built in one pass up front, and any byte that is the same for every key is skipped,
+ * which makes keys that only use a few of their bits cheap to sort. Keys are read a byte at a time rather than shifted,
+ * which keeps 64 bit shifts (and so the CRT helpers for them) out of 32 bit builds.
+ *
+ * @param items
+ *   The items to sort.
+ * @param scratch
+ *   Buffer with space for as many items as are being sorted.
+ * @param count
+ *   Number of items.
+ *
+ * @return
+ *   Pointer to the sorted items, this will be one of items or scratch depending on how many passes were needed.
+ */
+auto radix_sort(RadixSortItem *items, RadixSortItem *scratch, std::uint32_t count) -> RadixSortItem *;
@@ -0,0 +1,198 @@
+#include "render_queue.h"
+
+#include <cstdint>
+
+#include "clib.h"
+#include "cpu_profiler.h"
+#include "error.h"
+#include "gpu_profiler.h"
+#include "material.h"
+#include "mesh.h"
+#include "opengl.h"
+#include "radix_sort.h"
+
+auto make_sort_key(RenderPass pass, std::uint32_t program, std::uint32_t mesh, std::uint32_t depth) -> std::uint64_t
+{
+    const auto high = (static_cast<std::uint32_t>(pass) << 28u) | ((program & 0xfffu) << 16u) | (mesh & 0xffffu);
+    const auto low = (pass == RenderPass::BLENDED) ? ~depth : depth;
+
+    // written as two little endian halves, shifting a 64 bit value would need a CRT helper in a 32 bit build
+    auto key = std::uint64_t{};
+    auto *words = reinterpret_cast<std::uint32_t *>(&key);
+    words[0] = low;
+    words[1] = high;
+
+    return key;
+}
+
+RenderQueue::RenderQueue(std::uint32_t capacity)
+    : capacity_{capacity}
+    , count_{}
+    , packets_{static_cast<RenderPacket *>(malloc(sizeof(RenderPacket) * capacity))}
+    , keys_{static_cast<RadixSortItem *>(malloc(sizeof(RadixSortItem) * capacity))}
+    , scratch_{static_cast<RadixSortItem *>(malloc(sizeof(RadixSortItem) * capacity))}
+    , program_{}
+    , vertex_array_{}
+    , label_{}
+    , uniform_buffers_{}
+    , storage_buffers_{}
+    , current_stats_{}
+    , stats_{}
+{
+}
+
+auto RenderQueue::submit(std::uint64_t key, const RenderPacket &packet) -> void
+{
+    ensure(count_ < capacity_, ErrorCode::RENDER_QUEUE_FULL);
+
+    packets_[count_] = packet;
+    keys_[count_] = {.key = key, .value = count_};
+    ++count_;
+}
+
+auto RenderQueue::bind_buffer(::GLenum target, ::GLuint index, ::GLuint buffer) -> void
+{
+    auto *bindings = (target == GL_UNIFORM_BUFFER) ? uniform_buffers_ : storage_buffers_;
+
+    if ((index < tracked_bindings) && (bindings[index] == buffer))
+    {
+        ++current_stats_.redundant_binds;
+        return;
+    }
+
+    ::glBindBufferBase(target, index, buffer);
+    ++current_stats_.binds;
+
+    if (index < tracked_bindings)
+    {
+        bindings[index] = buffer;
+    }
+}
+
+auto RenderQueue::dispatch(const Material &material, std::uint32_t group_count) -> void
+{
+    if (const auto program = material.native_handle(); program != program_)
+    {
+        material.use();
+        program_ = program;
+        ++current_stats_.state_changes;
+    }
+    else
+    {
+        ++current_stats_.redundant_state_changes;
+    }
+
+    ::glDispatchCompute(group_count, 1u, 1u);
+}
+
+auto RenderQueue::flush(GpuProfiler *profiler) -> void
+{
+    CPU_PROFILE_SCOPE("render queue flush");
+
+    current_stats_.packets = count_;
+
+    const auto *sorted = radix_sort(keys_, scratch_, count_);
+
+    // merge runs of packets that draw the same thing over consecutive instances, then draw what's left
+    auto pending = RenderPacket{};
+    auto has_pending = false;
+
+    for (auto i = 0u; i < count_; ++i)
+    {
+        const auto &packet = packets_[sorted[i].value];
+
+        if (has_pending && (packet.indirect_buffer == 0u) && (pending.indirect_buffer == 0u) &&
+            (packet.material == pending.material) && (packet.mesh == pending.mesh) && (packet.lod == pending.lod) &&
+            (packet.base_instance == pending.base_instance + pending.instance_count))
+        {
+            pending.instance_count += packet.instance_count;
+            continue;
+        }
+
+        if (has_pending)
+        {
+            draw(pending, profiler);
+        }
+
+        pending = packet;
+        has_pending = true;
+    }
+
+    if (has_pending)
+    {
+        draw(pending, profiler);
+    }
+
+    if (label_ != nullptr)
+    {
+        profiler->end_scope();
+        label_ = nullptr;
+    }
+
+    count_ = 0u;
+    stats_ = current_stats_;
+    current_stats_ = {};
+}
+
+auto RenderQueue::stats() const -> const RenderQueueStats &
+{
+    return stats_;
+}
+
+auto RenderQueue::draw(const RenderPacket &packet, GpuProfiler *profiler) -> void
+{
+    if ((profiler != nullptr) && (packet.label != label_))
+    {
+        if (label_ != nullptr)
+        {
+            profiler->end_scope();
+        }
+
+        if (packet.label != nullptr)
+        {
+            profiler->begin_scope(packet.label);
+        }
+
+        label_ = packet.label;
+    }
+
+    if (const auto program = packet.material->native_handle(); program != program_)
+    {
+        packet.material->use();
+        program_ = program;
+        ++current_stats_.state_changes;
+    }
+    else
+    {
+        ++current_stats_.redundant_state_changes;
+    }
+
+    if (const auto vertex_array = packet.mesh->native_handle(); vertex_array != vertex_array_)
+    {
+        packet.mesh->bind();
+        vertex_array_ = vertex_array;
+        ++current_stats_.binds;
+    }
+    else
+    {
+        ++current_stats_.redundant_binds;
+    }
+
+    if (packet.indirect_buffer != 0u)
+    {
+        ::glBindBuffer(GL_DRAW_INDIRECT_BUFFER, packet.indirect_buffer);
+        ::glDrawElementsIndirect(GL_TRIANGLES, packet.mesh->index_type(), nullptr);
+    }
+    else
+    {
+        ::glDrawElementsInstancedBaseVertexBaseInstance(
+            GL_TRIANGLES,
+            packet.mesh->index_count(packet.lod),
+            packet.mesh->index_type(),
+            reinterpret_cast<void *>(packet.mesh->index_offset(packet.lod)),
+            packet.instance_count,
+            packet.mesh->base_vertex(packet.lod),
+            packet.base_instance);
+    }
+    ++current_stats_.draws;
+}
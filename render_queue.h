@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstdint>
+
+#include "gpu_profiler.h"
+#include "material.h"
+#include "mesh.h"
+#include "opengl.h"
+#include "radix_sort.h"
+
+/**
+ * Passes a frame is drawn in, the most significant part of a sort key so passes are always drawn in this order.
+ */
+enum class RenderPass : std::uint32_t
+{
+    SOLID = 0,
+    BLENDED = 1,
+};
+
+/**
+ * Build the sort key for a packet.
+ *
+ * From most to least significant the key is the pass (4 bits), program (12 bits), mesh (16 bits) and depth (32 bits),
+ * so packets are grouped by the most expensive state first. Solid packets draw front to back to make the most of early
+ * depth testing, blended ones back to front so they blend correctly.
+ *
+ * @param pass
+ *   The pass to draw in.
+ * @param program
+ *   Program the packet draws with, e.g. the native handle of its material.
+ * @param mesh
+ *   Mesh the packet draws, e.g. the native handle of the mesh combined with the level of detail.
+ * @param depth
+ *   Any value that increases with distance from the camera.
+ *
+ * @return
+ *   The sort key.
+ */
+auto make_sort_key(RenderPass pass, std::uint32_t program, std::uint32_t mesh, std::uint32_t depth) -> std::uint64_t;
+
+/**
+ * A single instanced draw, everything needed to issue it without touching any other state. The label is the profiler
+ * scope the draw is timed under and may be null.
+ *
+ * If the indirect buffer is non zero the draw is made with the DrawElementsIndirectCommand at the start of it instead
+ * of the lod and instances, for draws whose size only the gpu knows. Indirect packets are never merged.
+ */
+struct RenderPacket
+{
+    const Material *material;
+    const Mesh *mesh;
+    std::uint32_t lod;
+    std::uint32_t base_instance;
+    std::uint32_t instance_count;
+    const char *label;
+    ::GLuint indirect_buffer;
+};
+
+/**
+ * Counters for a frame of rendering, the redundant counts are calls that were skipped because the state was already
+ * set.
+ */
+struct RenderQueueStats
+{
+    std::uint32_t packets;
+    std::uint32_t draws;
+    std::uint32_t binds;
+    std::uint32_t redundant_binds;
+    std::uint32_t state_changes;
+    std::uint32_t redundant_state_changes;
+};
+
+/**
+ * Class for queueing up a frame of draws and submitting them in an order that minimises state changes.
+ *
+ * Packets are sorted by key when the queue is flushed, then adjacent packets that draw the same thing over contiguous
+ * ranges of instances are merged into a single draw. The queue remembers what it last bound and skips anything that is
+ * already bound, so it assumes nothing else changes the program, vertex array or the buffer bindings it manages.
+ *
+ * Note that for simplicity no cleanup is performed.
+ */
+class RenderQueue
+{
+  public:
+    /**
+     * Construct a new render queue.
+     *
+     * @param capacity
+     *   Maximum number of packets per frame.
+     */
+    RenderQueue(std::uint32_t capacity);
+
+    /**
+     * Add a packet to the queue.
+     *
+     * @param key
+     *   Sort key of the packet, see make_sort_key.
+     * @param packet
+     *   The packet.
+     */
+    auto submit(std::uint64_t key, const RenderPacket &packet) -> void;
+
+    /**
+     * Bind a buffer to an indexed binding point, skipped if it's already bound there.
+     *
+     * @param target
+     *   GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER.
+     * @param index
+     *   The binding point.
+     * @param buffer
+     *   Native handle of the buffer.
+     */
+    auto bind_buffer(::GLenum target, ::GLuint index, ::GLuint buffer) -> void;
+
+    /**
+     * Run a compute material straight away, it is not queued. Going through the queue keeps its idea of the current
+     * program right, any buffers the material uses should be bound with bind_buffer first.
+     *
+     * @param material
+     *   The compute material to run.
+     * @param group_count
+     *   Number of work groups to run.
+     */
+    auto dispatch(const Material &material, std::uint32_t group_count) -> void;
+
+    /**
+     * Sort and draw everything submitted, leaving the queue empty.
+     *
+     * Sorting interleaves packets with different labels, so a label can get several profiler scopes in a frame (which
+     * the profiler sums).
+     *
+     * @param profiler
+     *   Profiler to time each run of packets with the same label with, may be null.
+     */
+    auto flush(GpuProfiler *profiler) -> void;
+
+    /**
+     * Get the counters for the last flush, including any buffer binds since the flush before it.
+     *
+     * @return
+     *   The counters.
+     */
+    auto stats() const -> const RenderQueueStats &;
+
+  private:
+    /**
+     * Issue a draw.
+     *
+     * @param packet
+     *   The packet to draw.
+     * @param profiler
+     *   Profiler to time the draw with, may be null.
+     */
+    auto draw(const RenderPacket &packet, GpuProfiler *profiler) -> void;
+
+    /** Number of indexed binding points tracked for each buffer target. */
+    static constexpr auto tracked_bindings = 8u;
+
+    /** Maximum number of packets. */
+    std::uint32_t capacity_;
+
+    /** Number of packets submitted. */
+    std::uint32_t count_;
+
+    /** Submitted packets. */
+    RenderPacket *packets_;
+
+    /** Sort keys, the value of each is the index of its packet. */
+    RadixSortItem *keys_;
+
+    /** Scratch space for sorting the keys. */
+    RadixSortItem *scratch_;
+
+    /** Currently bound program. */
+    ::GLuint program_;
+
+    /** Currently bound vertex array. */
+    ::GLuint vertex_array_;
+
+    /** Label of the open profiler scope, null if there isn't one. */
+    const char *label_;
+
+    /** Buffers bound to each uniform buffer binding point. */
+    ::GLuint uniform_buffers_[tracked_bindings];
+
+    /** Buffers bound to each shader storage binding point. */
+    ::GLuint storage_buffers_[tracked_bindings];
+
+    /** Counters being accumulated for the current frame. */
+    RenderQueueStats current_stats_;
+
+    /** Counters for the last flush. */
+    RenderQueueStats stats_;
+};
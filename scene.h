@@ -1,27 +1,8 @@
 #pragma once
 
 #include "matrix4.h"
-#include "vector3.h"
-
-#pragma warning(push)
-#pragma warning(disable : 4324)
-struct ModelData
-{
-    Matrix4 model;
-    alignas(16) Vector3 checker_colour1;
-    alignas(16) Vector3 checker_colour2;
-    alignas(16) Vector3 wood_colour1;
-    alignas(16) Vector3 wood_colour2;
-    alignas(16) Vector3 wood_colour3;
-    float wood_scale;
-    alignas(16) Vector3 metal_colour;
-    alignas(16) Vector3 water_colour1;
-    alignas(16) Vector3 water_colour2;
-    float normal_scale;
-};
-#pragma warning(pop)
+#include "model_data.h"
 
-static constexpr auto max_models_per_type = 100u;
 auto cube_model_count = 13u;
 ModelData cube_models[] = {
     {{{1.000000,
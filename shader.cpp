@@ -1,5 +1,6 @@
 #include "shader.h"
 
+#include <cstdint>
 #include <utility>
 
 #include "clib.h"
@@ -26,36 +27,107 @@ auto to_native(ShaderType type) -> ::GLenum
         using enum ShaderType;
         case VERTEX: return GL_VERTEX_SHADER;
         case FRAGMENT: return GL_FRAGMENT_SHADER;
+        case COMPUTE: return GL_COMPUTE_SHADER;
     }
 
     die(ErrorCode::UNKNOWN_SHADER_TYPE);
     std::unreachable();
 }
-}
 
-Shader::Shader(const char *source, ShaderType type)
-    : handle_{::glCreateShader(to_native(type))}
-    , type_(type)
+/**
+ * Helper function to find the end of the #version line, this is where any injected source has to go.
+ *
+ * @param source
+ *   The shader source.
+ *
+ * @return
+ *   Pointer to the character after the newline that ends the #version line.
+ */
+auto find_version_end(const char *source) -> const char *
 {
-    const ::GLchar *strings[] = {source};
-    const ::GLint lengths[] = {static_cast<::GLint>(strlen(source))};
+    static const char version[] = "#version";
 
-    ::glShaderSource(handle_, 1, strings, lengths);
-    ::glCompileShader(handle_);
+    for (const auto *cursor = source; *cursor != '\0'; ++cursor)
+    {
+        if (memcmp(cursor, version, sizeof(version) - 1u) == 0)
+        {
+            while (*cursor != '\0' && *cursor != '\n')
+            {
+                ++cursor;
+            }
 
+            return *cursor == '\n' ? cursor + 1 : cursor;
+        }
+    }
+
+    die(ErrorCode::MISSING_SHADER_VERSION);
+    std::unreachable();
+}
+
+/**
+ * Helper function to check a shader compiled, logging the error and exiting if it didn't.
+ *
+ * @param handle
+ *   The shader to check.
+ */
+auto check_compile_status(::GLuint handle) -> void
+{
     ::GLint result{};
-    ::glGetShaderiv(handle_, GL_COMPILE_STATUS, &result);
+    ::glGetShaderiv(handle, GL_COMPILE_STATUS, &result);
 
     if (result != GL_TRUE)
     {
         char shader_log[512];
-        ::glGetShaderInfoLog(handle_, sizeof(shader_log), nullptr, shader_log);
+        ::glGetShaderInfoLog(handle, sizeof(shader_log), nullptr, shader_log);
 
         log(shader_log);
 
         ensure(result, ErrorCode::FAILED_TO_COMPILE_SHADER);
     }
 }
+}
+
+Shader::Shader(const char *source, ShaderType type)
+    : Shader(source, type, "")
+{
+}
+
+Shader::Shader(const char *source, ShaderType type, const char *defines)
+    : handle_{::glCreateShader(to_native(type))}
+    , type_(type)
+{
+    // split the source around the #version line so the defines land after it
+    const auto *body = find_version_end(source);
+
+    const ::GLchar *strings[] = {source, defines, body};
+    const ::GLint lengths[] = {
+        static_cast<::GLint>(body - source),
+        static_cast<::GLint>(strlen(defines)),
+        static_cast<::GLint>(strlen(body))};
+
+    ::glShaderSource(handle_, 3, strings, lengths);
+    ::glCompileShader(handle_);
+
+    check_compile_status(handle_);
+}
+
+Shader::Shader(
+    const std::uint32_t *spirv,
+    std::uint32_t spirv_size,
+    ShaderType type,
+    const std::uint32_t *constant_ids,
+    const std::uint32_t *constant_values,
+    std::uint32_t constant_count)
+    : handle_{::glCreateShader(to_native(type))}
+    , type_(type)
+{
+    ::glShaderBinary(1, &handle_, GL_SHADER_BINARY_FORMAT_SPIR_V, spirv, spirv_size);
+
+    // specialising is the SPIR-V equivalent of compiling
+    ::glSpecializeShader(handle_, "main", constant_count, constant_ids, constant_values);
+
+    check_compile_status(handle_);
+}
 
 auto Shader::type() const -> ShaderType
 {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 #include "opengl.h"
 
 /**
@@ -8,7 +10,8 @@
 enum class ShaderType
 {
     VERTEX,
-    FRAGMENT
+    FRAGMENT,
+    COMPUTE
 };
 
 /**
@@ -29,6 +32,43 @@ class Shader
      */
     Shader(const char *source, ShaderType type);
 
+    /**
+     * Construct a new shader, injecting some extra source (typically #defines) straight after the #version line. This
+     * allows multiple permutations to be compiled from one source.
+     *
+     * @param source
+     *   The source code of the shader, must start with a #version line.
+     * @param type
+     *   The type of the shader.
+     * @param defines
+     *   Extra source to inject, each line must be newline terminated.
+     */
+    Shader(const char *source, ShaderType type, const char *defines);
+
+    /**
+     * Construct a new shader from precompiled SPIR-V, skipping GLSL parsing entirely.
+     *
+     * @param spirv
+     *   The SPIR-V words.
+     * @param spirv_size
+     *   Size of the SPIR-V in bytes.
+     * @param type
+     *   The type of the shader.
+     * @param constant_ids
+     *   The ids of the specialisation constants to set.
+     * @param constant_values
+     *   The values of the specialisation constants, bools and ints are both passed as their 32 bit representation.
+     * @param constant_count
+     *   Number of specialisation constants.
+     */
+    Shader(
+        const std::uint32_t *spirv,
+        std::uint32_t spirv_size,
+        ShaderType type,
+        const std::uint32_t *constant_ids,
+        const std::uint32_t *constant_values,
+        std::uint32_t constant_count);
+
     /**
      * Get the shader type.
      *
@@ -0,0 +1,371 @@
+#include "spatial_hash.h"
+
+#include <cstdint>
+
+#include <Windows.h>
+
+#include "clib.h"
+#include "error.h"
+#include "job_system.h"
+#include "log.h"
+#include "radix_sort.h"
+#include "timer.h"
+#include "vector3.h"
+
+namespace
+{
+
+/**
+ * Coordinates of a cell.
+ */
+struct Cell
+{
+    std::int32_t x;
+    std::int32_t y;
+    std::int32_t z;
+};
+
+/**
+ * Helper function to get the cell a point is in.
+ *
+ * @param point
+ *   The point.
+ * @param inverse_cell_size
+ *   Reciprocal of the cell size.
+ *
+ * @return
+ *   The cell.
+ */
+auto cell_of(const Vector3 &point, float inverse_cell_size) -> Cell
+{
+    return {
+        .x = to_int(floor(point.x * inverse_cell_size)),
+        .y = to_int(floor(point.y * inverse_cell_size)),
+        .z = to_int(floor(point.z * inverse_cell_size))};
+}
+
+/**
+ * Helper function to hash a cell to a bucket.
+ *
+ * @param x
+ *   X coordinate of the cell.
+ * @param y
+ *   Y coordinate of the cell.
+ * @param z
+ *   Z coordinate of the cell.
+ * @param mask
+ *   Number of buckets minus one.
+ *
+ * @return
+ *   The bucket.
+ */
+auto bucket_of(std::int32_t x, std::int32_t y, std::int32_t z, std::uint32_t mask) -> std::uint32_t
+{
+    // the usual large primes, 32 bit multiplies are all that's needed
+    const auto hash = (static_cast<std::uint32_t>(x) * 73856093u) ^ (static_cast<std::uint32_t>(y) * 19349663u) ^
+                      (static_cast<std::uint32_t>(z) * 83492791u);
+
+    return hash & mask;
+}
+
+/**
+ * Helper function to get the larger of two numbers.
+ */
+auto max_of(std::int32_t a, std::int32_t b) -> std::int32_t
+{
+    return (a > b) ? a : b;
+}
+
+/**
+ * Helper function to get a float in a range from rand.
+ */
+auto random_range(float min, float max) -> float
+{
+    return min + (static_cast<float>(rand() & 0xffff) / 65535.0f) * (max - min);
+}
+
+/**
+ * Helper function to log a time in milliseconds with three decimal places (wsprintf can't do floats).
+ */
+auto log_milliseconds(const char *label, float seconds) -> void
+{
+    const auto us = to_int(seconds * 1000000.0f);
+    log_format("spatial hash %s: %d.%03dms", label, us / 1000, us % 1000);
+}
+
+/**
+ * Bullets for the benchmark to query the grid with.
+ */
+struct QueryJob
+{
+    const SpatialHash *hash;
+    const Vector3 *bullets;
+    float bullet_radius;
+    std::uint32_t *hits;
+};
+
+/**
+ * Job function to count the candidate targets of some bullets.
+ *
+ * @param data
+ *   The QueryJob.
+ * @param begin
+ *   First bullet to query.
+ * @param end
+ *   One past the last bullet to query.
+ */
+auto query_bullets(void *data, std::uint32_t begin, std::uint32_t end) -> void
+{
+    const auto &job = *static_cast<const QueryJob *>(data);
+
+    for (auto i = begin; i < end; ++i)
+    {
+        CollisionPair pairs[8];
+        job.hits[i] = job.hash->query(job.bullets[i], job.bullet_radius, i, pairs, 8u);
+    }
+}
+
+}
+
+SpatialHash::SpatialHash(float cell_size, std::uint32_t max_targets, std::uint32_t max_entries)
+    : inverse_cell_size_{1.0f / cell_size}
+    , max_targets_{max_targets}
+    , max_entries_{max_entries}
+    , bucket_mask_{}
+    , target_min_{static_cast<Vector3 *>(malloc(sizeof(Vector3) * max_targets))}
+    , target_max_{static_cast<Vector3 *>(malloc(sizeof(Vector3) * max_targets))}
+    , entries_{static_cast<RadixSortItem *>(malloc(sizeof(RadixSortItem) * max_entries))}
+    , scratch_{static_cast<RadixSortItem *>(malloc(sizeof(RadixSortItem) * max_entries))}
+    , sorted_{entries_}
+    , entry_count_{}
+    , bucket_start_{}
+    , bucket_count_{}
+{
+    // at least twice as many buckets as entries keeps unrelated cells sharing a bucket rare
+    auto bucket_count = 1u;
+    while (bucket_count < (max_entries * 2u))
+    {
+        bucket_count <<= 1u;
+    }
+
+    bucket_mask_ = bucket_count - 1u;
+    bucket_start_ = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * bucket_count));
+    bucket_count_ = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * bucket_count));
+
+    for (auto i = 0u; i < bucket_count; ++i)
+    {
+        bucket_count_[i] = 0u;
+    }
+}
+
+auto SpatialHash::build(const Vector3 *centres, const float *radii, std::uint32_t count) -> void
+{
+    ensure(count <= max_targets_, ErrorCode::SPATIAL_HASH_OVERFLOW);
+
+    // only empty the buckets the last build used, clearing the whole table would cost more than the build
+    for (auto i = 0u; i < entry_count_; ++i)
+    {
+        bucket_count_[static_cast<std::uint32_t>(sorted_[i].key)] = 0u;
+    }
+
+    entry_count_ = 0u;
+
+    for (auto i = 0u; i < count; ++i)
+    {
+        target_min_[i] = centres[i] - Vector3{radii[i]};
+        target_max_[i] = centres[i] + Vector3{radii[i]};
+
+        const auto min = cell_of(target_min_[i], inverse_cell_size_);
+        const auto max = cell_of(target_max_[i], inverse_cell_size_);
+
+        for (auto z = min.z; z <= max.z; ++z)
+        {
+            for (auto y = min.y; y <= max.y; ++y)
+            {
+                for (auto x = min.x; x <= max.x; ++x)
+                {
+                    ensure(entry_count_ < max_entries_, ErrorCode::SPATIAL_HASH_OVERFLOW);
+                    entries_[entry_count_++] = {.key = bucket_of(x, y, z, bucket_mask_), .value = i};
+                }
+            }
+        }
+    }
+
+    sorted_ = radix_sort(entries_, scratch_, entry_count_);
+
+    for (auto i = 0u; i < entry_count_; ++i)
+    {
+        const auto bucket = static_cast<std::uint32_t>(sorted_[i].key);
+        if (bucket_count_[bucket] == 0u)
+        {
+            bucket_start_[bucket] = i;
+        }
+
+        ++bucket_count_[bucket];
+    }
+}
+
+auto SpatialHash::query(
+    const Vector3 &centre,
+    float radius,
+    std::uint32_t query,
+    CollisionPair *pairs,
+    std::uint32_t max_pairs) const -> std::uint32_t
+{
+    const auto query_min = centre - Vector3{radius};
+    const auto query_max = centre + Vector3{radius};
+
+    const auto min = cell_of(query_min, inverse_cell_size_);
+    const auto max = cell_of(query_max, inverse_cell_size_);
+
+    auto pair_count = 0u;
+
+    for (auto z = min.z; z <= max.z; ++z)
+    {
+        for (auto y = min.y; y <= max.y; ++y)
+        {
+            for (auto x = min.x; x <= max.x; ++x)
+            {
+                const auto bucket = bucket_of(x, y, z, bucket_mask_);
+                const auto start = bucket_start_[bucket];
+                const auto end = start + bucket_count_[bucket];
+
+                for (auto i = start; i < end; ++i)
+                {
+                    const auto target = sorted_[i].value;
+                    const auto &target_min = target_min_[target];
+                    const auto &target_max = target_max_[target];
+
+                    if ((query_max.x < target_min.x) || (query_min.x > target_max.x) ||
+                        (query_max.y < target_min.y) || (query_min.y > target_max.y) ||
+                        (query_max.z < target_min.z) || (query_min.z > target_max.z))
+                    {
+                        continue;
+                    }
+
+                    // the pair shows up in every cell both touch, only report it from the cell holding the smallest
+                    // corner of the overlap
+                    const auto target_cell = cell_of(target_min, inverse_cell_size_);
+                    if ((max_of(min.x, target_cell.x) != x) || (max_of(min.y, target_cell.y) != y) ||
+                        (max_of(min.z, target_cell.z) != z))
+                    {
+                        continue;
+                    }
+
+                    if (pair_count < max_pairs)
+                    {
+                        pairs[pair_count] = {.query = query, .target = target};
+                    }
+
+                    ++pair_count;
+                }
+            }
+        }
+    }
+
+    return pair_count;
+}
+
+auto SpatialHash::entry_count() const -> std::uint32_t
+{
+    return entry_count_;
+}
+
+auto benchmark_spatial_hash() -> void
+{
+    static constexpr auto target_count = 1000u;
+    static constexpr auto bullet_count = 10000u;
+    static constexpr auto bullet_radius = 0.1f;
+    static constexpr auto iterations = 16u;
+    static constexpr auto frame_budget = 0.002f;
+
+    seed_rand(0x5eedu);
+
+    auto *centres = static_cast<Vector3 *>(malloc(sizeof(Vector3) * target_count));
+    auto *radii = static_cast<float *>(malloc(sizeof(float) * target_count));
+    auto *bullets = static_cast<Vector3 *>(malloc(sizeof(Vector3) * bullet_count));
+    auto *hits = static_cast<std::uint32_t *>(malloc(sizeof(std::uint32_t) * bullet_count));
+
+    // roughly the spread of the scene, but far busier
+    for (auto i = 0u; i < target_count; ++i)
+    {
+        centres[i] = {random_range(-100.0f, 100.0f), random_range(0.0f, 20.0f), random_range(-100.0f, 100.0f)};
+        radii[i] = random_range(0.5f, 3.0f);
+    }
+
+    for (auto i = 0u; i < bullet_count; ++i)
+    {
+        bullets[i] = {random_range(-100.0f, 100.0f), random_range(0.0f, 20.0f), random_range(-100.0f, 100.0f)};
+    }
+
+    auto hash = SpatialHash{4.0f, target_count, target_count * 8u};
+
+    auto build_seconds = 0.0f;
+    auto query_seconds = 0.0f;
+    auto parallel_seconds = 0.0f;
+    auto pair_count = 0u;
+
+    for (auto iteration = 0u; iteration < iterations; ++iteration)
+    {
+        auto timer = Timer{};
+        hash.build(centres, radii, target_count);
+        build_seconds += timer.elapsed_seconds();
+
+        timer.reset();
+        pair_count = 0u;
+        for (auto i = 0u; i < bullet_count; ++i)
+        {
+            CollisionPair pairs[8];
+            hits[i] = hash.query(bullets[i], bullet_radius, i, pairs, 8u);
+            pair_count += hits[i];
+        }
+        query_seconds += timer.elapsed_seconds();
+
+        // queries only read the grid, so they split across the job system without any care
+        timer.reset();
+        auto query_job = QueryJob{.hash = &hash, .bullets = bullets, .bullet_radius = bullet_radius, .hits = hits};
+        job_system_parallel_for(bullet_count, 256u, query_bullets, &query_job);
+        parallel_seconds += timer.elapsed_seconds();
+    }
+
+    const auto iterations_float = static_cast<float>(static_cast<std::int32_t>(iterations));
+    log_format(
+        "spatial hash: %u targets in %u entries, %u bullets, %u candidate pairs",
+        target_count,
+        hash.entry_count(),
+        bullet_count,
+        pair_count);
+    log_milliseconds("build", build_seconds / iterations_float);
+    log_milliseconds("query 1 thread", query_seconds / iterations_float);
+    log_milliseconds("query all threads", parallel_seconds / iterations_float);
+
+    const auto frame_seconds = (build_seconds + parallel_seconds) / iterations_float;
+    log_milliseconds(frame_seconds <= frame_budget ? "frame (within budget)" : "frame (over budget)", frame_seconds);
+
+    // every overlap brute force finds has to be reported, check a sample as the full test is 10 million pairs
+    auto missed = 0u;
+    for (auto i = 0u; i < bullet_count; i += 16u)
+    {
+        auto expected = 0u;
+        for (auto j = 0u; j < target_count; ++j)
+        {
+            const auto offset = bullets[i] - centres[j];
+            const auto reach = radii[j] + bullet_radius;
+            const auto absolute = [](float value) { return value < 0.0f ? -value : value; };
+
+            if ((absolute(offset.x) <= reach) && (absolute(offset.y) <= reach) && (absolute(offset.z) <= reach))
+            {
+                ++expected;
+            }
+        }
+
+        missed += (hits[i] != expected) ? 1u : 0u;
+    }
+
+    log_format("spatial hash: %u sampled bullets disagree with brute force", missed);
+
+    free(centres);
+    free(radii);
+    free(bullets);
+    free(hits);
+}
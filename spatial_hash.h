@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+
+#include "radix_sort.h"
+#include "vector3.h"
+
+/**
+ * A query and a target whose bounds overlap, to be checked properly by the caller.
+ */
+struct CollisionPair
+{
+    std::uint32_t query;
+    std::uint32_t target;
+};
+
+/**
+ * Uniform grid broadphase for testing lots of small things (bullets) against a set of targets.
+ *
+ * Space is split into cubic cells and every target is added to each cell its bounding box touches. Cells are hashed in
+ * to a fixed size table rather than stored densely, so the grid is unbounded and only costs memory for cells that have
+ * something in them. The table is rebuilt from scratch every time, the entries are radix sorted by bucket so each
+ * bucket's targets end up contiguous.
+ *
+ * Queries only read the grid, so any number of threads can query at once. A pair is reported once however many cells
+ * the query and target share, and only if their bounding boxes overlap, different cells landing in the same bucket are
+ * filtered out by that same test.
+ *
+ * Note that for simplicity no cleanup is performed.
+ */
+class SpatialHash
+{
+  public:
+    /**
+     * Construct a new spatial hash.
+     *
+     * @param cell_size
+     *   Length of a cell's side, around the size of a typical target works well.
+     * @param max_targets
+     *   Most targets that can be added.
+     * @param max_entries
+     *   Most target and cell pairs, a target takes one entry for every cell its bounds touch.
+     */
+    SpatialHash(float cell_size, std::uint32_t max_targets, std::uint32_t max_entries);
+
+    /**
+     * Replace the contents of the grid with a new set of spherical targets.
+     *
+     * @param centres
+     *   Centre of each target.
+     * @param radii
+     *   Radius of each target.
+     * @param count
+     *   Number of targets.
+     */
+    auto build(const Vector3 *centres, const float *radii, std::uint32_t count) -> void;
+
+    /**
+     * Find every target whose bounds overlap a sphere.
+     *
+     * @param centre
+     *   Centre of the query.
+     * @param radius
+     *   Radius of the query, zero for a point.
+     * @param query
+     *   Index written to the query field of each pair.
+     * @param pairs
+     *   Array to write the pairs to.
+     * @param max_pairs
+     *   Size of the pairs array, anything beyond it is dropped.
+     *
+     * @return
+     *   Number of pairs found, which may be more than max_pairs.
+     */
+    auto query(const Vector3 &centre, float radius, std::uint32_t query, CollisionPair *pairs, std::uint32_t max_pairs)
+        const -> std::uint32_t;
+
+    /**
+     * Get the number of target and cell pairs in the grid.
+     *
+     * @return
+     *   Number of entries.
+     */
+    auto entry_count() const -> std::uint32_t;
+
+  private:
+    /** Reciprocal of the cell size. */
+    float inverse_cell_size_;
+
+    /** Most targets that can be added. */
+    std::uint32_t max_targets_;
+
+    /** Most entries that can be added. */
+    std::uint32_t max_entries_;
+
+    /** Number of buckets in the table minus one, the table is a power of two in size. */
+    std::uint32_t bucket_mask_;
+
+    /** Smallest corner of each target's bounds. */
+    Vector3 *target_min_;
+
+    /** Largest corner of each target's bounds. */
+    Vector3 *target_max_;
+
+    /** Entries keyed by bucket with the target as the value, sorted once built. */
+    RadixSortItem *entries_;
+
+    /** Scratch space for sorting the entries. */
+    RadixSortItem *scratch_;
+
+    /** The sorted entries, points to either entries_ or scratch_. */
+    RadixSortItem *sorted_;
+
+    /** Number of entries. */
+    std::uint32_t entry_count_;
+
+    /** Index of the first sorted entry in each bucket. */
+    std::uint32_t *bucket_start_;
+
+    /** Number of sorted entries in each bucket. */
+    std::uint32_t *bucket_count_;
+};
+
+/**
+ * Benchmark building and querying the grid with far more bullets and targets than the game has, logging the time
+ * taken against a frame budget and checking the pairs against a brute force test.
+ */
+auto benchmark_spatial_hash() -> void;
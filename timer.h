@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Windows.h>
+
+/**
+ * Simple high resolution timer built on QueryPerformanceCounter.
+ */
+class Timer
+{
+  public:
+    /**
+     * Construct a new timer, it starts running immediately.
+     */
+    Timer()
+        : start_{}
+        , frequency_{}
+    {
+        ::QueryPerformanceFrequency(&frequency_);
+        reset();
+    }
+
+    /**
+     * Restart the timer from now.
+     */
+    auto reset() -> void
+    {
+        ::QueryPerformanceCounter(&start_);
+    }
+
+    /**
+     * Get the time since the timer was constructed or last reset.
+     *
+     * @return
+     *   Elapsed time in seconds.
+     */
+    auto elapsed_seconds() const -> float
+    {
+        auto now = ::LARGE_INTEGER{};
+        ::QueryPerformanceCounter(&now);
+
+        // go via double to avoid needing the CRT 64-bit division helpers
+        return static_cast<float>(
+            static_cast<double>(now.QuadPart - start_.QuadPart) / static_cast<double>(frequency_.QuadPart));
+    }
+
+  private:
+    /** Counter value when the timer was started. */
+    ::LARGE_INTEGER start_;
+
+    /** Counter ticks per second. */
+    ::LARGE_INTEGER frequency_;
+};
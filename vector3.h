@@ -97,6 +97,24 @@ struct Vector3
         return hypot(v1.x - v2.x, v1.y - v2.y, v1.z - v2.z);
     }
 
+    /**
+     * Linearly interpolates between two vectors.
+     *
+     * @param v1
+     *   The vector at t = 0.
+     * @param v2
+     *   The vector at t = 1.
+     * @param t
+     *   How far to interpolate.
+     *
+     * @return
+     *   The interpolated vector.
+     */
+    static auto lerp(const Vector3 &v1, const Vector3 &v2, float t) -> Vector3
+    {
+        return {v1.x + ((v2.x - v1.x) * t), v1.y + ((v2.y - v1.y) * t), v1.z + ((v2.z - v1.z) * t)};
+    }
+
     /** Default equality operator. */
     auto operator==(const Vector3 &) const -> bool = default;
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 #include "vector3.h"
 
 struct UV
@@ -15,3 +17,14 @@ struct VertexData
     Vector3 tangent;
     UV uv;
 };
+
+// compressed version of VertexData, 20 bytes rather than 44
+// position is snorm16 (w is padding, every generated mesh fits in a unit cube), normal and tangent are octahedral
+// encoded snorm16 and uv is half float
+struct PackedVertexData
+{
+    std::int16_t position[4];
+    std::int16_t normal[2];
+    std::int16_t tangent[2];
+    std::uint16_t uv[2];
+};
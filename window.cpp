@@ -1,13 +1,18 @@
 #include "window.h"
 
+#include <cstdint>
+
 #include <Windows.h>
 #include <gl/gl.h>
 #include <hidusage.h>
 
 #include "third_party/opengl/wglext.h"
 
+#include "clib.h"
+#include "cpu_profiler.h"
 #include "error.h"
 #include "event.h"
+#include "event_ring.h"
 #include "log.h"
 #include "opengl.h"
 
@@ -17,9 +22,196 @@ namespace
 // pointers to wgl functions
 PFNWGLCHOOSEPIXELFORMATARBPROC wglChoosePixelFormatARB{};
 PFNWGLCREATECONTEXTATTRIBSARBPROC wglCreateContextAttribsARB{};
+PFNWGLSWAPINTERVALEXTPROC wglSwapIntervalEXT{};
+
+// events written by the window procedure on the input thread, waiting to be handed out by pump_message, zeroed by the
+// loader as nothing would run a constructor
+EventRing g_events;
+
+// mouse movement that didn't fit in the ring, merged into one event and pushed as soon as there's room, only touched by
+// the input thread
+Event g_pending_move;
+bool g_move_pending;
+
+// number of events that couldn't be merged and were dropped because the ring was full
+std::uint32_t g_dropped_events;
 
-Event g_event;
-bool g_has_event = false;
+/** Longest time in seconds buffered raw input is spread back over, so input after an idle spell isn't backdated. */
+static constexpr auto g_max_raw_input_spread = 0.01f;
+
+/**
+ * State kept by the input thread between bulk raw input reads.
+ */
+struct RawInputReader
+{
+    /** Bytes between the header and the data of a buffered block, non zero for a 32 bit process on 64 bit Windows. */
+    std::uint32_t header_padding;
+
+    /** Alignment of buffered blocks. */
+    std::uint32_t block_alignment;
+
+    /** Time of the last read, buffered events arrived between then and now. */
+    std::int64_t last_read;
+
+    /** Longest time buffered events are spread back over, in QueryPerformanceCounter ticks. */
+    int max_spread;
+};
+
+/**
+ * Helper function to get the time to stamp an event with.
+ *
+ * @return
+ *   Current QueryPerformanceCounter value.
+ */
+auto event_time() -> std::int64_t
+{
+    auto counter = ::LARGE_INTEGER{};
+    ::QueryPerformanceCounter(&counter);
+
+    return counter.QuadPart;
+}
+
+/**
+ * Helper function to push any pending mouse movement.
+ *
+ * @return
+ *   True if nothing is pending any more, false if the ring is still full.
+ */
+auto flush_pending_move() -> bool
+{
+    if (g_move_pending && g_events.push(g_pending_move))
+    {
+        g_move_pending = false;
+    }
+
+    return !g_move_pending;
+}
+
+/**
+ * Helper function to queue an event from the input thread. A mouse move that doesn't fit is added to the pending
+ * movement so a slow frame never loses any, anything else is dropped. Pending movement goes first so events stay in
+ * order.
+ *
+ * @param evt
+ *   The event to queue.
+ */
+auto push_event(const Event &evt) -> void
+{
+    if (flush_pending_move() && g_events.push(evt))
+    {
+        return;
+    }
+
+    if (evt.type != EventType::MOUSE_MOVE)
+    {
+        ++g_dropped_events;
+        return;
+    }
+
+    // keep the time of the first movement, it's what latency is measured from
+    if (g_move_pending)
+    {
+        g_pending_move.data.mouse_move.delta_x += evt.data.mouse_move.delta_x;
+        g_pending_move.data.mouse_move.delta_y += evt.data.mouse_move.delta_y;
+    }
+    else
+    {
+        g_pending_move = evt;
+        g_move_pending = true;
+    }
+}
+
+/**
+ * Helper function to queue a mouse move from raw input.
+ *
+ * @param header
+ *   Header of the raw input, ignored if not from a mouse.
+ * @param mouse
+ *   The mouse data following the header.
+ * @param time
+ *   Time to stamp the event with.
+ */
+auto push_raw_input(const ::RAWINPUTHEADER &header, const ::RAWMOUSE &mouse, std::int64_t time) -> void
+{
+    if (header.dwType == RIM_TYPEMOUSE)
+    {
+        push_event(
+            {.type = EventType::MOUSE_MOVE,
+             .data = {.mouse_move = {static_cast<float>(mouse.lLastX), static_cast<float>(mouse.lLastY)}},
+             .time = time});
+    }
+}
+
+/**
+ * Helper function to create the state for reading buffered raw input.
+ *
+ * @return
+ *   Reader for the current process.
+ */
+auto create_raw_input_reader() -> RawInputReader
+{
+    // a 32 bit process on 64 bit Windows gets the 64 bit layout from GetRawInputBuffer, handles in the header are
+    // 8 bytes bigger and blocks are 8 byte aligned (GetRawInputData converts, so WM_INPUT needs none of this)
+    auto wow64 = ::BOOL{};
+    ::IsWow64Process(::GetCurrentProcess(), &wow64);
+
+    auto frequency = ::LARGE_INTEGER{};
+    ::QueryPerformanceFrequency(&frequency);
+
+    return {
+        .header_padding = wow64 ? 8u : 0u,
+        .block_alignment = wow64 ? 8u : static_cast<std::uint32_t>(sizeof(::DWORD)),
+        .last_read = event_time(),
+        .max_spread = to_int(static_cast<float>(frequency.QuadPart) * g_max_raw_input_spread)};
+}
+
+/**
+ * Helper function to read all the raw input waiting in the queue in as few calls as possible. At high polling rates a
+ * mouse can produce several WM_INPUT messages a millisecond, reading them in bulk means none of the deltas are lost to
+ * a slow frame and we don't pay for a dispatch per message.
+ *
+ * Buffered input doesn't say when it arrived, only that it was after the last read, so the events are spread evenly
+ * up to now with the newest stamped now.
+ *
+ * @param reader
+ *   State from the last read.
+ */
+auto read_raw_input_buffer(RawInputReader *reader) -> void
+{
+    alignas(8) std::uint8_t buffer[4096];
+
+    const auto now = event_time();
+    auto from = (now - reader->last_read < reader->max_spread) ? reader->last_read : now - reader->max_spread;
+    reader->last_read = now;
+
+    for (;;)
+    {
+        auto size = ::UINT{sizeof(buffer)};
+        const auto count =
+            ::GetRawInputBuffer(reinterpret_cast<::RAWINPUT *>(buffer), &size, sizeof(::RAWINPUTHEADER));
+        if ((count == 0u) || (count == static_cast<::UINT>(-1)))
+        {
+            break;
+        }
+
+        const auto step = static_cast<float>(now - from) / static_cast<float>(static_cast<std::int32_t>(count));
+
+        auto *block = buffer;
+        for (auto i = 0u; i < count; ++i)
+        {
+            const auto &header = *reinterpret_cast<const ::RAWINPUTHEADER *>(block);
+            const auto &mouse =
+                *reinterpret_cast<const ::RAWMOUSE *>(block + sizeof(::RAWINPUTHEADER) + reader->header_padding);
+
+            push_raw_input(header, mouse, from + to_int(step * static_cast<float>(static_cast<std::int32_t>(i + 1u))));
+
+            block += (header.dwSize + reader->block_alignment - 1u) & ~(reader->block_alignment - 1u);
+        }
+
+        // anything left didn't fit in the buffer, it's rare enough to just stamp it now
+        from = now;
+    }
+}
 
 /** Callback for OpenGL debug messages. */
 auto APIENTRY opengl_debug_callback(
@@ -47,40 +239,33 @@ auto CALLBACK window_proc(HWND hWnd, UINT Msg, WPARAM wParam, LPARAM lParam) ->
         case WM_CLOSE: ::PostQuitMessage(0); break;
         case WM_KEYUP:
         {
-            g_event = Event{.type = EventType::KEY_UP, .data = static_cast<std::uint8_t>(wParam)};
-            g_has_event = true;
+            push_event(
+                {.type = EventType::KEY_UP, .data = static_cast<std::uint8_t>(wParam), .time = event_time()});
             break;
         }
         case WM_KEYDOWN:
         {
-            g_event = Event{.type = EventType::KEY_DOWN, .data = static_cast<std::uint8_t>(wParam)};
-            g_has_event = true;
+            push_event(
+                {.type = EventType::KEY_DOWN, .data = static_cast<std::uint8_t>(wParam), .time = event_time()});
             break;
         }
         case WM_INPUT:
         {
+            // most raw input is read in bulk by the input thread, this only sees what arrived after that
             auto raw = ::RAWINPUT{};
             auto dwSize = ::UINT{sizeof(::RAWINPUT)};
-            ::GetRawInputData(
-                reinterpret_cast<::HRAWINPUT>(lParam), RID_INPUT, &raw, &dwSize, sizeof(::RAWINPUTHEADER));
-
-            if (raw.header.dwType == RIM_TYPEMOUSE)
+            if (::GetRawInputData(
+                    reinterpret_cast<::HRAWINPUT>(lParam), RID_INPUT, &raw, &dwSize, sizeof(::RAWINPUTHEADER)) !=
+                static_cast<::UINT>(-1))
             {
-                const auto x = raw.data.mouse.lLastX;
-                const auto y = raw.data.mouse.lLastY;
-
-                g_event = {
-                    .type = EventType::MOUSE_MOVE,
-                    .data = {.mouse_move = {static_cast<float>(x), static_cast<float>(y)}}};
-                g_has_event = true;
+                push_raw_input(raw.header, raw.data.mouse, event_time());
             }
 
             break;
         }
         case WM_LBUTTONDOWN:
         {
-            g_event = {.type = EventType::LEFT_MOUSE_CLICK};
-            g_has_event = true;
+            push_event({.type = EventType::LEFT_MOUSE_CLICK, .time = event_time()});
             break;
         }
     }
@@ -160,6 +345,7 @@ auto resolve_wgl_functions(HINSTANCE instance) -> void
     // resolve out wgl functions
     resolve_gl_function(reinterpret_cast<void **>(&wglCreateContextAttribsARB), "wglCreateContextAttribsARB");
     resolve_gl_function(reinterpret_cast<void **>(&wglChoosePixelFormatARB), "wglChoosePixelFormatARB");
+    resolve_gl_function(reinterpret_cast<void **>(&wglSwapIntervalEXT), "wglSwapIntervalEXT");
 
     make_current_res = ::wglMakeCurrent(dc, 0);
     ensure(make_current_res == TRUE, ErrorCode::WGL_MAKE_CURRENT);
@@ -174,8 +360,10 @@ auto resolve_wgl_functions(HINSTANCE instance) -> void
  *
  * @param dc
  *   Device context to initialise for OpenGL.
+ * @param headless
+ *   Whether the window is headless, which allows a software implementation.
  */
-auto init_opengl(HDC dc) -> void
+auto init_opengl(HDC dc, bool headless) -> void
 {
     int pixel_format_attribs[]{
         WGL_DRAW_TO_WINDOW_ARB,
@@ -184,8 +372,6 @@ auto init_opengl(HDC dc) -> void
         GL_TRUE,
         WGL_DOUBLE_BUFFER_ARB,
         GL_TRUE,
-        WGL_ACCELERATION_ARB,
-        WGL_FULL_ACCELERATION_ARB,
         WGL_PIXEL_TYPE_ARB,
         WGL_TYPE_RGBA_ARB,
         WGL_COLOR_BITS_ARB,
@@ -194,8 +380,17 @@ auto init_opengl(HDC dc) -> void
         24,
         WGL_STENCIL_BITS_ARB,
         8,
+        WGL_ACCELERATION_ARB,
+        WGL_FULL_ACCELERATION_ARB,
         0};
 
+    // software implementations don't report full acceleration, so end the list before asking for it (the acceleration
+    // pair is the last before the terminator)
+    if (headless)
+    {
+        pixel_format_attribs[14] = 0;
+    }
+
     auto pixel_format = 0;
     auto num_formats = UINT{};
 
@@ -232,6 +427,99 @@ auto resolve_global_gl_functions() -> void
     FOR_OPENGL_FUNCTIONS(RESOLVE)
 }
 
+/**
+ * Helper function to parse a comma separated list of frame numbers.
+ *
+ * @param str
+ *   The list to parse.
+ * @param frames
+ *   Array to write the frame numbers to.
+ * @param max_frames
+ *   Size of the array, any extra numbers are ignored.
+ *
+ * @return
+ *   Number of frame numbers written.
+ */
+auto parse_frame_list(const char *str, std::uint32_t *frames, std::uint32_t max_frames) -> std::uint32_t
+{
+    auto count = 0u;
+    auto value = 0u;
+    auto has_value = false;
+
+    for (const auto *cursor = str;; ++cursor)
+    {
+        if ((*cursor >= '0') && (*cursor <= '9'))
+        {
+            value = (value * 10u) + static_cast<std::uint32_t>(*cursor - '0');
+            has_value = true;
+        }
+        else
+        {
+            if (has_value && (count < max_frames))
+            {
+                frames[count++] = value;
+            }
+
+            value = 0u;
+            has_value = false;
+
+            if (*cursor == '\0')
+            {
+                break;
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Helper function to read back the current read framebuffer and write it to a binary PPM.
+ *
+ * @param path
+ *   Path of the file to write.
+ * @param width
+ *   Width of the framebuffer.
+ * @param height
+ *   Height of the framebuffer.
+ *
+ * @return
+ *   True if the file was written, false otherwise.
+ */
+auto write_ppm(const char *path, int width, int height) -> bool
+{
+    const auto row_size = static_cast<std::uint32_t>(width) * 3u;
+    auto *pixels = static_cast<std::uint8_t *>(malloc(row_size * static_cast<std::uint32_t>(height)));
+
+    ::glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    ::glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+    auto written = false;
+
+    const auto file = ::CreateFileA(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        char header[32];
+        const auto header_size = static_cast<::DWORD>(::wsprintfA(header, "P6\n%d %d\n255\n", width, height));
+
+        auto count = ::DWORD{};
+        written = ::WriteFile(file, header, header_size, &count, nullptr) && (count == header_size);
+
+        // GL rows start at the bottom, PPM rows at the top
+        for (auto y = height - 1; written && (y >= 0); --y)
+        {
+            const auto *row = pixels + (static_cast<std::uint32_t>(y) * row_size);
+            written = ::WriteFile(file, row, row_size, &count, nullptr) && (count == row_size);
+        }
+
+        ::CloseHandle(file);
+    }
+
+    free(pixels);
+
+    return written;
+}
+
 /**
  * Helper function to setup OpenGL debugging (could probably remove to save space).
  */
@@ -241,31 +529,56 @@ auto setup_debug() -> void
     ::glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
     ::glDebugMessageCallback(opengl_debug_callback, nullptr);
 }
-}
 
-Window::Window(int width, int height)
-    : running_{true}
-    , wc_{}
-    , window_{}
-    , dc_{}
+/**
+ * Everything the input thread needs to create the window, and what it hands back.
+ */
+struct InputThreadArgs
 {
-    wc_ = ::WNDCLASS{
-        .style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC,
-        .lpfnWndProc = window_proc,
-        .hInstance = ::GetModuleHandleA(nullptr),
-        .lpszClassName = "a"};
+    /** Window class to register. */
+    ::WNDCLASS *wc;
+
+    /** Width of the client area. */
+    int width;
+
+    /** Height of the client area. */
+    int height;
 
-    const auto register_class_res = ::RegisterClassA(&wc_);
+    /** Whether to leave the window hidden. */
+    bool headless;
+
+    /** Flag to clear when the window is closed. */
+    volatile bool *running;
+
+    /** The created window, written before ready is signalled. */
+    ::HWND window;
+
+    /** Event signalled once the window exists. */
+    ::HANDLE ready;
+};
+
+/**
+ * Entry point of the input thread. This creates and owns the window, so all its messages are handled here and a slow
+ * frame never holds up input, everything is passed on to the game through the event ring.
+ *
+ * @param args
+ *   Arguments from the window constructor, only valid until ready is signalled.
+ */
+auto input_thread(InputThreadArgs *args) -> void
+{
+    cpu_profiler_register_thread("input");
+
+    const auto register_class_res = ::RegisterClassA(args->wc);
     ensure(register_class_res != 0, ErrorCode::REGISTER_CLASS);
 
-    auto rect = ::RECT{.left = {}, .top = {}, .right = static_cast<int>(width), .bottom = static_cast<int>(height)};
+    auto rect = ::RECT{.left = {}, .top = {}, .right = args->width, .bottom = args->height};
 
     const auto adjust_window_res = ::AdjustWindowRect(&rect, WS_OVERLAPPEDWINDOW, false);
     ensure(adjust_window_res != 0, ErrorCode::ADJUST_WINDOW_RECT);
 
-    window_ = ::CreateWindowExA(
+    const auto window = ::CreateWindowExA(
         0,
-        wc_.lpszClassName,
+        args->wc->lpszClassName,
         "",
         WS_OVERLAPPEDWINDOW,
         CW_USEDEFAULT,
@@ -274,31 +587,147 @@ Window::Window(int width, int height)
         rect.bottom - rect.top,
         nullptr,
         nullptr,
-        wc_.hInstance,
+        args->wc->hInstance,
         nullptr);
 
-    dc_ = ::GetDC(window_);
-
-    ::ShowWindow(window_, SW_SHOW);
-    ::UpdateWindow(window_);
+    // a hidden window still gets a context, it's just never drawn to
+    if (!args->headless)
+    {
+        ::ShowWindow(window, SW_SHOW);
+        ::UpdateWindow(window);
+    }
 
+    // raw input is delivered to the thread that registered for it
     const auto rid = ::RAWINPUTDEVICE{
         .usUsagePage = HID_USAGE_PAGE_GENERIC,
         .usUsage = HID_USAGE_GENERIC_MOUSE,
         .dwFlags = RIDEV_INPUTSINK,
-        .hwndTarget = window_};
+        .hwndTarget = window};
 
     const auto register_raw_input_res = ::RegisterRawInputDevices(&rid, 1, sizeof(rid));
     ensure(register_raw_input_res == TRUE, ErrorCode::REGISTER_RAW_INPUT_DEVICES);
 
+    auto *running = args->running;
+    args->window = window;
+    ::SetEvent(args->ready);
+
+    auto raw_input_reader = create_raw_input_reader();
+    auto logged_drops = 0u;
+
+    for (;;)
+    {
+        // sleep until something arrives, then drain everything the system has queued in one go, while movement is
+        // pending wake up regularly to push it once the ring has room
+        ::MsgWaitForMultipleObjects(0, nullptr, FALSE, g_move_pending ? 1u : INFINITE, QS_ALLINPUT);
+
+        CPU_PROFILE_SCOPE("pump messages");
+
+        flush_pending_move();
+        read_raw_input_buffer(&raw_input_reader);
+
+        auto msg = MSG{};
+        while (::PeekMessageA(&msg, nullptr, 0, 0, PM_REMOVE))
+        {
+            // windows are destroyed with the thread that created them, so rather than returning keep pumping until the
+            // process exits, the render side may still be presenting through the dc
+            if (msg.message == WM_QUIT)
+            {
+                *running = false;
+                continue;
+            }
+
+            ::TranslateMessage(&msg);
+            ::DispatchMessageA(&msg);
+        }
+
+        if (g_dropped_events != logged_drops)
+        {
+            logged_drops = g_dropped_events;
+            log_format("event ring full, %u events dropped", logged_drops);
+        }
+    }
+}
+}
+
+Window::Window(int width, int height)
+    : running_{true}
+    , width_{width}
+    , height_{height}
+    , headless_{}
+    , framebuffer_{}
+    , frame_{}
+    , frame_limit_{}
+    , dump_frames_{}
+    , dump_frame_count_{}
+    , wc_{}
+    , window_{}
+    , dc_{}
+{
+    char setting[256];
+    if (::GetEnvironmentVariableA("TEKTITE_HEADLESS", setting, sizeof(setting)) != 0)
+    {
+        headless_ = true;
+        parse_frame_list(setting, &frame_limit_, 1u);
+
+        if (::GetEnvironmentVariableA("TEKTITE_DUMP_FRAMES", setting, sizeof(setting)) != 0)
+        {
+            dump_frame_count_ = parse_frame_list(setting, dump_frames_, max_dump_frames);
+        }
+
+        log_format("running headless for %u frames, dumping %u", frame_limit_, dump_frame_count_);
+    }
+
+    wc_ = ::WNDCLASS{
+        .style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC,
+        .lpfnWndProc = window_proc,
+        .hInstance = ::GetModuleHandleA(nullptr),
+        .lpszClassName = "a"};
+
+    // the window belongs to the input thread, this thread just renders to it
+    auto args = InputThreadArgs{
+        .wc = &wc_,
+        .width = width_,
+        .height = height_,
+        .headless = headless_,
+        .running = &running_,
+        .window = {},
+        .ready = ::CreateEventA(nullptr, FALSE, FALSE, nullptr)};
+
+    ::CreateThread(nullptr, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(input_thread), &args, 0, nullptr);
+    ::WaitForSingleObject(args.ready, INFINITE);
+    ::CloseHandle(args.ready);
+
+    window_ = args.window;
+    dc_ = ::GetDC(window_);
+
     resolve_wgl_functions(wc_.hInstance);
-    init_opengl(dc_);
+    init_opengl(dc_, headless_);
     resolve_global_gl_functions();
     setup_debug();
 
-    ::glEnable(GL_DEPTH_TEST);
+    // the default framebuffer of a hidden window may not own its pixels, so render somewhere that definitely does
+    if (headless_)
+    {
+        auto colour_texture = ::GLuint{};
+        ::glCreateTextures(GL_TEXTURE_2D, 1, &colour_texture);
+        ::glTextureStorage2D(colour_texture, 1, GL_RGBA8, width_, height_);
+
+        auto depth_texture = ::GLuint{};
+        ::glCreateTextures(GL_TEXTURE_2D, 1, &depth_texture);
+        ::glTextureStorage2D(depth_texture, 1, GL_DEPTH_COMPONENT24, width_, height_);
+
+        ::glCreateFramebuffers(1, &framebuffer_);
+        ::glNamedFramebufferTexture(framebuffer_, GL_COLOR_ATTACHMENT0, colour_texture, 0);
+        ::glNamedFramebufferTexture(framebuffer_, GL_DEPTH_ATTACHMENT, depth_texture, 0);
 
-    g_has_event = false;
+        ensure(
+            ::glCheckNamedFramebufferStatus(framebuffer_, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE,
+            ErrorCode::FRAMEBUFFER_INCOMPLETE);
+
+        ::glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    }
+
+    ::glEnable(GL_DEPTH_TEST);
 }
 
 auto Window::running() const -> bool
@@ -306,31 +735,65 @@ auto Window::running() const -> bool
     return running_;
 }
 
-auto Window::pump_message(Event *evt) -> bool
+auto Window::pump_message(Event *evt, std::int64_t until) -> bool
 {
-    auto msg = MSG{};
-    while (::PeekMessageA(&msg, nullptr, 0, 0, PM_REMOVE))
+    const auto *next = g_events.peek();
+    if ((next == nullptr) || (next->time > until))
     {
-        if (msg.message == WM_QUIT)
-        {
-            running_ = false;
-        }
+        return false;
+    }
 
-        ::TranslateMessage(&msg);
-        ::DispatchMessageA(&msg);
+    return g_events.pop(evt);
+}
 
-        if (g_has_event)
+auto Window::swap() -> void
+{
+    if (!headless_)
+    {
+        ::SwapBuffers(dc_);
+        return;
+    }
+
+    for (auto i = 0u; i < dump_frame_count_; ++i)
+    {
+        if (dump_frames_[i] == frame_)
         {
-            *evt = g_event;
-            g_has_event = false;
-            return true;
+            char path[MAX_PATH];
+            ::wsprintfA(path, "frame_%05u.ppm", frame_);
+
+            ::glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+            if (write_ppm(path, width_, height_))
+            {
+                log_format("wrote %s", path);
+            }
+            else
+            {
+                log_format("failed to write %s", path);
+            }
         }
     }
 
-    return false;
+    if (++frame_ >= frame_limit_)
+    {
+        running_ = false;
+    }
+}
+
+auto Window::set_swap_interval(int interval) -> void
+{
+    // nothing is presented when headless, so there's nothing to sync to
+    if (!headless_)
+    {
+        ::wglSwapIntervalEXT(interval);
+    }
+}
+
+auto Window::headless() const -> bool
+{
+    return headless_;
 }
 
-auto Window::swap() const -> void
+auto Window::framebuffer() const -> ::GLuint
 {
-    ::SwapBuffers(dc_);
+    return framebuffer_;
 }
@@ -1,12 +1,20 @@
 #pragma once
 
+#include <cstdint>
+
 #include <Windows.h>
 
 #include "event.h"
+#include "opengl.h"
 
 /**
  * Class representing an OpenGL window.
  *
+ * Setting the TEKTITE_HEADLESS environment variable to a frame count runs without showing anything: the window stays
+ * hidden, frames are rendered into an offscreen framebuffer instead of the back buffer and the window stops running
+ * after that many frames. Frames listed (comma separated) in TEKTITE_DUMP_FRAMES are written out as frame_NNNNN.ppm.
+ * Without a GPU, dropping Mesa's opengl32.dll next to the exe gets a software (llvmpipe) context.
+ *
  * Note that for simplicity we assume one window will be created and live for the lifetime of the game, so we omit all
  * clean-up code.
  */
@@ -34,24 +42,78 @@ class Window
     /**
      * Get the next event from the window.
      *
-     * Note that without optional a user should just loop until this returns false.
+     * Messages are handled on a separate input thread which queues the events, this just takes them off the queue in
+     * order. Note that without optional a user should just loop until this returns false.
      *
      * @param evt
      *   The event to populate.
+     * @param until
+     *   QueryPerformanceCounter value to stop at, later events are left for the next call.
      *
      * @return
      *   True if an event was retrieved, false otherwise.
      */
-    auto pump_message(Event *evt) -> bool;
+    auto pump_message(Event *evt, std::int64_t until) -> bool;
 
     /**
-     * Swap the buffers.
+     * Swap the buffers. When headless this instead dumps the frame if it was asked for and counts down the frames.
      */
-    auto swap() const -> void;
+    auto swap() -> void;
+
+    /**
+     * Set how many vertical blanks a swap waits for.
+     *
+     * @param interval
+     *   Number of vertical blanks, 0 to not wait at all.
+     */
+    auto set_swap_interval(int interval) -> void;
+
+    /**
+     * Check if the window is headless.
+     *
+     * @return
+     *   True if rendering offscreen, false otherwise.
+     */
+    auto headless() const -> bool;
+
+    /**
+     * Get the framebuffer that ends up on screen, which is what a frame should finish by drawing to.
+     *
+     * @return
+     *   The offscreen framebuffer if headless, otherwise 0 for the default framebuffer.
+     */
+    auto framebuffer() const -> ::GLuint;
 
   private:
-    /** Flag indicating if the window is running. */
-    bool running_;
+    /** Maximum number of frames that can be dumped in a run. */
+    static constexpr auto max_dump_frames = 16u;
+
+    /** Flag indicating if the window is running, cleared by the input thread when the window is closed. */
+    volatile bool running_;
+
+    /** Width of the window. */
+    int width_;
+
+    /** Height of the window. */
+    int height_;
+
+    /** Flag indicating if rendering offscreen. */
+    bool headless_;
+
+    /** Offscreen framebuffer, 0 if not headless. */
+    ::GLuint framebuffer_;
+
+    /** Number of frames swapped so far. */
+    std::uint32_t frame_;
+
+    /** Number of frames to run for when headless. */
+    std::uint32_t frame_limit_;
+
+    /** Frames to write out when headless. */
+    std::uint32_t dump_frames_[max_dump_frames];
+
+    /** Number of frames to write out. */
+    std::uint32_t dump_frame_count_;
 
     /** The window class. */
     ::WNDCLASS wc_;